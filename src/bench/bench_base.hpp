@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../display.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// A timed workload. The bench runner opens a window, calls setup(), then
+// times step() repeatedly, syncing after each one (unless the bench is
+// self_timed()) so a step's latency covers the server processing its
+// requests. Correctness is checked once at the end
+// by redrawing the expected final state from scratch and comparing it with
+// the incrementally produced window.
+class BenchBase {
+public:
+    virtual ~BenchBase() = default;
+
+    virtual std::string name() const = 0;
+    virtual std::string description() const = 0;
+
+    virtual uint32_t width() const { return 640; }
+    virtual uint32_t height() const { return 480; }
+
+    // What one step is called in the report ("frames", "scrolls")
+    virtual std::string unit() const { return "steps"; }
+    virtual int default_iterations() const { return 300; }
+
+    // Parameter sweep: the runner repeats setup/steps/teardown for each value
+    // in a fresh window and reports one row per value. Empty runs once with
+    // param() == 0.
+    virtual std::vector<int> sweep() const { return {}; }
+    virtual std::string sweep_label() const { return "n"; }
+    void set_param(int value) { param_ = value; }
+    int param() const { return param_; }
+
+    // Complexity sweeps: param() is the input size n, and after the sweep the
+    // runner fits the median step times to O(1), O(n), O(n log n) and O(n^2)
+    // and flags superlinear growth
+    virtual bool fits_complexity() const { return false; }
+
+    // Benchmarks that call Xlib from several threads. `bench` calls
+    // XInitThreads() before its first connection when one is selected, so
+    // other runs keep Xlib's lock-free path.
+    virtual bool needs_threads() const { return false; }
+
+    // Benchmarks whose step() already ends at the moment it measures (e.g. a
+    // pixel read back) skip the runner's sync after each step, which would
+    // otherwise add a round trip to every sample
+    virtual bool self_timed() const { return false; }
+
+    // Untimed preparation: allocate colors, load fonts, draw the initial state
+    virtual void setup(Display& display) { (void)display; }
+
+    // One timed step; iteration counts from 0
+    virtual void step(Display& display, int iteration) = 0;
+
+    // Untimed cleanup of anything setup() created on the server
+    virtual void teardown(Display& display) { (void)display; }
+
+    // Extra figures for the report line, e.g. event counts
+    virtual std::string summary() const { return ""; }
+
+    // Benchmarks that check every step themselves (failure_reason() stays
+    // empty when all steps were right) count as verified without a redraw
+    virtual bool is_self_verifying() const { return false; }
+    virtual std::string failure_reason() const { return ""; }
+
+    // Draw the state the window should hold after `iterations` steps without
+    // relying on earlier contents. Return false to skip verification.
+    virtual bool render_expected(Display& display, int iterations) {
+        (void)display;
+        (void)iterations;
+        return false;
+    }
+
+protected:
+    int param_ = 0;
+};
+
+using BenchFactory = std::unique_ptr<BenchBase>(*)();
+
+struct BenchInfo {
+    std::string name;
+    BenchFactory factory;
+};
+
+std::vector<BenchInfo>& get_bench_registry();
+
+void register_bench(const std::string& name, BenchFactory factory);
+
+#define REGISTER_BENCH(BenchClass) \
+    static struct BenchClass##Registrar { \
+        BenchClass##Registrar() { \
+            register_bench(#BenchClass, []() -> std::unique_ptr<BenchBase> { \
+                return std::make_unique<BenchClass>(); \
+            }); \
+        } \
+    } BenchClass##registrar_instance;
+
+} // namespace x11bench
@@ -0,0 +1,510 @@
+#include "bench_base.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Xlibint exposes the request size limits Xlib splits against; it defines
+// min/max macros
+#include <X11/Xlibint.h>
+#undef min
+#undef max
+
+namespace x11bench {
+
+// =============================================================================
+// Oversized Requests
+// =============================================================================
+// Requests past the core limit of 256 KiB only fit through BIG-REQUESTS;
+// without it Xlib has to split them. Each benchmark issues one call whose
+// payload crosses that limit as the sweep grows: tiny rectangles, short
+// segments, a polygon with n vertices, an n x n image. The `_core` variants
+// hide the extension from Xlib (bigreq_size = 0) for the run, so the same
+// calls go out as core-sized requests. Rectangles, segments and images are
+// split by Xlib; a polygon cannot be, so its core variant skips sizes past
+// the limit. Each call is synced, and the summary gives the protocol requests
+// it took and the request throughput. The output is checked against the same
+// items drawn in small calls, or for images against the client's pixels.
+
+namespace {
+constexpr int REFERENCE_CHUNK = 1024;   // Items per call when drawing references
+
+// 8-bit channel value scaled into a visual's channel mask
+unsigned long channel(unsigned long mask, unsigned value) {
+    if (mask == 0) {
+        return 0;
+    }
+    int shift = __builtin_ctzl(mask);
+    int bits = __builtin_popcountl(mask);
+    unsigned long scaled = bits >= 8 ? static_cast<unsigned long>(value) << (bits - 8)
+                                     : value >> (8 - bits);
+    return (scaled << shift) & mask;
+}
+} // namespace
+
+class LargeRequest : public BenchBase {
+public:
+    explicit LargeRequest(bool big_requests)
+        : big_requests_(big_requests) {
+    }
+
+    uint32_t width() const override { return 512; }
+    uint32_t height() const override { return 512; }
+    std::string unit() const override { return "calls"; }
+    int default_iterations() const override { return 20; }
+
+    void setup(Display& display) override {
+        ::Display* dpy = display.x_display();
+        failure_.clear();
+        calls_ = 0;
+        requests_ = 0;
+        busy_ms_ = 0.0;
+
+        server_bigreq_size_ = dpy->bigreq_size;
+        if (!big_requests_) {
+            dpy->bigreq_size = 0;
+        }
+        limit_bytes_ = static_cast<size_t>(dpy->bigreq_size ? dpy->bigreq_size
+                                                             : dpy->max_request_size) * 4;
+
+        background_ = display.alloc_color(0, 0, 0);
+        colors_[0] = display.alloc_color(250, 200, 40);
+        colors_[1] = display.alloc_color(60, 120, 250);
+        gc_ = display.create_gc_for_window(display.x_window());
+        prepare(display);
+        clear(display);
+    }
+
+    void step(Display& display, int iteration) override {
+        if (!sendable()) {
+            return;
+        }
+        ::Display* dpy = display.x_display();
+        int frame = iteration % 2;
+        XSetForeground(dpy, gc_, colors_[frame]);
+        LockDisplay(dpy);
+        FlushGC(dpy, gc_);
+        UnlockDisplay(dpy);
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned long first = NextRequest(dpy);
+        draw(display, frame, false);
+        requests_ += NextRequest(dpy) - first;
+        XSync(dpy, False);
+        busy_ms_ += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        calls_++;
+    }
+
+    void teardown(Display& display) override {
+        display.x_display()->bigreq_size = server_bigreq_size_;
+        if (gc_) {
+            display.free_gc(gc_);
+            gc_ = nullptr;
+        }
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        if (!sendable()) {
+            return false;
+        }
+        clear(display);
+        if (iterations > 0) {
+            int frame = (iterations - 1) % 2;
+            XSetForeground(display.x_display(), gc_, colors_[frame]);
+            draw(display, frame, true);
+        }
+        return true;
+    }
+
+    std::string failure_reason() const override { return failure_; }
+
+    std::string summary() const override {
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        if (!sendable()) {
+            out << "not sent: " << request_bytes() / 1024 << " KiB cannot be split to the "
+                << limit_bytes_ / 1024 << " KiB request limit";
+            return out.str();
+        }
+        if (calls_ == 0 || busy_ms_ <= 0.0) {
+            return "";
+        }
+        out.precision(1);
+        out << static_cast<double>(requests_) / calls_ << " requests/call, "
+            << request_bytes() * calls_ / (busy_ms_ * 1000.0) << " MB/s";
+        if (big_requests_ && server_bigreq_size_ == 0) {
+            out << ", server lacks BIG-REQUESTS";
+        }
+        return out.str();
+    }
+
+protected:
+    GC gc_ = nullptr;
+    std::string failure_;
+
+    // Build the size-param_ items; called from setup()
+    virtual void prepare(Display& display) = 0;
+
+    // Issue the measured call, or with `reference` the same items in calls
+    // small enough that Xlib never splits them. `frame` alternates 0/1 and
+    // picks the foreground.
+    virtual void draw(Display& display, int frame, bool reference) = 0;
+
+    // Bytes of one call as a single request, header included
+    virtual size_t request_bytes() const = 0;
+
+    // Whether Xlib splits the call when it exceeds the request limit
+    virtual bool splittable() const { return true; }
+
+    // Deterministic pseudo-random coordinate in [0, range)
+    static int scatter(uint32_t& state, int range) {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<int>((state >> 8) % static_cast<uint32_t>(range));
+    }
+
+private:
+    bool big_requests_;
+    long server_bigreq_size_ = 0;   // 0 when the server lacks BIG-REQUESTS
+    size_t limit_bytes_ = 0;
+    unsigned long background_ = 0;
+    unsigned long colors_[2] = {};
+    int calls_ = 0;
+    uint64_t requests_ = 0;
+    double busy_ms_ = 0.0;
+
+    bool sendable() const {
+        return splittable() || request_bytes() <= limit_bytes_;
+    }
+
+    void clear(Display& display) {
+        GC gc = XCreateGC(display.x_display(), display.x_window(), 0, nullptr);
+        XSetForeground(display.x_display(), gc, background_);
+        XFillRectangle(display.x_display(), display.x_window(), gc, 0, 0, width(), height());
+        XFreeGC(display.x_display(), gc);
+    }
+};
+
+// --- Rectangles ---
+
+class LargeFillRects : public LargeRequest {
+public:
+    using LargeRequest::LargeRequest;
+
+    // 32766 rectangles fill a core request
+    std::vector<int> sweep() const override { return {8192, 32764, 32768, 262144, 1048576}; }
+    std::string sweep_label() const override { return "rects"; }
+
+protected:
+    void prepare(Display& display) override {
+        (void)display;
+        rects_.clear();
+        uint32_t state = 31337;
+        for (int i = 0; i < param_; i++) {
+            rects_.push_back({static_cast<short>(scatter(state, width() - 3)),
+                              static_cast<short>(scatter(state, height() - 3)), 3, 3});
+        }
+    }
+
+    void draw(Display& display, int frame, bool reference) override {
+        (void)frame;
+        ::Display* dpy = display.x_display();
+        int chunk = reference ? REFERENCE_CHUNK : param_;
+        for (int i = 0; i < param_; i += chunk) {
+            XFillRectangles(dpy, display.x_window(), gc_, rects_.data() + i,
+                            std::min(chunk, param_ - i));
+        }
+    }
+
+    size_t request_bytes() const override {
+        return sizeof(xPolyFillRectangleReq) + rects_.size() * sizeof(xRectangle);
+    }
+
+private:
+    std::vector<XRectangle> rects_;
+};
+
+class BenchBigreqFillRects : public LargeFillRects {
+public:
+    BenchBigreqFillRects() : LargeFillRects(true) {}
+    std::string name() const override { return "bigreq_fill_rects"; }
+    std::string description() const override {
+        return "One XFillRectangles call across the request limits, BIG-REQUESTS on";
+    }
+};
+REGISTER_BENCH(BenchBigreqFillRects)
+
+class BenchBigreqFillRectsCore : public LargeFillRects {
+public:
+    BenchBigreqFillRectsCore() : LargeFillRects(false) {}
+    std::string name() const override { return "bigreq_fill_rects_core"; }
+    std::string description() const override {
+        return "One XFillRectangles call split into core-sized requests";
+    }
+};
+REGISTER_BENCH(BenchBigreqFillRectsCore)
+
+// --- Segments ---
+
+class LargeDrawSegments : public LargeRequest {
+public:
+    using LargeRequest::LargeRequest;
+
+    // 32766 segments fill a core request
+    std::vector<int> sweep() const override { return {8192, 32764, 32768, 262144, 1048576}; }
+    std::string sweep_label() const override { return "segments"; }
+
+protected:
+    void prepare(Display& display) override {
+        (void)display;
+        segments_.clear();
+        uint32_t state = 4711;
+        for (int i = 0; i < param_; i++) {
+            short x = static_cast<short>(scatter(state, width() - 8));
+            short y = static_cast<short>(scatter(state, height() - 8));
+            segments_.push_back({x, y, static_cast<short>(x + scatter(state, 8)),
+                                 static_cast<short>(y + scatter(state, 8))});
+        }
+    }
+
+    void draw(Display& display, int frame, bool reference) override {
+        (void)frame;
+        ::Display* dpy = display.x_display();
+        int chunk = reference ? REFERENCE_CHUNK : param_;
+        for (int i = 0; i < param_; i += chunk) {
+            XDrawSegments(dpy, display.x_window(), gc_, segments_.data() + i,
+                          std::min(chunk, param_ - i));
+        }
+    }
+
+    size_t request_bytes() const override {
+        return sizeof(xPolySegmentReq) + segments_.size() * sizeof(xSegment);
+    }
+
+private:
+    std::vector<XSegment> segments_;
+};
+
+class BenchBigreqDrawSegments : public LargeDrawSegments {
+public:
+    BenchBigreqDrawSegments() : LargeDrawSegments(true) {}
+    std::string name() const override { return "bigreq_draw_segments"; }
+    std::string description() const override {
+        return "One XDrawSegments call across the request limits, BIG-REQUESTS on";
+    }
+};
+REGISTER_BENCH(BenchBigreqDrawSegments)
+
+class BenchBigreqDrawSegmentsCore : public LargeDrawSegments {
+public:
+    BenchBigreqDrawSegmentsCore() : LargeDrawSegments(false) {}
+    std::string name() const override { return "bigreq_draw_segments_core"; }
+    std::string description() const override {
+        return "One XDrawSegments call split into core-sized requests";
+    }
+};
+REGISTER_BENCH(BenchBigreqDrawSegmentsCore)
+
+// --- Polygons ---
+
+// A square whose sides are subdivided into param_ / 4 vertices each: it
+// covers exactly the pixels of the plain rectangle used as reference
+class LargeFillPolygon : public LargeRequest {
+public:
+    using LargeRequest::LargeRequest;
+
+    // 65531 vertices fill a core request
+    std::vector<int> sweep() const override { return {16384, 65528, 65532, 262144, 1048576}; }
+    std::string sweep_label() const override { return "vertices"; }
+
+protected:
+    void prepare(Display& display) override {
+        (void)display;
+        points_.clear();
+        const int corners[4][2] = {{LOW, LOW}, {HIGH, LOW}, {HIGH, HIGH}, {LOW, HIGH}};
+        int per_side = param_ / 4;
+        for (int side = 0; side < 4; side++) {
+            const int* from = corners[side];
+            const int* to = corners[(side + 1) % 4];
+            for (int k = 0; k < per_side; k++) {
+                points_.push_back({static_cast<short>(from[0] + (to[0] - from[0]) * k / per_side),
+                                   static_cast<short>(from[1] + (to[1] - from[1]) * k / per_side)});
+            }
+        }
+    }
+
+    void draw(Display& display, int frame, bool reference) override {
+        (void)frame;
+        ::Display* dpy = display.x_display();
+        if (reference) {
+            XFillRectangle(dpy, display.x_window(), gc_, LOW, LOW, HIGH - LOW, HIGH - LOW);
+            return;
+        }
+        XFillPolygon(dpy, display.x_window(), gc_, points_.data(),
+                     static_cast<int>(points_.size()), Complex, CoordModeOrigin);
+    }
+
+    size_t request_bytes() const override {
+        return sizeof(xFillPolyReq) + points_.size() * sizeof(xPoint);
+    }
+
+    // Xlib sends a polygon as one request
+    bool splittable() const override { return false; }
+
+private:
+    static constexpr int LOW = 16;
+    static constexpr int HIGH = 496;
+    std::vector<XPoint> points_;
+};
+
+class BenchBigreqFillPolygon : public LargeFillPolygon {
+public:
+    BenchBigreqFillPolygon() : LargeFillPolygon(true) {}
+    std::string name() const override { return "bigreq_fill_polygon"; }
+    std::string description() const override {
+        return "One XFillPolygon call across the core request limit, BIG-REQUESTS on";
+    }
+};
+REGISTER_BENCH(BenchBigreqFillPolygon)
+
+class BenchBigreqFillPolygonCore : public LargeFillPolygon {
+public:
+    BenchBigreqFillPolygonCore() : LargeFillPolygon(false) {}
+    std::string name() const override { return "bigreq_fill_polygon_core"; }
+    std::string description() const override {
+        return "XFillPolygon up to the core request limit";
+    }
+};
+REGISTER_BENCH(BenchBigreqFillPolygonCore)
+
+// --- Images ---
+
+// Images larger than a window fits on screen go to an n x n pixmap, and the
+// final state is checked by reading the pixmap back against the client image
+class LargePutImage : public LargeRequest {
+public:
+    using LargeRequest::LargeRequest;
+
+    // 255x255 fits a core request at 32 bpp; 2048x2048 exceeds the usual
+    // 16 MiB BIG-REQUESTS maximum too
+    std::vector<int> sweep() const override { return {128, 255, 256, 1024, 2048}; }
+    std::string sweep_label() const override { return "size"; }
+    bool is_self_verifying() const override { return true; }
+
+    void teardown(Display& display) override {
+        for (XImage*& image : images_) {
+            if (image) {
+                XDestroyImage(image);
+                image = nullptr;
+            }
+        }
+        if (target_) {
+            display.free_pixmap(target_);
+            target_ = 0;
+        }
+        LargeRequest::teardown(display);
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        if (iterations == 0 || !target_) {
+            return false;
+        }
+        ::Display* dpy = display.x_display();
+        XImage* expected = images_[(iterations - 1) % 2];
+        XImage* actual = XGetImage(dpy, target_, 0, 0, param_, param_, AllPlanes, ZPixmap);
+        if (!actual) {
+            failure_ = "cannot read back the target pixmap";
+            return false;
+        }
+        for (int y = 0; y < param_ && failure_.empty(); y++) {
+            for (int x = 0; x < param_; x++) {
+                unsigned long want = XGetPixel(expected, x, y) & pixel_mask_;
+                unsigned long got = XGetPixel(actual, x, y) & pixel_mask_;
+                if (want != got) {
+                    std::ostringstream out;
+                    out << "pixel (" << x << "," << y << ") is 0x" << std::hex << got
+                        << ", put 0x" << want;
+                    failure_ = out.str();
+                    break;
+                }
+            }
+        }
+        XDestroyImage(actual);
+        return false;
+    }
+
+protected:
+    void prepare(Display& display) override {
+        ::Display* dpy = display.x_display();
+        Visual* visual = display.visual();
+        pixel_mask_ = visual->red_mask | visual->green_mask | visual->blue_mask;
+        target_ = display.create_pixmap(param_, param_, display.depth());
+
+        for (int frame = 0; frame < 2; frame++) {
+            XImage* image = XCreateImage(dpy, visual, display.depth(), ZPixmap, 0, nullptr,
+                                         param_, param_, 32, 0);
+            if (!image) {
+                failure_ = "cannot create a client image";
+                return;
+            }
+            image->data = static_cast<char*>(
+                std::malloc(static_cast<size_t>(image->bytes_per_line) * param_));
+            for (int y = 0; y < param_; y++) {
+                for (int x = 0; x < param_; x++) {
+                    unsigned r = (x * 3 + frame * 90) & 0xff;
+                    unsigned g = (y * 5) & 0xff;
+                    unsigned b = (x ^ y) & 0xff;
+                    XPutPixel(image, x, y, channel(visual->red_mask, r) |
+                                           channel(visual->green_mask, g) |
+                                           channel(visual->blue_mask, b));
+                }
+            }
+            images_[frame] = image;
+        }
+    }
+
+    void draw(Display& display, int frame, bool reference) override {
+        (void)reference;  // Checked against the client image instead
+        if (!images_[frame]) {
+            return;
+        }
+        XPutImage(display.x_display(), target_, gc_, images_[frame], 0, 0, 0, 0,
+                  param_, param_);
+    }
+
+    size_t request_bytes() const override {
+        return images_[0] ? sizeof(xPutImageReq) +
+                                static_cast<size_t>(images_[0]->bytes_per_line) * param_
+                          : 0;
+    }
+
+private:
+    Pixmap target_ = 0;
+    XImage* images_[2] = {};
+    unsigned long pixel_mask_ = 0;
+};
+
+class BenchBigreqPutImage : public LargePutImage {
+public:
+    BenchBigreqPutImage() : LargePutImage(true) {}
+    std::string name() const override { return "bigreq_put_image"; }
+    std::string description() const override {
+        return "One n x n XPutImage call across the request limits, BIG-REQUESTS on";
+    }
+};
+REGISTER_BENCH(BenchBigreqPutImage)
+
+class BenchBigreqPutImageCore : public LargePutImage {
+public:
+    BenchBigreqPutImageCore() : LargePutImage(false) {}
+    std::string name() const override { return "bigreq_put_image_core"; }
+    std::string description() const override {
+        return "One n x n XPutImage call split into core-sized requests";
+    }
+};
+REGISTER_BENCH(BenchBigreqPutImageCore)
+
+} // namespace x11bench
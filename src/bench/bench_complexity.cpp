@@ -0,0 +1,403 @@
+#include "bench_base.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// =============================================================================
+// Complexity Scaling
+// =============================================================================
+// Throughput at one size hides algorithmic cliffs. Each benchmark sweeps the
+// size n of a single request (polygon vertices, clip rectangles, dash list
+// length, arc diameter, rectangles per XFillRectangles) and every step issues
+// that request once, alternating between two colors. The runner fits the
+// median step times to candidate growth models and flags anything growing
+// faster than O(n) in Xlib or the server. The final frame is checked against
+// the same pixels produced another way: the shape hint dropped, the clip
+// replaced by the rectangles themselves, one request per rectangle, and the
+// self-intersecting polygon and dashed lines computed here as pixel spans.
+// The thin arc's pixels are up to the server, so it goes unverified.
+
+class ComplexitySweep : public BenchBase {
+public:
+    uint32_t width() const override { return 512; }
+    uint32_t height() const override { return 512; }
+    std::string unit() const override { return "requests"; }
+    int default_iterations() const override { return 100; }
+    bool fits_complexity() const override { return true; }
+
+    void setup(Display& display) override {
+        background_ = display.alloc_color(0, 0, 0);
+        colors_[0] = display.alloc_color(230, 90, 30);
+        colors_[1] = display.alloc_color(40, 160, 230);
+        gc_ = display.create_gc_for_window(display.x_window());
+        prepare();
+        clear(display);
+    }
+
+    void step(Display& display, int iteration) override {
+        XSetForeground(display.x_display(), gc_, colors_[iteration % 2]);
+        draw(display, false);
+    }
+
+    void teardown(Display& display) override {
+        if (gc_) {
+            display.free_gc(gc_);
+            gc_ = nullptr;
+        }
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        clear(display);
+        if (iterations > 0) {
+            XSetForeground(display.x_display(), gc_, colors_[(iterations - 1) % 2]);
+            draw(display, true);
+        }
+        return true;
+    }
+
+protected:
+    GC gc_ = nullptr;
+
+    // Build the size-param_ geometry; called from setup()
+    virtual void prepare() = 0;
+
+    // Issue the measured request, or with `reference` an equivalent that
+    // must produce the same pixels
+    virtual void draw(Display& display, bool reference) = 0;
+
+    // Deterministic pseudo-random coordinate in [0, range)
+    int scatter(uint32_t& state, int range) const {
+        state = state * 1664525u + 1013904223u;
+        return static_cast<int>((state >> 8) % static_cast<uint32_t>(range));
+    }
+
+    // Fill one-pixel-high spans in one request
+    void fill_spans(Display& display, const std::vector<XRectangle>& spans) {
+        XFillRectangles(display.x_display(), display.x_window(), gc_,
+                        const_cast<XRectangle*>(spans.data()), static_cast<int>(spans.size()));
+    }
+
+private:
+    unsigned long background_ = 0;
+    unsigned long colors_[2] = {};
+
+    void clear(Display& display) {
+        XGCValues values;
+        GC gc = XCreateGC(display.x_display(), display.x_window(), 0, &values);
+        XSetForeground(display.x_display(), gc, background_);
+        XFillRectangle(display.x_display(), display.x_window(), gc, 0, 0, width(), height());
+        XFreeGC(display.x_display(), gc);
+    }
+};
+
+// --- Polygons ---
+
+enum class PolygonKind { Regular, Star, Scribble };
+
+class PolygonSweep : public ComplexitySweep {
+public:
+    explicit PolygonSweep(PolygonKind kind)
+        : kind_(kind) {
+    }
+
+    std::vector<int> sweep() const override { return {8, 32, 128, 512, 2048, 8192}; }
+    std::string sweep_label() const override { return "vertices"; }
+
+protected:
+    void prepare() override {
+        points_.clear();
+        const double center = 256.0;
+        uint32_t state = 12345;
+        for (int i = 0; i < param_; i++) {
+            double angle = 2.0 * M_PI * i / param_;
+            double radius = 240.0;
+            switch (kind_) {
+                case PolygonKind::Regular:
+                    break;
+                case PolygonKind::Star:
+                    // Star outline: alternate between outer and inner radius
+                    radius = (i % 2) ? 120.0 : 240.0;
+                    break;
+                case PolygonKind::Scribble:
+                    // Scribble: every edge crosses many others
+                    points_.push_back({static_cast<short>(16 + scatter(state, 480)),
+                                       static_cast<short>(16 + scatter(state, 480))});
+                    continue;
+            }
+            points_.push_back({static_cast<short>(std::lround(center + radius * std::cos(angle))),
+                               static_cast<short>(std::lround(center + radius * std::sin(angle)))});
+        }
+    }
+
+    void draw(Display& display, bool reference) override {
+        if (reference && kind_ == PolygonKind::Scribble) {
+            fill_spans(display, scan_even_odd());
+            return;
+        }
+        int shape = Complex;
+        if (!reference && kind_ == PolygonKind::Regular) shape = Convex;
+        if (!reference && kind_ == PolygonKind::Star) shape = Nonconvex;
+        XFillPolygon(display.x_display(), display.x_window(), gc_, points_.data(),
+                     static_cast<int>(points_.size()), shape, CoordModeOrigin);
+    }
+
+private:
+    PolygonKind kind_;
+    std::vector<XPoint> points_;
+
+    // Floor of a / b for b > 0
+    static int64_t floor_div(int64_t a, int64_t b) {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    // The polygon's spans under the protocol's rules, with the GC's default
+    // EvenOddRule: a pixel is inside when its center is, and a center on an
+    // edge is inside when the interior lies to its right. Vertices are
+    // integers, so pixel-center rows never pass through one, and crossings
+    // are kept as exact fractions.
+    std::vector<XRectangle> scan_even_odd() const {
+        std::vector<XRectangle> spans;
+        std::vector<int64_t> first;  // First pixel whose center is at or right of a crossing
+        size_t n = points_.size();
+        for (int y = 0; y < static_cast<int>(height()); y++) {
+            first.clear();
+            for (size_t i = 0; i < n; i++) {
+                XPoint a = points_[i];
+                XPoint b = points_[(i + 1) % n];
+                if (a.y > b.y) std::swap(a, b);
+                // Center row 2y+1 in half-pixel units
+                if (2 * a.y > 2 * y + 1 || 2 * b.y < 2 * y + 1 || a.y == b.y) {
+                    continue;
+                }
+                // Crossing x = num / den; smallest x with x + 1/2 >= num / den
+                int64_t den = 2 * int64_t(b.y - a.y);
+                int64_t num = int64_t(a.x) * den + int64_t(2 * y + 1 - 2 * a.y) * (b.x - a.x);
+                first.push_back(-floor_div(den - 2 * num, 2 * den));
+            }
+            std::sort(first.begin(), first.end());
+            for (size_t i = 0; i + 1 < first.size(); i += 2) {
+                int64_t x0 = std::max<int64_t>(first[i], 0);
+                int64_t x1 = std::min<int64_t>(first[i + 1], width());
+                if (x1 > x0) {
+                    spans.push_back({static_cast<short>(x0), static_cast<short>(y),
+                                     static_cast<unsigned short>(x1 - x0), 1});
+                }
+            }
+        }
+        return spans;
+    }
+};
+
+class BenchScalePolyConvex : public PolygonSweep {
+public:
+    BenchScalePolyConvex() : PolygonSweep(PolygonKind::Regular) {}
+    std::string name() const override { return "scale_poly_convex"; }
+    std::string description() const override {
+        return "XFillPolygon (Convex) cost against vertex count";
+    }
+};
+REGISTER_BENCH(BenchScalePolyConvex)
+
+class BenchScalePolyNonconvex : public PolygonSweep {
+public:
+    BenchScalePolyNonconvex() : PolygonSweep(PolygonKind::Star) {}
+    std::string name() const override { return "scale_poly_nonconvex"; }
+    std::string description() const override {
+        return "XFillPolygon (Nonconvex star) cost against vertex count";
+    }
+};
+REGISTER_BENCH(BenchScalePolyNonconvex)
+
+class BenchScalePolyComplex : public PolygonSweep {
+public:
+    BenchScalePolyComplex() : PolygonSweep(PolygonKind::Scribble) {}
+    std::string name() const override { return "scale_poly_complex"; }
+    std::string description() const override {
+        return "XFillPolygon (Complex, self-intersecting) cost against vertex count";
+    }
+};
+REGISTER_BENCH(BenchScalePolyComplex)
+
+// --- Clip rectangles ---
+
+class BenchScaleClipRects : public ComplexitySweep {
+public:
+    std::string name() const override { return "scale_clip_rects"; }
+    std::string description() const override {
+        return "Window fill through an n-rectangle clip list";
+    }
+    std::vector<int> sweep() const override { return {4, 16, 64, 256, 1024, 4096}; }
+    std::string sweep_label() const override { return "rects"; }
+
+protected:
+    void prepare() override {
+        rects_ = scattered_rects(param_, 6);
+    }
+
+    void draw(Display& display, bool reference) override {
+        ::Display* dpy = display.x_display();
+        if (reference) {
+            XSetClipMask(dpy, gc_, None);
+            XFillRectangles(dpy, display.x_window(), gc_, rects_.data(),
+                            static_cast<int>(rects_.size()));
+            return;
+        }
+        XSetClipRectangles(dpy, gc_, 0, 0, rects_.data(), static_cast<int>(rects_.size()),
+                           Unsorted);
+        XFillRectangle(dpy, display.x_window(), gc_, 0, 0, width(), height());
+    }
+
+private:
+    std::vector<XRectangle> rects_;
+
+    std::vector<XRectangle> scattered_rects(int count, int size) {
+        std::vector<XRectangle> rects;
+        uint32_t state = 777;
+        for (int i = 0; i < count; i++) {
+            rects.push_back({static_cast<short>(scatter(state, width() - size)),
+                             static_cast<short>(scatter(state, height() - size)),
+                             static_cast<unsigned short>(size), static_cast<unsigned short>(size)});
+        }
+        return rects;
+    }
+};
+REGISTER_BENCH(BenchScaleClipRects)
+
+// --- Dashes ---
+
+class BenchScaleDashes : public ComplexitySweep {
+public:
+    std::string name() const override { return "scale_dashes"; }
+    std::string description() const override {
+        return "Dashed lines of fixed total length against dash list length";
+    }
+    std::vector<int> sweep() const override { return {2, 8, 32, 128, 512, 2048}; }
+    std::string sweep_label() const override { return "dashes"; }
+
+protected:
+    void prepare() override {
+        dashes_.clear();
+        for (int i = 0; i < param_; i++) {
+            dashes_.push_back(static_cast<char>(1 + (i * 7) % 4));
+        }
+        segments_.clear();
+        for (int y = 8; y < static_cast<int>(height()) - 8; y += 8) {
+            segments_.push_back({8, static_cast<short>(y), static_cast<short>(width() - 8),
+                                 static_cast<short>(y)});
+        }
+    }
+
+    void draw(Display& display, bool reference) override {
+        ::Display* dpy = display.x_display();
+        if (reference) {
+            fill_spans(display, dash_spans());
+            return;
+        }
+        XSetLineAttributes(dpy, gc_, 0, LineOnOffDash, CapButt, JoinMiter);
+        XSetDashes(dpy, gc_, 0, dashes_.data(), static_cast<int>(dashes_.size()));
+        XDrawSegments(dpy, display.x_window(), gc_, segments_.data(),
+                      static_cast<int>(segments_.size()));
+    }
+
+private:
+    std::vector<char> dashes_;
+    std::vector<XSegment> segments_;
+
+    // The "on" dashes of each horizontal segment as spans. A thin segment
+    // covers x1..x2 inclusive, and its dash pattern starts over at x1 with
+    // an "on" dash; the dash list has an even length, so it repeats as is.
+    std::vector<XRectangle> dash_spans() const {
+        std::vector<XRectangle> spans;
+        for (const XSegment& s : segments_) {
+            int x = s.x1;
+            size_t dash = 0;
+            while (x <= s.x2) {
+                int length = std::min<int>(dashes_[dash], s.x2 - x + 1);
+                if (dash % 2 == 0) {
+                    spans.push_back({static_cast<short>(x), s.y1,
+                                     static_cast<unsigned short>(length), 1});
+                }
+                x += length;
+                dash = (dash + 1) % dashes_.size();
+            }
+        }
+        return spans;
+    }
+};
+REGISTER_BENCH(BenchScaleDashes)
+
+// --- Arcs ---
+
+class BenchScaleArc : public ComplexitySweep {
+public:
+    std::string name() const override { return "scale_arc"; }
+    std::string description() const override {
+        return "Thin XDrawArc circle cost against diameter";
+    }
+    std::vector<int> sweep() const override { return {8, 16, 32, 64, 128, 256, 500}; }
+    std::string sweep_label() const override { return "diameter"; }
+
+protected:
+    void prepare() override {}
+
+    // Thin arcs are drawn however the server's zero-width arc code does it;
+    // there is no independent way to produce the same pixels
+    bool render_expected(Display& display, int iterations) override {
+        (void)display;
+        (void)iterations;
+        return false;
+    }
+
+    void draw(Display& display, bool reference) override {
+        (void)reference;
+        int origin = (static_cast<int>(width()) - param_) / 2;
+        XDrawArc(display.x_display(), display.x_window(), gc_, origin, origin,
+                 param_, param_, 0, 360 * 64);
+    }
+};
+REGISTER_BENCH(BenchScaleArc)
+
+// --- Rectangle batches ---
+
+class BenchScaleFillRects : public ComplexitySweep {
+public:
+    std::string name() const override { return "scale_fill_rects"; }
+    std::string description() const override {
+        return "XFillRectangles cost against rectangles per request";
+    }
+    std::vector<int> sweep() const override { return {4, 16, 64, 256, 1024, 4096}; }
+    std::string sweep_label() const override { return "rects"; }
+
+protected:
+    void prepare() override {
+        rects_.clear();
+        uint32_t state = 4242;
+        for (int i = 0; i < param_; i++) {
+            rects_.push_back({static_cast<short>(scatter(state, width() - 4)),
+                              static_cast<short>(scatter(state, height() - 4)), 4, 4});
+        }
+    }
+
+    void draw(Display& display, bool reference) override {
+        ::Display* dpy = display.x_display();
+        if (reference) {
+            for (const XRectangle& r : rects_) {
+                XFillRectangle(dpy, display.x_window(), gc_, r.x, r.y, r.width, r.height);
+            }
+            return;
+        }
+        XFillRectangles(dpy, display.x_window(), gc_, rects_.data(),
+                        static_cast<int>(rects_.size()));
+    }
+
+private:
+    std::vector<XRectangle> rects_;
+};
+REGISTER_BENCH(BenchScaleFillRects)
+
+} // namespace x11bench
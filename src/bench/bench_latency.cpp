@@ -0,0 +1,279 @@
+#include "bench_base.hpp"
+#include "../capture.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// =============================================================================
+// Request-to-Pixel Latency
+// =============================================================================
+// XSync only proves the server processed a request, not that its pixels can be
+// read back. Each probe queues (depth - 1) primitives of one type as backlog,
+// then the same primitive in a color different from the last probe, flushes,
+// and polls the probe's center pixel through a persistent MIT-SHM segment
+// until the color appears. The step time is issue-to-pixel latency. The
+// screen (root window) is polled when it shares the window's visual so
+// compositing delays count.
+
+enum class ProbePrimitive { Fill, Line, Text, Render, PutImage };
+
+class LatencyProbe : public BenchBase {
+public:
+    explicit LatencyProbe(ProbePrimitive primitive)
+        : primitive_(primitive) {
+    }
+
+    uint32_t width() const override { return 256; }
+    uint32_t height() const override { return 256; }
+    std::string unit() const override { return "probes"; }
+    int default_iterations() const override { return 200; }
+    std::vector<int> sweep() const override { return {1, 8, 64, 512}; }
+    std::string sweep_label() const override { return "depth"; }
+    bool is_self_verifying() const override { return true; }
+    bool self_timed() const override { return true; }
+
+    void setup(Display& display) override {
+        ::Display* dpy = display.x_display();
+        ::Window win = display.x_window();
+        failure_.clear();
+        total_reads_ = 0;
+        probes_ = 0;
+
+        background_ = display.alloc_color(0, 0, 0);
+        filler_ = display.alloc_color(128, 128, 128);
+        colors_.clear();
+        for (int i = 0; i < PALETTE_SIZE; i++) {
+            Rgb c = {static_cast<uint8_t>(40 + i * 6), static_cast<uint8_t>(250 - i * 5),
+                     static_cast<uint8_t>(i * 8)};
+            colors_.push_back({c, display.alloc_color(c.r, c.g, c.b)});
+        }
+
+        gc_ = XCreateGC(dpy, win, 0, nullptr);
+        XSetLineAttributes(dpy, gc_, 6, LineSolid, CapButt, JoinMiter);
+        display.set_foreground(background_);
+        display.draw_rectangle(0, 0, width(), height(), true);
+
+        if (primitive_ == ProbePrimitive::Text) {
+            font_ = XLoadQueryFont(dpy, "fixed");
+            if (!font_) {
+                failure_ = "core font 'fixed' not available";
+                return;
+            }
+            XSetFont(dpy, gc_, font_->fid);
+        }
+        if (primitive_ == ProbePrimitive::Render && !display.picture()) {
+            failure_ = "XRender not available";
+            return;
+        }
+        if (primitive_ == ProbePrimitive::PutImage) {
+            filler_image_ = solid_image(display, filler_);
+            for (const auto& color : colors_) {
+                images_.push_back(solid_image(display, color.pixel));
+            }
+        }
+
+        // Poll what the user sees when the screen has the window's format
+        ::Window root = display.root_window();
+        ::Window child;
+        bool same_format = display.visual() == DefaultVisual(dpy, display.screen());
+        int center_x = PROBE_X + PROBE_SIZE / 2;
+        int center_y = PROBE_Y + PROBE_SIZE / 2;
+        if (same_format && XTranslateCoordinates(dpy, win, root, center_x, center_y,
+                                                 &read_x_, &read_y_, &child)) {
+            source_ = root;
+        } else {
+            source_ = win;
+            read_x_ = center_x;
+            read_y_ = center_y;
+        }
+        region_ = std::make_unique<ShmRegion>(display, display.visual(), display.depth(), 1, 1);
+        if (!region_->valid()) {
+            failure_ = "MIT-SHM not available (remote server?)";
+        }
+    }
+
+    void step(Display& display, int iteration) override {
+        if (!failure_.empty()) {
+            return;
+        }
+        ::Display* dpy = display.x_display();
+
+        for (int k = 0; k < param_ - 1; k++) {
+            int x = (k * 37) % (width() - 2 * PROBE_SIZE);
+            int y = (k * 53) % (PROBE_Y - PROBE_SIZE);
+            draw(display, x, y, filler_, nullptr);
+        }
+        const Color& color = colors_[iteration % colors_.size()];
+        draw(display, PROBE_X, PROBE_Y, color.pixel, &color);
+        XFlush(dpy);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (true) {
+            total_reads_++;
+            if (region_->read(source_, read_x_, read_y_) &&
+                region_->pixel(0, 0) == color.pixel) {
+                break;
+            }
+            if (std::chrono::steady_clock::now() > deadline) {
+                failure_ = "probe " + std::to_string(iteration) + " never became visible";
+                break;
+            }
+        }
+        probes_++;
+    }
+
+    void teardown(Display& display) override {
+        ::Display* dpy = display.x_display();
+        region_.reset();
+        for (XImage* image : images_) {
+            XDestroyImage(image);
+        }
+        images_.clear();
+        if (filler_image_) {
+            XDestroyImage(filler_image_);
+            filler_image_ = nullptr;
+        }
+        if (font_) {
+            XFreeFont(dpy, font_);
+            font_ = nullptr;
+        }
+        if (gc_) {
+            XFreeGC(dpy, gc_);
+            gc_ = nullptr;
+        }
+    }
+
+    std::string summary() const override {
+        if (probes_ == 0) {
+            return "";
+        }
+        char text[64];
+        std::snprintf(text, sizeof(text), "%.2f reads/probe", double(total_reads_) / probes_);
+        return text;
+    }
+
+    std::string failure_reason() const override { return failure_; }
+
+private:
+    static constexpr int PROBE_X = 200;
+    static constexpr int PROBE_Y = 200;
+    static constexpr int PROBE_SIZE = 16;
+    static constexpr int PALETTE_SIZE = 32;
+
+    struct Rgb { uint8_t r, g, b; };
+    struct Color {
+        Rgb rgb;
+        unsigned long pixel;
+    };
+
+    ProbePrimitive primitive_;
+    GC gc_ = nullptr;
+    XFontStruct* font_ = nullptr;
+    unsigned long background_ = 0;
+    unsigned long filler_ = 0;
+    std::vector<Color> colors_;
+    std::vector<XImage*> images_;   // One solid probe image per palette entry
+    XImage* filler_image_ = nullptr;
+    std::unique_ptr<ShmRegion> region_;
+    ::Window source_ = 0;
+    int read_x_ = 0;
+    int read_y_ = 0;
+    long total_reads_ = 0;
+    long probes_ = 0;
+    std::string failure_;
+
+    XImage* solid_image(Display& display, unsigned long pixel) {
+        XImage* image = XCreateImage(display.x_display(), display.visual(), display.depth(),
+                                     ZPixmap, 0, nullptr, PROBE_SIZE, PROBE_SIZE, 32, 0);
+        image->data = static_cast<char*>(std::malloc(image->bytes_per_line * PROBE_SIZE));
+        for (int y = 0; y < PROBE_SIZE; y++) {
+            for (int x = 0; x < PROBE_SIZE; x++) {
+                XPutPixel(image, x, y, pixel);
+            }
+        }
+        return image;
+    }
+
+    // Cover the PROBE_SIZE square at (x, y); color is null for backlog
+    void draw(Display& display, int x, int y, unsigned long pixel, const Color* color) {
+        ::Display* dpy = display.x_display();
+        ::Window win = display.x_window();
+        switch (primitive_) {
+            case ProbePrimitive::Fill:
+                XSetForeground(dpy, gc_, pixel);
+                XFillRectangle(dpy, win, gc_, x, y, PROBE_SIZE, PROBE_SIZE);
+                break;
+            case ProbePrimitive::Line:
+                XSetForeground(dpy, gc_, pixel);
+                XDrawLine(dpy, win, gc_, x, y + PROBE_SIZE / 2, x + PROBE_SIZE, y + PROBE_SIZE / 2);
+                break;
+            case ProbePrimitive::Text:
+                // Image text paints its cells with the background color
+                XSetBackground(dpy, gc_, pixel);
+                XDrawImageString(dpy, win, gc_, x - 1, y - 1 + font_->ascent, "   ", 3);
+                break;
+            case ProbePrimitive::Render: {
+                Rgb rgb = color ? color->rgb : Rgb{128, 128, 128};
+                XRenderColor rc = {static_cast<unsigned short>(rgb.r * 257),
+                                   static_cast<unsigned short>(rgb.g * 257),
+                                   static_cast<unsigned short>(rgb.b * 257), 0xffff};
+                XRenderFillRectangle(dpy, PictOpSrc, display.picture(), &rc,
+                                     x, y, PROBE_SIZE, PROBE_SIZE);
+                break;
+            }
+            case ProbePrimitive::PutImage:
+                XPutImage(dpy, win, gc_,
+                          color ? images_[color - colors_.data()] : filler_image_,
+                          0, 0, x, y, PROBE_SIZE, PROBE_SIZE);
+                break;
+        }
+    }
+};
+
+class BenchLatencyFill : public LatencyProbe {
+public:
+    BenchLatencyFill() : LatencyProbe(ProbePrimitive::Fill) {}
+    std::string name() const override { return "latency_fill"; }
+    std::string description() const override { return "XFillRectangle issue-to-pixel latency"; }
+};
+REGISTER_BENCH(BenchLatencyFill)
+
+class BenchLatencyLine : public LatencyProbe {
+public:
+    BenchLatencyLine() : LatencyProbe(ProbePrimitive::Line) {}
+    std::string name() const override { return "latency_line"; }
+    std::string description() const override { return "Wide XDrawLine issue-to-pixel latency"; }
+};
+REGISTER_BENCH(BenchLatencyLine)
+
+class BenchLatencyText : public LatencyProbe {
+public:
+    BenchLatencyText() : LatencyProbe(ProbePrimitive::Text) {}
+    std::string name() const override { return "latency_text"; }
+    std::string description() const override { return "XDrawImageString issue-to-pixel latency"; }
+};
+REGISTER_BENCH(BenchLatencyText)
+
+class BenchLatencyRender : public LatencyProbe {
+public:
+    BenchLatencyRender() : LatencyProbe(ProbePrimitive::Render) {}
+    std::string name() const override { return "latency_render"; }
+    std::string description() const override { return "XRenderFillRectangle issue-to-pixel latency"; }
+};
+REGISTER_BENCH(BenchLatencyRender)
+
+class BenchLatencyPutImage : public LatencyProbe {
+public:
+    BenchLatencyPutImage() : LatencyProbe(ProbePrimitive::PutImage) {}
+    std::string name() const override { return "latency_putimage"; }
+    std::string description() const override { return "XPutImage issue-to-pixel latency"; }
+};
+REGISTER_BENCH(BenchLatencyPutImage)
+
+} // namespace x11bench
@@ -0,0 +1,402 @@
+#include "bench_base.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Xlibint gives access to Xlib's reply queue (async reply handlers), which
+// the public API only uses internally; it defines min/max macros
+#include <X11/Xlibint.h>
+#undef min
+#undef max
+
+namespace x11bench {
+
+// =============================================================================
+// Reply Pipelining
+// =============================================================================
+// Public Xlib calls wait for each reply before the next request, so they
+// never exercise a deep reply queue. Each step here issues K reply-bearing
+// requests of one kind back to back, reading none of them. The first K - 1
+// replies go to an async reply handler registered the way XInternAtoms() and
+// XGetWindowAttributes() register theirs. The step then waits for the last
+// reply, by which time the earlier ones have been handled. Every reply is
+// checked against what its request asked for: the atom interned for that
+// name, the size of that pixmap, the pixel at that position, the RGB of that
+// color. The runner fits step time against K, so a reply queue that grows
+// superlinearly or stalls on buffering is flagged.
+
+enum class PipelinedRequest { InternAtom, GetGeometry, GetImage, QueryColors };
+
+namespace {
+constexpr int PALETTE_SIZE = 256;   // 16x16 blocks of the source pixmap
+constexpr int PALETTE_BLOCK = 4;
+constexpr int PIXMAPS = 64;         // Distinct sizes for GetGeometry
+} // namespace
+
+class PipelineDepth : public BenchBase {
+public:
+    explicit PipelineDepth(PipelinedRequest kind)
+        : kind_(kind) {
+    }
+
+    uint32_t width() const override { return 64; }
+    uint32_t height() const override { return 64; }
+    std::string unit() const override { return "batches"; }
+    int default_iterations() const override { return 50; }
+    std::vector<int> sweep() const override { return {1, 10, 100, 1000, 10000}; }
+    std::string sweep_label() const override { return "depth"; }
+    bool fits_complexity() const override { return true; }
+    bool is_self_verifying() const override { return true; }
+
+    void setup(Display& display) override;
+    void step(Display& display, int iteration) override;
+    void teardown(Display& display) override;
+
+    std::string failure_reason() const override { return failure_; }
+
+    std::string summary() const override {
+        if (busy_ms_ <= 0.0) {
+            return "";
+        }
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        out.precision(0);
+        out << replies_ * 1000.0 / busy_ms_ << " replies/s";
+        return out.str();
+    }
+
+    // Words of reply data kept beyond the header; exact, as a shorter reply
+    // than announced is an Xlib I/O error
+    int extra_words() const {
+        switch (kind_) {
+            case PipelinedRequest::GetImage: return 1;
+            case PipelinedRequest::QueryColors: return 2;
+            default: return 0;
+        }
+    }
+
+    // Called for every reply, in the handler or after the final _XReply;
+    // `reply` holds the 32-byte header plus extra_words() of data
+    void check(size_t index, const char* reply);
+
+private:
+    PipelinedRequest kind_;
+    std::string failure_;
+    uint64_t replies_ = 0;
+    double busy_ms_ = 0.0;
+    std::vector<char> answered_;   // Per request of the current step
+
+    // Request payloads and the replies they must produce
+    std::vector<std::string> atom_names_;
+    std::vector<Atom> atoms_;
+    std::vector<Pixmap> pixmaps_;
+    Pixmap source_ = 0;
+    int bytes_per_pixel_ = 4;
+    bool msb_first_ = false;
+    unsigned long pixel_mask_ = 0;
+    Colormap colormap_ = 0;
+    std::vector<XColor> colors_;
+
+    void issue(::Display* dpy, size_t index);
+
+    void fail(size_t index, const std::string& reason) {
+        if (failure_.empty()) {
+            failure_ = "request " + std::to_string(index) + ": " + reason;
+        }
+    }
+};
+
+namespace {
+struct PipelineState {
+    PipelineDepth* bench;
+    unsigned long first;   // Sequence number of request 0
+    unsigned long last;    // Last sequence number the handler takes
+};
+
+Bool handle_reply(::Display* dpy, xReply* rep, char* buf, int len, XPointer data) {
+    auto* state = reinterpret_cast<PipelineState*>(data);
+    unsigned long seq = dpy->last_request_read;
+    if (seq < state->first || seq > state->last) {
+        return False;
+    }
+    // Errors go on to the error handler and leave the request unanswered
+    if (rep->generic.type == X_Error) {
+        return False;
+    }
+    alignas(8) char reply[sizeof(xReply) + 8];
+    auto* full = _XGetAsyncReply(dpy, reply, rep, buf, len,
+                                 state->bench->extra_words(), True);
+    state->bench->check(seq - state->first, reinterpret_cast<const char*>(full));
+    return True;
+}
+} // namespace
+
+void PipelineDepth::setup(Display& display) {
+    ::Display* dpy = display.x_display();
+    failure_.clear();
+    replies_ = 0;
+    busy_ms_ = 0.0;
+
+    switch (kind_) {
+        case PipelinedRequest::InternAtom: {
+            // Interned once through Xlib; the pipelined requests must return
+            // the same atoms
+            atom_names_.clear();
+            for (int i = 0; i < param_; i++) {
+                atom_names_.push_back("X11BENCH_PIPELINE_" + std::to_string(i));
+            }
+            std::vector<char*> names;
+            for (auto& name : atom_names_) {
+                names.push_back(&name[0]);
+            }
+            atoms_.assign(param_, None);
+            XInternAtoms(dpy, names.data(), param_, False, atoms_.data());
+            break;
+        }
+        case PipelinedRequest::GetGeometry:
+            for (int i = 0; i < PIXMAPS; i++) {
+                pixmaps_.push_back(display.create_pixmap(1 + i, 1 + 2 * i, display.depth()));
+            }
+            break;
+        case PipelinedRequest::GetImage: {
+            source_ = display.create_pixmap(16 * PALETTE_BLOCK, 16 * PALETTE_BLOCK,
+                                            display.depth());
+            GC gc = display.create_gc_for_pixmap(source_);
+            for (int i = 0; i < PALETTE_SIZE; i++) {
+                XSetForeground(dpy, gc, display.alloc_color(static_cast<uint8_t>(i),
+                                                            static_cast<uint8_t>(255 - i),
+                                                            static_cast<uint8_t>(i * 37)));
+                XFillRectangle(dpy, source_, gc, (i % 16) * PALETTE_BLOCK,
+                               (i / 16) * PALETTE_BLOCK, PALETTE_BLOCK, PALETTE_BLOCK);
+            }
+            display.free_gc(gc);
+
+            // Expected pixels come from an ordinary XGetImage of the pixmap
+            XImage* image = XGetImage(dpy, source_, 0, 0, 16 * PALETTE_BLOCK,
+                                      16 * PALETTE_BLOCK, AllPlanes, ZPixmap);
+            if (!image) {
+                failure_ = "cannot read back the source pixmap";
+                break;
+            }
+            colors_.assign(PALETTE_SIZE, XColor{});
+            for (int i = 0; i < PALETTE_SIZE; i++) {
+                colors_[i].pixel = XGetPixel(image, (i % 16) * PALETTE_BLOCK,
+                                             (i / 16) * PALETTE_BLOCK);
+            }
+            bytes_per_pixel_ = image->bits_per_pixel / 8;
+            msb_first_ = image->byte_order == MSBFirst;
+            XDestroyImage(image);
+            Visual* visual = display.visual();
+            pixel_mask_ = visual->red_mask | visual->green_mask | visual->blue_mask;
+            if (bytes_per_pixel_ < 1 || bytes_per_pixel_ > 4) {
+                failure_ = "unsupported pixel size";
+            }
+            break;
+        }
+        case PipelinedRequest::QueryColors:
+            colormap_ = display.colormap();
+            colors_.assign(PALETTE_SIZE, XColor{});
+            for (int i = 0; i < PALETTE_SIZE; i++) {
+                colors_[i].pixel = display.alloc_color(static_cast<uint8_t>(i * 7),
+                                                       static_cast<uint8_t>(i),
+                                                       static_cast<uint8_t>(255 - i));
+            }
+            XQueryColors(dpy, colormap_, colors_.data(), PALETTE_SIZE);
+            break;
+    }
+}
+
+void PipelineDepth::step(Display& display, int iteration) {
+    (void)iteration;
+    if (!failure_.empty()) {
+        return;
+    }
+    ::Display* dpy = display.x_display();
+    size_t depth = static_cast<size_t>(param_);
+    answered_.assign(depth, 0);
+    auto start = std::chrono::steady_clock::now();
+
+    LockDisplay(dpy);
+    // Registered before the first request: a full output buffer makes Xlib
+    // read incoming replies while it waits to write
+    PipelineState state = {this, NextRequest(dpy), NextRequest(dpy) + depth - 2};
+    _XAsyncHandler async;
+    if (depth > 1) {
+        async.next = dpy->async_handlers;
+        async.handler = handle_reply;
+        async.data = reinterpret_cast<XPointer>(&state);
+        dpy->async_handlers = &async;
+    }
+    for (size_t i = 0; i < depth; i++) {
+        issue(dpy, i);
+    }
+    alignas(8) char reply[sizeof(xReply) + 8];
+    if (_XReply(dpy, reinterpret_cast<xReply*>(reply), extra_words(), xTrue)) {
+        check(depth - 1, reply);
+    }
+    if (depth > 1) {
+        DeqAsyncHandler(dpy, &async);
+    }
+    UnlockDisplay(dpy);
+    SyncHandle();
+
+    busy_ms_ += std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < depth; i++) {
+        if (!answered_[i]) {
+            fail(i, "no reply");
+            break;
+        }
+    }
+}
+
+void PipelineDepth::teardown(Display& display) {
+    for (Pixmap pixmap : pixmaps_) {
+        display.free_pixmap(pixmap);
+    }
+    pixmaps_.clear();
+    if (source_) {
+        display.free_pixmap(source_);
+        source_ = 0;
+    }
+}
+
+void PipelineDepth::issue(::Display* dpy, size_t index) {
+    switch (kind_) {
+        case PipelinedRequest::InternAtom: {
+            const std::string& name = atom_names_[index];
+            xInternAtomReq* req;
+            GetReq(InternAtom, req);
+            req->onlyIfExists = xFalse;
+            req->nbytes = static_cast<CARD16>(name.size());
+            req->length += (name.size() + 3) >> 2;
+            Data(dpy, name.data(), static_cast<long>(name.size()));
+            break;
+        }
+        case PipelinedRequest::GetGeometry: {
+            xResourceReq* req;
+            GetResReq(GetGeometry, pixmaps_[index % PIXMAPS], req);
+            break;
+        }
+        case PipelinedRequest::GetImage: {
+            int block = static_cast<int>(index % PALETTE_SIZE);
+            xGetImageReq* req;
+            GetReq(GetImage, req);
+            req->drawable = source_;
+            req->x = static_cast<INT16>((block % 16) * PALETTE_BLOCK + PALETTE_BLOCK / 2);
+            req->y = static_cast<INT16>((block / 16) * PALETTE_BLOCK + PALETTE_BLOCK / 2);
+            req->width = 1;
+            req->height = 1;
+            req->planeMask = static_cast<CARD32>(AllPlanes);
+            req->format = ZPixmap;
+            break;
+        }
+        case PipelinedRequest::QueryColors: {
+            long pixel = static_cast<long>(colors_[index % PALETTE_SIZE].pixel);
+            xQueryColorsReq* req;
+            GetReq(QueryColors, req);
+            req->cmap = colormap_;
+            req->length += 1;
+            Data32(dpy, &pixel, 4);
+            break;
+        }
+    }
+}
+
+void PipelineDepth::check(size_t index, const char* reply) {
+    if (index >= answered_.size() || answered_[index]) {
+        fail(index, "unexpected reply");
+        return;
+    }
+    answered_[index] = 1;
+    replies_++;
+
+    switch (kind_) {
+        case PipelinedRequest::InternAtom: {
+            auto* rep = reinterpret_cast<const xInternAtomReply*>(reply);
+            if (rep->atom != atoms_[index]) {
+                fail(index, "atom " + std::to_string(rep->atom) + " for " +
+                     atom_names_[index] + ", expected " + std::to_string(atoms_[index]));
+            }
+            break;
+        }
+        case PipelinedRequest::GetGeometry: {
+            auto* rep = reinterpret_cast<const xGetGeometryReply*>(reply);
+            int i = static_cast<int>(index % PIXMAPS);
+            if (rep->width != 1 + i || rep->height != 1 + 2 * i) {
+                fail(index, "geometry " + std::to_string(rep->width) + "x" +
+                     std::to_string(rep->height) + " for pixmap " + std::to_string(i));
+            }
+            break;
+        }
+        case PipelinedRequest::GetImage: {
+            auto* data = reinterpret_cast<const unsigned char*>(reply + sizeof(xGetImageReply));
+            unsigned long pixel = 0;
+            for (int b = 0; b < bytes_per_pixel_; b++) {
+                int byte = msb_first_ ? b : bytes_per_pixel_ - 1 - b;
+                pixel = (pixel << 8) | data[byte];
+            }
+            unsigned long expected = colors_[index % PALETTE_SIZE].pixel;
+            if ((pixel & pixel_mask_) != (expected & pixel_mask_)) {
+                std::ostringstream out;
+                out << "pixel 0x" << std::hex << pixel << ", expected 0x" << expected;
+                fail(index, out.str());
+            }
+            break;
+        }
+        case PipelinedRequest::QueryColors: {
+            auto* rep = reinterpret_cast<const xQueryColorsReply*>(reply);
+            auto* rgb = reinterpret_cast<const xrgb*>(reply + sizeof(xQueryColorsReply));
+            const XColor& expected = colors_[index % PALETTE_SIZE];
+            if (rep->nColors != 1 || rgb->red != expected.red || rgb->green != expected.green ||
+                rgb->blue != expected.blue) {
+                fail(index, "wrong color for pixel " + std::to_string(expected.pixel));
+            }
+            break;
+        }
+    }
+}
+
+class BenchPipelineInternAtom : public PipelineDepth {
+public:
+    BenchPipelineInternAtom() : PipelineDepth(PipelinedRequest::InternAtom) {}
+    std::string name() const override { return "pipeline_intern_atom"; }
+    std::string description() const override {
+        return "InternAtom replies outstanding against pipeline depth";
+    }
+};
+REGISTER_BENCH(BenchPipelineInternAtom)
+
+class BenchPipelineGetGeometry : public PipelineDepth {
+public:
+    BenchPipelineGetGeometry() : PipelineDepth(PipelinedRequest::GetGeometry) {}
+    std::string name() const override { return "pipeline_get_geometry"; }
+    std::string description() const override {
+        return "GetGeometry replies outstanding against pipeline depth";
+    }
+};
+REGISTER_BENCH(BenchPipelineGetGeometry)
+
+class BenchPipelineGetImage : public PipelineDepth {
+public:
+    BenchPipelineGetImage() : PipelineDepth(PipelinedRequest::GetImage) {}
+    std::string name() const override { return "pipeline_get_image"; }
+    std::string description() const override {
+        return "1x1 GetImage replies outstanding against pipeline depth";
+    }
+};
+REGISTER_BENCH(BenchPipelineGetImage)
+
+class BenchPipelineQueryColors : public PipelineDepth {
+public:
+    BenchPipelineQueryColors() : PipelineDepth(PipelinedRequest::QueryColors) {}
+    std::string name() const override { return "pipeline_query_colors"; }
+    std::string description() const override {
+        return "QueryColors replies outstanding against pipeline depth";
+    }
+};
+REGISTER_BENCH(BenchPipelineQueryColors)
+
+} // namespace x11bench
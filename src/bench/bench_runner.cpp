@@ -0,0 +1,216 @@
+#include "bench_runner.hpp"
+#include "../capture.hpp"
+#include "../compare.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_YELLOW  "\033[33m"
+#define COLOR_RESET   "\033[0m"
+
+namespace x11bench {
+
+std::vector<BenchInfo>& get_bench_registry() {
+    static std::vector<BenchInfo> registry;
+    return registry;
+}
+
+void register_bench(const std::string& name, BenchFactory factory) {
+    get_bench_registry().push_back({name, factory});
+}
+
+LatencyStats LatencyStats::from_samples(std::vector<double> samples_ms) {
+    LatencyStats stats;
+    if (samples_ms.empty()) {
+        return stats;
+    }
+    std::sort(samples_ms.begin(), samples_ms.end());
+
+    // Nearest-rank percentiles
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples_ms.size()));
+        return samples_ms[std::min(samples_ms.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+
+    stats.count = samples_ms.size();
+    for (double sample : samples_ms) {
+        stats.total_ms += sample;
+    }
+    stats.mean_ms = stats.total_ms / stats.count;
+    stats.p50_ms = percentile(50);
+    stats.p95_ms = percentile(95);
+    stats.p99_ms = percentile(99);
+    stats.max_ms = samples_ms.back();
+    return stats;
+}
+
+BenchRunner::BenchRunner(const BenchOptions& options)
+    : options_(options) {
+}
+
+bool BenchRunner::run(const std::vector<BenchInfo>& benches) {
+    Display display;
+    if (!display.connect(options_.display_name)) {
+        std::cerr << "Failed to connect to X display" << std::endl;
+        return false;
+    }
+
+    for (const auto& info : benches) {
+        auto bench = info.factory();
+        std::vector<int> values = bench->sweep();
+        if (values.empty()) {
+            values.push_back(0);
+        }
+        std::vector<double> sizes;
+        std::vector<double> medians_ms;
+        bool sweep_failed = false;
+        for (int value : values) {
+            bench->set_param(value);
+            BenchResult result = run_one(display, *bench);
+            if (!bench->sweep().empty()) {
+                result.name += "[" + bench->sweep_label() + "=" + std::to_string(value) + "]";
+                result.param = value;
+            }
+            sizes.push_back(value);
+            medians_ms.push_back(result.latency.p50_ms);
+            sweep_failed = sweep_failed || result.failed;
+            report(result);
+            results_.push_back(std::move(result));
+        }
+
+        // Timings of a failed size don't describe the workload
+        if (bench->fits_complexity() && !sweep_failed) {
+            report_fit(bench->name(), fit_complexity(sizes, medians_ms));
+        }
+    }
+    return true;
+}
+
+BenchResult BenchRunner::run_one(Display& display, BenchBase& bench) {
+    BenchResult result;
+    result.name = bench.name();
+    result.unit = bench.unit();
+
+    if (!display.create_window(bench.width(), bench.height(), "x11bench: " + bench.name())) {
+        result.failed = true;
+        result.message = "failed to create window";
+        return result;
+    }
+    display.show_window();
+    display.wait_for_expose(2000);
+
+    display.mark(bench.name() + ": setup");
+    bench.setup(display);
+    display.sync();
+
+    int iterations = options_.iterations > 0 ? options_.iterations : bench.default_iterations();
+    std::vector<double> samples;
+    samples.reserve(iterations);
+
+    display.mark(bench.name() + ": step");
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        bench.step(display, i);
+        if (!bench.self_timed()) {
+            display.sync();
+        }
+        samples.push_back(std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    result.latency = LatencyStats::from_samples(std::move(samples));
+    if (result.latency.total_ms > 0) {
+        result.per_second = result.latency.count * 1000.0 / result.latency.total_ms;
+    }
+
+    // Compare the incrementally drawn window against a from-scratch redraw
+    display.mark(bench.name() + ": verify");
+    try {
+        Image actual = Capture::capture_window(display);
+        if (bench.render_expected(display, iterations)) {
+            display.sync();
+            Image expected = Capture::capture_window(display);
+            CompareResult cmp = Compare::exact(expected, actual);
+            result.verified = cmp.match;
+            if (!cmp.match) {
+                result.failed = true;
+                result.message = "final frame differs from full redraw: " + cmp.message;
+                if (options_.save_failures) {
+                    actual.save_png(bench.name() + "_bench_actual.png");
+                    expected.save_png(bench.name() + "_bench_expected.png");
+                    Compare::generate_diff(expected, actual)
+                        .save_png(bench.name() + "_bench_diff.png");
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        result.failed = true;
+        result.message = std::string("capture failed: ") + e.what();
+    }
+
+    std::string reason = bench.failure_reason();
+    if (!reason.empty()) {
+        result.failed = true;
+        result.message += (result.message.empty() ? "" : "; ") + reason;
+    } else if (bench.is_self_verifying()) {
+        result.verified = true;
+    }
+    result.summary = bench.summary();
+    bench.teardown(display);
+    for (const auto& error : display.take_errors()) {
+        result.failed = true;
+        result.message += (result.message.empty() ? "" : "; ") + display.describe_error(error);
+    }
+    display.destroy_window();
+    return result;
+}
+
+void BenchRunner::report(const BenchResult& result) const {
+    std::cout << std::left << std::setw(32) << result.name << " " << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << result.per_second << " "
+              << result.unit << "/s"
+              << std::setprecision(3)
+              << "  p50 " << result.latency.p50_ms
+              << "  p95 " << result.latency.p95_ms
+              << "  p99 " << result.latency.p99_ms << " ms  ";
+    if (result.failed) {
+        std::cout << COLOR_RED << "[FAIL]" << COLOR_RESET << " " << result.message;
+    } else if (result.verified) {
+        std::cout << COLOR_GREEN << "[OK]" << COLOR_RESET;
+    } else {
+        std::cout << COLOR_YELLOW << "[UNVERIFIED]" << COLOR_RESET;
+    }
+    if (!result.summary.empty()) {
+        std::cout << " (" << result.summary << ")";
+    }
+    if (options_.verbose) {
+        std::cout << "  (" << result.latency.count << " " << result.unit << ", mean "
+                  << result.latency.mean_ms << " ms, max " << result.latency.max_ms << " ms)";
+    }
+    std::cout << "\n";
+}
+
+void BenchRunner::report_fit(const std::string& name, const ComplexityFit& fit) const {
+    if (!fit.valid) {
+        return;
+    }
+    std::cout << "  " << std::left << std::setw(30) << name << std::right << " fits "
+              << fit.model << std::setprecision(3);
+    if (fit.coefficient > 0.0) {
+        std::cout << std::scientific << "  " << fit.coefficient << " ms/unit" << std::fixed
+                  << " + " << fit.intercept_ms << " ms";
+    }
+    std::cout << std::setprecision(1) << "  (residual " << fit.residual_percent << "%)";
+    if (fit.superlinear) {
+        std::cout << "  " << COLOR_YELLOW << "[SUPERLINEAR]" << COLOR_RESET;
+    }
+    std::cout << "\n";
+}
+
+} // namespace x11bench
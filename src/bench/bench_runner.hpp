@@ -0,0 +1,60 @@
+#pragma once
+
+#include "bench_base.hpp"
+#include "complexity.hpp"
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+struct BenchOptions {
+    std::string display_name;
+    int iterations = 0;        // 0 uses each benchmark's default
+    bool verbose = false;
+    bool save_failures = false;
+};
+
+// Distribution of per-step wall times
+struct LatencyStats {
+    size_t count = 0;
+    double total_ms = 0.0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+
+    static LatencyStats from_samples(std::vector<double> samples_ms);
+};
+
+struct BenchResult {
+    std::string name;          // With "[label=value]" for sweep rows
+    int param = 0;             // Sweep value
+    std::string unit;
+    LatencyStats latency;
+    double per_second = 0.0;
+    bool verified = false;     // render_expected() matched the final window
+    bool failed = false;       // Mismatch, X error or setup failure
+    std::string message;
+    std::string summary;       // BenchBase::summary()
+};
+
+class BenchRunner {
+public:
+    explicit BenchRunner(const BenchOptions& options);
+
+    // Runs each benchmark in its own window on one connection
+    bool run(const std::vector<BenchInfo>& benches);
+
+    const std::vector<BenchResult>& results() const { return results_; }
+
+private:
+    BenchOptions options_;
+    std::vector<BenchResult> results_;
+
+    BenchResult run_one(Display& display, BenchBase& bench);
+    void report(const BenchResult& result) const;
+    void report_fit(const std::string& name, const ComplexityFit& fit) const;
+};
+
+} // namespace x11bench
@@ -0,0 +1,195 @@
+#include "bench_base.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// =============================================================================
+// CopyArea Scrolling
+// =============================================================================
+// Terminals and editors scroll by copying the window onto itself and painting
+// the strip that scrolled in. With graphics exposures on, the server answers
+// every copy with NoExpose, or with GraphicsExpose for destination areas whose
+// source was obscured; a correct client waits for those and repaints them.
+// Each step scrolls by 1-8 pixels, handles the exposure events and repaints.
+
+class ScrollWorkload : public BenchBase {
+public:
+    explicit ScrollWorkload(bool obscured)
+        : obscured_(obscured) {
+    }
+
+    uint32_t width() const override { return 800; }
+    uint32_t height() const override { return 600; }
+    std::string unit() const override { return "scrolls"; }
+    int default_iterations() const override { return 1000; }
+
+    void setup(Display& display) override {
+        font_ = display.load_font("monospace", 11);
+        if (!font_) font_ = display.load_font("fixed", 11);
+
+        for (const auto& c : BAND_COLORS) {
+            pixels_.push_back(display.alloc_color(c[0], c[1], c[2]));
+        }
+        line_pixel_ = display.alloc_color(0, 0, 0);
+
+        // Exposures on, as toolkits and terminals leave them
+        scroll_gc_ = display.create_gc_for_window(display.x_window());
+        XSetGraphicsExposures(display.x_display(), scroll_gc_, True);
+
+        if (obscured_) {
+            // A child window over part of the view (a popup or an overlay
+            // scrollbar) hides source pixels, so copies raise GraphicsExpose
+            overlay_ = XCreateSimpleWindow(display.x_display(), display.x_window(),
+                                           560, 180, 180, 120, 0, 0,
+                                           display.alloc_color(255, 255, 200));
+            XMapWindow(display.x_display(), overlay_);
+        }
+
+        offset_ = 0;
+        graphics_exposes_ = 0;
+        no_exposes_ = 0;
+        draw_area(display, {0, 0, static_cast<unsigned short>(width()),
+                            static_cast<unsigned short>(height())});
+    }
+
+    void step(Display& display, int iteration) override {
+        int dy = scroll_amount(iteration);
+        offset_ += dy;
+
+        ::Display* dpy = display.x_display();
+        ::Window win = display.x_window();
+        XCopyArea(dpy, win, win, scroll_gc_, 0, dy, width(), height() - dy, 0, 0);
+        draw_area(display, {0, static_cast<short>(height() - dy),
+                            static_cast<unsigned short>(width()),
+                            static_cast<unsigned short>(dy)});
+
+        // One NoExpose, or GraphicsExpose events until count reaches 0
+        while (true) {
+            XEvent event;
+            XIfEvent(dpy, &event, &ScrollWorkload::is_copy_exposure,
+                     reinterpret_cast<XPointer>(win));
+            if (event.type == NoExpose) {
+                no_exposes_++;
+                break;
+            }
+            const XGraphicsExposeEvent& ge = event.xgraphicsexpose;
+            graphics_exposes_++;
+            draw_area(display, {static_cast<short>(ge.x), static_cast<short>(ge.y),
+                                static_cast<unsigned short>(ge.width),
+                                static_cast<unsigned short>(ge.height)});
+            if (ge.count == 0) {
+                break;
+            }
+        }
+    }
+
+    void teardown(Display& display) override {
+        if (overlay_) {
+            XDestroyWindow(display.x_display(), overlay_);
+            overlay_ = 0;
+        }
+        if (scroll_gc_) {
+            display.free_gc(scroll_gc_);
+            scroll_gc_ = nullptr;
+        }
+        if (font_) {
+            display.free_font(font_);
+            font_ = nullptr;
+        }
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        offset_ = 0;
+        for (int i = 0; i < iterations; i++) {
+            offset_ += scroll_amount(i);
+        }
+        draw_area(display, {0, 0, static_cast<unsigned short>(width()),
+                            static_cast<unsigned short>(height())});
+        return true;
+    }
+
+    std::string summary() const override {
+        return std::to_string(graphics_exposes_) + " GraphicsExpose, " +
+               std::to_string(no_exposes_) + " NoExpose";
+    }
+
+private:
+    static constexpr int BAND_HEIGHT = 16;
+    static constexpr uint8_t BAND_COLORS[8][3] = {
+        {250, 250, 250}, {235, 240, 250}, {250, 235, 235}, {235, 250, 235},
+        {245, 245, 220}, {230, 230, 245}, {245, 230, 245}, {225, 245, 245}
+    };
+
+    bool obscured_;
+    XftFont* font_ = nullptr;
+    std::vector<unsigned long> pixels_;
+    unsigned long line_pixel_ = 0;
+    GC scroll_gc_ = nullptr;
+    ::Window overlay_ = 0;
+    long offset_ = 0;            // Content row shown at the top of the window
+    long graphics_exposes_ = 0;
+    long no_exposes_ = 0;
+
+    static int scroll_amount(int iteration) {
+        return 1 + iteration % 8;
+    }
+
+    static Bool is_copy_exposure(::Display*, XEvent* event, XPointer window) {
+        return (event->type == GraphicsExpose || event->type == NoExpose) &&
+               event->xany.window == reinterpret_cast<::Window>(window);
+    }
+
+    // Paint the content bands that fall into `area` at the current offset
+    void draw_area(Display& display, const XRectangle& area) {
+        if (area.width == 0 || area.height == 0) {
+            return;
+        }
+        XRectangle rect = area;
+        display.set_clip_rectangles(0, 0, &rect, 1, Unsorted);
+        display.set_text_clip(&rect, 1);
+
+        long first = (offset_ + area.y) / BAND_HEIGHT;
+        long last = (offset_ + area.y + area.height - 1) / BAND_HEIGHT;
+        for (long band = first; band <= last; band++) {
+            int y = static_cast<int>(band * BAND_HEIGHT - offset_);
+            display.set_foreground(pixels_[band % 8]);
+            display.draw_rectangle(0, y, width(), BAND_HEIGHT, true);
+
+            // A slanted stroke per band shows any row the copy got wrong
+            int x = 120 + static_cast<int>(band * 37 % 600);
+            display.set_foreground(line_pixel_);
+            display.draw_line(x, y, x + BAND_HEIGHT - 1, y + BAND_HEIGHT - 1);
+
+            display.draw_text(font_, 6, y + 12, std::to_string(band) + "  scrolled text line",
+                              40, 40, 40);
+        }
+
+        display.set_clip_mask(None);
+        display.set_text_clip(nullptr, 0);
+    }
+};
+
+class BenchScrollCopyArea : public ScrollWorkload {
+public:
+    BenchScrollCopyArea() : ScrollWorkload(false) {}
+    std::string name() const override { return "scroll_copyarea"; }
+    std::string description() const override {
+        return "Self-copy scroll by 1-8 px per step, NoExpose handled per step";
+    }
+};
+REGISTER_BENCH(BenchScrollCopyArea)
+
+class BenchScrollObscured : public ScrollWorkload {
+public:
+    BenchScrollObscured() : ScrollWorkload(true) {}
+    std::string name() const override { return "scroll_copyarea_obscured"; }
+    std::string description() const override {
+        return "Self-copy scroll under a child window, repainting GraphicsExpose areas";
+    }
+};
+REGISTER_BENCH(BenchScrollObscured)
+
+} // namespace x11bench
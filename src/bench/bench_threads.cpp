@@ -0,0 +1,335 @@
+#include "bench_base.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace x11bench {
+
+// =============================================================================
+// Multithreaded Xlib
+// =============================================================================
+// N worker threads draw into their own cell of the window, each with its own
+// GC, either all through the runner's connection (Xlib's display lock
+// serializes them) or each through a connection of its own. A step is one
+// round: every thread fills the 64 blocks of its cell in batches of 8 under
+// XLockDisplay, then reads back its last block with XGetImage. The time spent
+// acquiring the lock and holding it per batch is summed per thread; the
+// readback checks that replies reach the thread that asked for them and show
+// that thread's latest color. The final frame is checked against a
+// single-threaded redraw, so a lost or corrupted request shows as a wrong
+// block.
+
+namespace {
+constexpr int CELL = 128;
+constexpr int BLOCK = 16;
+constexpr int BLOCKS_PER_ROW = CELL / BLOCK;
+constexpr int BLOCKS = BLOCKS_PER_ROW * BLOCKS_PER_ROW;
+constexpr int BATCH = 8;          // Blocks drawn per XLockDisplay
+constexpr int CELLS_PER_ROW = 4;
+constexpr int PALETTE_SIZE = 16;
+} // namespace
+
+class ThreadStress : public BenchBase {
+public:
+    explicit ThreadStress(bool shared)
+        : shared_(shared) {
+    }
+
+    uint32_t width() const override { return CELL * CELLS_PER_ROW; }
+    uint32_t height() const override { return CELL * 2; }
+    std::string unit() const override { return "rounds"; }
+    int default_iterations() const override { return 200; }
+    std::vector<int> sweep() const override { return {1, 2, 4, 8}; }
+    std::string sweep_label() const override { return "threads"; }
+    bool needs_threads() const override { return true; }
+
+    void setup(Display& display) override {
+        failure_.clear();
+        rounds_ = 0;
+        busy_ms_ = 0.0;
+        window_ = display.x_window();
+        Visual* visual = display.visual();
+        pixel_mask_ = visual->red_mask | visual->green_mask | visual->blue_mask;
+
+        background_ = display.alloc_color(0, 0, 0);
+        palette_.clear();
+        for (int i = 0; i < PALETTE_SIZE; i++) {
+            palette_.push_back(display.alloc_color(static_cast<uint8_t>(30 + i * 14),
+                                                   static_cast<uint8_t>(220 - i * 9),
+                                                   static_cast<uint8_t>((i * 53) % 256)));
+        }
+        display.set_foreground(background_);
+        display.draw_rectangle(0, 0, width(), height(), true);
+
+        std::string display_name = DisplayString(display.x_display());
+        for (int t = 0; t < param_; t++) {
+            auto worker = std::make_unique<Worker>();
+            worker->dpy = display.x_display();
+            if (!shared_) {
+                worker->own = std::make_unique<Display>();
+                if (!worker->own->connect(display_name)) {
+                    fail("thread " + std::to_string(t) + ": cannot open a connection");
+                    break;
+                }
+                worker->dpy = worker->own->x_display();
+            }
+            worker->gc = XCreateGC(worker->dpy, window_, 0, nullptr);
+            XSync(worker->dpy, False);
+            workers_.push_back(std::move(worker));
+        }
+        if (static_cast<int>(workers_.size()) != param_) {
+            return;
+        }
+
+        stopping_ = false;
+        generation_ = 0;
+        for (int t = 0; t < param_; t++) {
+            workers_[t]->thread = std::thread(&ThreadStress::work, this, t);
+        }
+    }
+
+    void step(Display& display, int iteration) override {
+        (void)display;
+        if (static_cast<int>(workers_.size()) != param_) {
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mutex_);
+        iteration_ = iteration;
+        done_ = 0;
+        generation_++;
+        wake_.notify_all();
+        finished_.wait(lock, [this]() { return done_ == static_cast<int>(workers_.size()); });
+        busy_ms_ += std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        rounds_++;
+    }
+
+    void teardown(Display& display) override {
+        (void)display;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for (auto& worker : workers_) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+            if (worker->gc) {
+                XFreeGC(worker->dpy, worker->gc);
+            }
+            if (worker->own) {
+                worker->own->disconnect();
+            }
+        }
+        workers_.clear();
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        if (static_cast<int>(workers_.size()) != param_) {
+            return false;
+        }
+        display.set_foreground(background_);
+        display.draw_rectangle(0, 0, width(), height(), true);
+        if (iterations == 0) {
+            return true;
+        }
+        for (int t = 0; t < param_; t++) {
+            for (int k = 0; k < BLOCKS; k++) {
+                int x, y;
+                block_origin(t, k, x, y);
+                display.set_foreground(color(t, iterations - 1, k));
+                display.draw_rectangle(x, y, BLOCK, BLOCK, true);
+            }
+        }
+        return true;
+    }
+
+    std::string failure_reason() const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return failure_;
+    }
+
+    std::string summary() const override {
+        double wait_ms = 0.0;
+        double hold_ms = 0.0;
+        uint64_t batches = 0;
+        for (const auto& worker : workers_) {
+            wait_ms += worker->wait_ms;
+            hold_ms += worker->hold_ms;
+            batches += worker->batches;
+        }
+        if (busy_ms_ <= 0.0 || batches == 0) {
+            return "";
+        }
+
+        double fills_per_second = rounds_ * param_ * BLOCKS * 1000.0 / busy_ms_;
+        if (param_ == 1) {
+            baseline_ = fills_per_second;
+        }
+        std::ostringstream out;
+        out.setf(std::ios::fixed);
+        out.precision(0);
+        out << fills_per_second << " fills/s";
+        out.precision(2);
+        if (baseline_ > 0.0 && param_ > 1) {
+            out << ", x" << fills_per_second / baseline_ << " vs 1 thread";
+        }
+        out.precision(1);
+        out << ", lock wait " << wait_ms * 1000.0 / batches << " us, hold "
+            << hold_ms * 1000.0 / batches << " us per batch";
+        return out.str();
+    }
+
+private:
+    struct Worker {
+        std::unique_ptr<Display> own;  // Own-connection mode only
+        ::Display* dpy = nullptr;
+        GC gc = nullptr;
+        std::thread thread;
+        double wait_ms = 0.0;          // Acquiring XLockDisplay
+        double hold_ms = 0.0;          // Issuing a batch under the lock
+        uint64_t batches = 0;
+    };
+
+    bool shared_;
+    ::Window window_ = 0;
+    unsigned long pixel_mask_ = 0;
+    unsigned long background_ = 0;
+    std::vector<unsigned long> palette_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // Round hand-off between step() and the workers
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    uint64_t generation_ = 0;
+    int iteration_ = 0;
+    int done_ = 0;
+    bool stopping_ = false;
+    std::string failure_;
+
+    int rounds_ = 0;
+    double busy_ms_ = 0.0;
+    mutable double baseline_ = 0.0;   // Fills per second of the 1-thread row
+
+    void block_origin(int thread, int block, int& x, int& y) const {
+        x = (thread % CELLS_PER_ROW) * CELL + (block % BLOCKS_PER_ROW) * BLOCK;
+        y = (thread / CELLS_PER_ROW) * CELL + (block / BLOCKS_PER_ROW) * BLOCK;
+    }
+
+    // Consecutive rounds give every block a different color
+    unsigned long color(int thread, int iteration, int block) const {
+        return palette_[(thread * 5 + iteration * 3 + block) % PALETTE_SIZE];
+    }
+
+    void fail(const std::string& reason) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failure_.empty()) {
+            failure_ = reason;
+        }
+    }
+
+    void work(int thread) {
+        uint64_t seen = 0;
+        while (true) {
+            int iteration;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+                seen = generation_;
+                iteration = iteration_;
+            }
+            draw_round(thread, iteration);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_++;
+            }
+            finished_.notify_one();
+        }
+    }
+
+    void draw_round(int thread, int iteration) {
+        using Clock = std::chrono::steady_clock;
+        Worker& worker = *workers_[thread];
+        ::Display* dpy = worker.dpy;
+
+        for (int k = 0; k < BLOCKS; k += BATCH) {
+            auto requested = Clock::now();
+            XLockDisplay(dpy);
+            auto acquired = Clock::now();
+            for (int j = k; j < k + BATCH; j++) {
+                int x, y;
+                block_origin(thread, j, x, y);
+                XSetForeground(dpy, worker.gc, color(thread, iteration, j));
+                XFillRectangle(dpy, window_, worker.gc, x, y, BLOCK, BLOCK);
+            }
+            auto released = Clock::now();
+            XUnlockDisplay(dpy);
+            worker.wait_ms += std::chrono::duration<double, std::milli>(acquired - requested).count();
+            worker.hold_ms += std::chrono::duration<double, std::milli>(released - acquired).count();
+            worker.batches++;
+        }
+
+        // The reply must be this thread's and reflect its last fill
+        int x, y;
+        block_origin(thread, BLOCKS - 1, x, y);
+        XImage* image = XGetImage(dpy, window_, x + BLOCK / 2, y + BLOCK / 2, 1, 1,
+                                  AllPlanes, ZPixmap);
+        std::string prefix = "thread " + std::to_string(thread) + " round " +
+                             std::to_string(iteration) + ": ";
+        if (!image) {
+            fail(prefix + "readback failed");
+        } else {
+            unsigned long expected = color(thread, iteration, BLOCKS - 1) & pixel_mask_;
+            unsigned long actual = XGetPixel(image, 0, 0) & pixel_mask_;
+            if (actual != expected) {
+                std::ostringstream out;
+                out << prefix << "read back pixel 0x" << std::hex << actual << ", drew 0x"
+                    << expected;
+                fail(out.str());
+            }
+            XDestroyImage(image);
+        }
+
+        // Errors on the shared connection reach the runner through its own
+        // display; the readback's round trip has delivered any for this one
+        if (worker.own) {
+            for (const auto& error : worker.own->take_errors()) {
+                fail(prefix + worker.own->describe_error(error));
+            }
+        }
+    }
+};
+
+class BenchThreadsShared : public ThreadStress {
+public:
+    BenchThreadsShared() : ThreadStress(true) {}
+    std::string name() const override { return "threads_shared_display"; }
+    std::string description() const override {
+        return "N threads drawing through one XInitThreads connection";
+    }
+};
+REGISTER_BENCH(BenchThreadsShared)
+
+class BenchThreadsOwn : public ThreadStress {
+public:
+    BenchThreadsOwn() : ThreadStress(false) {}
+    std::string name() const override { return "threads_own_display"; }
+    std::string description() const override {
+        return "N threads drawing through a connection each";
+    }
+};
+REGISTER_BENCH(BenchThreadsOwn)
+
+} // namespace x11bench
@@ -0,0 +1,403 @@
+#include "bench_base.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// =============================================================================
+// Toolkit Workloads
+// =============================================================================
+// Frames shaped like GTK/Qt widget-tree redraws: per frame a few buttons change
+// state, a list view and a text view scroll with XCopyArea and repaint the
+// exposed strip, and the status bar text changes. Every widget paint sets a
+// clip, fills, draws a border and a text run, the way toolkits paint damage.
+// The final frame is checked against a from-scratch redraw of the same state.
+
+struct ToolkitParams {
+    int grid_rows = 0;          // Button grid panel; 0 disables it
+    int grid_cols = 0;
+    int changes_per_frame = 0;  // Buttons changing state per frame
+    int list_scroll_px = 0;     // List view scroll per frame; 0 disables it
+    bool text_view = false;     // Terminal-like view scrolling one line per frame
+};
+
+class ToolkitWorkload : public BenchBase {
+public:
+    explicit ToolkitWorkload(const ToolkitParams& params)
+        : params_(params) {
+    }
+
+    std::string unit() const override { return "frames"; }
+
+    void setup(Display& display) override {
+        font_ = display.load_font("sans", 11);
+        if (!font_) font_ = display.load_font("fixed", 11);
+
+        // Toolkits allocate their palette once; per-frame XAllocColor round
+        // trips would dominate the measurement
+        for (const auto& c : PALETTE) {
+            pixels_.push_back(display.alloc_color(c.r, c.g, c.b));
+        }
+
+        scroll_gc_ = display.create_gc_for_window(display.x_window());
+        XSetGraphicsExposures(display.x_display(), scroll_gc_, False);
+
+        layout(display);
+        buttons_.assign(params_.grid_rows * params_.grid_cols, 0);
+        draw_all(display, 0);
+    }
+
+    void step(Display& display, int iteration) override {
+        int frame = iteration + 1;
+
+        for (int k = 0; k < params_.changes_per_frame && !buttons_.empty(); k++) {
+            int index = changed_button(iteration, k);
+            buttons_[index] = (buttons_[index] + 1) % 3;
+            draw_button(display, index);
+        }
+        if (params_.list_scroll_px > 0) {
+            scroll_list(display, frame);
+        }
+        if (params_.text_view) {
+            scroll_text(display, frame);
+        }
+        draw_status(display, frame);
+    }
+
+    void teardown(Display& display) override {
+        if (scroll_gc_) {
+            display.free_gc(scroll_gc_);
+            scroll_gc_ = nullptr;
+        }
+        if (font_) {
+            display.free_font(font_);
+            font_ = nullptr;
+        }
+    }
+
+    bool render_expected(Display& display, int iterations) override {
+        buttons_.assign(params_.grid_rows * params_.grid_cols, 0);
+        for (int i = 0; i < iterations; i++) {
+            for (int k = 0; k < params_.changes_per_frame && !buttons_.empty(); k++) {
+                int index = changed_button(i, k);
+                buttons_[index] = (buttons_[index] + 1) % 3;
+            }
+        }
+        draw_all(display, iterations);
+        return true;
+    }
+
+private:
+    enum Color {
+        WINDOW_BG, BUTTON_FACE, BUTTON_HOVER, BUTTON_PRESSED, BEVEL_LIGHT, BEVEL_DARK,
+        BORDER, ROW_EVEN, ROW_ODD, ROW_SELECTED, SEPARATOR, TROUGH, THUMB, TEXT_BG,
+        CURSOR, STATUS_BG
+    };
+    struct Rgb { uint8_t r, g, b; };
+    static constexpr Rgb PALETTE[] = {
+        {236, 236, 236}, {222, 222, 222}, {200, 220, 245}, {160, 180, 210},
+        {255, 255, 255}, {120, 120, 120}, {80, 80, 80}, {255, 255, 255},
+        {242, 242, 247}, {50, 100, 200}, {228, 228, 228}, {210, 210, 210},
+        {150, 150, 150}, {30, 30, 30}, {200, 200, 200}, {245, 245, 245}
+    };
+
+    static constexpr int ROW_HEIGHT = 20;
+    static constexpr int LINE_HEIGHT = 14;
+    static constexpr int STATUS_HEIGHT = 22;
+    static constexpr int SCROLLBAR_WIDTH = 12;
+
+    ToolkitParams params_;
+    XftFont* font_ = nullptr;
+    std::vector<unsigned long> pixels_;
+    GC scroll_gc_ = nullptr;
+    std::vector<int> buttons_;   // 0 normal, 1 hover, 2 pressed
+
+    XRectangle grid_ = {};
+    XRectangle list_ = {};       // Rows only; the scrollbar sits to its right
+    XRectangle text_ = {};
+    XRectangle status_ = {};
+
+    void layout(Display& display) {
+        int width = static_cast<int>(display.window_width());
+        int height = static_cast<int>(display.window_height()) - STATUS_HEIGHT;
+        int panels = (params_.grid_rows > 0) + (params_.list_scroll_px > 0) + params_.text_view;
+        int panel_width = width / std::max(panels, 1);
+
+        int x = 0;
+        auto next = [&](int w) {
+            XRectangle r = {static_cast<short>(x), 0, static_cast<unsigned short>(w),
+                            static_cast<unsigned short>(height)};
+            x += panel_width;
+            return r;
+        };
+        if (params_.grid_rows > 0) grid_ = next(panel_width);
+        if (params_.list_scroll_px > 0) list_ = next(panel_width - SCROLLBAR_WIDTH);
+        if (params_.text_view) text_ = next(panel_width);
+        status_ = {0, static_cast<short>(height), static_cast<unsigned short>(width),
+                   STATUS_HEIGHT};
+    }
+
+    int changed_button(int iteration, int k) const {
+        int count = static_cast<int>(buttons_.size());
+        return static_cast<int>((static_cast<long>(iteration) * 7919 + k * 104729) % count);
+    }
+
+    // Every widget paint is clipped to the widget, as toolkits clip to damage
+    void clip(Display& display, const XRectangle& r) {
+        XRectangle rect = r;
+        display.set_clip_rectangles(0, 0, &rect, 1, Unsorted);
+        display.set_text_clip(&rect, 1);
+    }
+
+    void unclip(Display& display) {
+        display.set_clip_mask(None);
+        display.set_text_clip(nullptr, 0);
+    }
+
+    void fill(Display& display, Color color, int x, int y, int w, int h) {
+        display.set_foreground(pixels_[color]);
+        display.draw_rectangle(x, y, w, h, true);
+    }
+
+    void text(Display& display, int x, int y, const std::string& s, bool light) {
+        uint8_t v = light ? 255 : 20;
+        display.draw_text(font_, x, y, s, v, v, v);
+    }
+
+    static XRectangle intersect(const XRectangle& a, const XRectangle& b) {
+        int x0 = std::max<int>(a.x, b.x);
+        int y0 = std::max<int>(a.y, b.y);
+        int x1 = std::min<int>(a.x + a.width, b.x + b.width);
+        int y1 = std::min<int>(a.y + a.height, b.y + b.height);
+        return {static_cast<short>(x0), static_cast<short>(y0),
+                static_cast<unsigned short>(std::max(0, x1 - x0)),
+                static_cast<unsigned short>(std::max(0, y1 - y0))};
+    }
+
+    void draw_all(Display& display, int frame) {
+        unclip(display);
+        fill(display, WINDOW_BG, 0, 0, display.window_width(), display.window_height());
+
+        for (size_t i = 0; i < buttons_.size(); i++) {
+            draw_button(display, static_cast<int>(i));
+        }
+        if (params_.list_scroll_px > 0) {
+            draw_list_rows(display, frame, list_);
+            draw_scrollbar(display, frame);
+        }
+        if (params_.text_view) {
+            int visible = text_.height / LINE_HEIGHT;
+            for (int row = 0; row < visible; row++) {
+                draw_text_line(display, frame - (visible - 1) + row, row, row == visible - 1);
+            }
+        }
+        draw_status(display, frame);
+    }
+
+    // --- Button grid ---
+
+    void draw_button(Display& display, int index) {
+        int cell_w = grid_.width / params_.grid_cols;
+        int cell_h = grid_.height / params_.grid_rows;
+        int x = grid_.x + (index % params_.grid_cols) * cell_w + 3;
+        int y = grid_.y + (index / params_.grid_cols) * cell_h + 3;
+        int w = cell_w - 6;
+        int h = cell_h - 6;
+        int state = buttons_[index];
+
+        clip(display, {static_cast<short>(x), static_cast<short>(y),
+                       static_cast<unsigned short>(w), static_cast<unsigned short>(h)});
+        fill(display, state == 0 ? BUTTON_FACE : state == 1 ? BUTTON_HOVER : BUTTON_PRESSED,
+             x, y, w, h);
+
+        // Bevel, inverted while pressed
+        display.set_foreground(pixels_[state == 2 ? BEVEL_DARK : BEVEL_LIGHT]);
+        display.draw_line(x + 1, y + 1, x + w - 2, y + 1);
+        display.draw_line(x + 1, y + 1, x + 1, y + h - 2);
+        display.set_foreground(pixels_[state == 2 ? BEVEL_LIGHT : BEVEL_DARK]);
+        display.draw_line(x + 1, y + h - 2, x + w - 2, y + h - 2);
+        display.draw_line(x + w - 2, y + 1, x + w - 2, y + h - 2);
+        display.set_foreground(pixels_[BORDER]);
+        display.draw_rectangle(x, y, w, h, false);
+
+        text(display, x + 6 + (state == 2), y + h / 2 + 4 + (state == 2),
+             "Button " + std::to_string(index + 1), false);
+        unclip(display);
+    }
+
+    // --- List view ---
+
+    int list_offset(int frame) const {
+        return frame * params_.list_scroll_px;
+    }
+
+    int selected_item(int frame) const {
+        return list_offset(frame) / ROW_HEIGHT + 3 + frame % 5;
+    }
+
+    // Paint the rows intersecting `area` for the given frame's scroll offset
+    void draw_list_rows(Display& display, int frame, const XRectangle& area) {
+        int offset = list_offset(frame);
+        int first = (offset + (area.y - list_.y)) / ROW_HEIGHT;
+        int last = (offset + (area.y - list_.y) + area.height - 1) / ROW_HEIGHT;
+        for (int item = first; item <= last; item++) {
+            draw_list_row(display, frame, item, area);
+        }
+    }
+
+    void draw_list_row(Display& display, int frame, int item, const XRectangle& area) {
+        draw_list_row(display, frame, item, area, item == selected_item(frame));
+    }
+
+    void draw_list_row(Display& display, int frame, int item, const XRectangle& area,
+                       bool selected) {
+        int y = list_.y + item * ROW_HEIGHT - list_offset(frame);
+        XRectangle row = {list_.x, static_cast<short>(y), list_.width, ROW_HEIGHT};
+        XRectangle visible = intersect(intersect(row, list_), area);
+        if (visible.width == 0 || visible.height == 0) {
+            return;
+        }
+
+        clip(display, visible);
+        fill(display, selected ? ROW_SELECTED : item % 2 ? ROW_ODD : ROW_EVEN,
+             row.x, row.y, row.width, row.height);
+        display.set_foreground(pixels_[SEPARATOR]);
+        display.draw_line(row.x, y + ROW_HEIGHT - 1, row.x + row.width - 1, y + ROW_HEIGHT - 1);
+        text(display, row.x + 8, y + 14, "Item " + std::to_string(item) + "  \xe2\x80\x94  " +
+             std::to_string(item * 37 % 1000) + " KB", selected);
+        unclip(display);
+    }
+
+    void scroll_list(Display& display, int frame) {
+        int dy = params_.list_scroll_px;
+        int prev = frame - 1;
+
+        // The old selection would be carried along by the copy; repaint it first
+        draw_list_row(display, prev, selected_item(prev), list_, false);
+
+        XCopyArea(display.x_display(), display.x_window(), display.x_window(), scroll_gc_,
+                  list_.x, list_.y + dy, list_.width, list_.height - dy, list_.x, list_.y);
+
+        XRectangle strip = {list_.x, static_cast<short>(list_.y + list_.height - dy),
+                            list_.width, static_cast<unsigned short>(dy)};
+        draw_list_rows(display, frame, strip);
+        draw_list_row(display, frame, selected_item(frame), list_);
+        draw_scrollbar(display, frame);
+    }
+
+    void draw_scrollbar(Display& display, int frame) {
+        int x = list_.x + list_.width;
+        int track = list_.height - 40;
+        int thumb_y = list_.y + (list_offset(frame) / 2) % track;
+
+        clip(display, {static_cast<short>(x), list_.y, SCROLLBAR_WIDTH, list_.height});
+        fill(display, TROUGH, x, list_.y, SCROLLBAR_WIDTH, list_.height);
+        fill(display, THUMB, x + 2, thumb_y, SCROLLBAR_WIDTH - 4, 40);
+        display.set_foreground(pixels_[BORDER]);
+        display.draw_rectangle(x + 2, thumb_y, SCROLLBAR_WIDTH - 4, 40, false);
+        unclip(display);
+    }
+
+    // --- Text view ---
+
+    static std::string text_line(int line) {
+        static const char* WORDS[] = {
+            "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+            "elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore"
+        };
+        if (line < 0) {
+            return "";
+        }
+        std::string s = std::to_string(line) + ":";
+        for (int w = 0; w < 4 + line % 5; w++) {
+            s += " ";
+            s += WORDS[(line * 7 + w * 3) % 15];
+        }
+        return s;
+    }
+
+    // Paint `line` into visible row `row`, with the cursor after it when asked
+    void draw_text_line(Display& display, int line, int row, bool cursor) {
+        int y = text_.y + row * LINE_HEIGHT;
+        clip(display, {text_.x, static_cast<short>(y), text_.width, LINE_HEIGHT});
+        fill(display, TEXT_BG, text_.x, y, text_.width, LINE_HEIGHT);
+        std::string s = text_line(line);
+        text(display, text_.x + 4, y + 11, s, true);
+        if (cursor) {
+            int x = text_.x + 4;
+            if (font_ && !s.empty()) {
+                x += display.text_width(font_, s) + 2;
+            }
+            fill(display, CURSOR, x, y + 1, 7, LINE_HEIGHT - 2);
+        }
+        unclip(display);
+    }
+
+    void scroll_text(Display& display, int frame) {
+        int visible = text_.height / LINE_HEIGHT;
+
+        // Erase the cursor before the line moves up, then scroll by one line
+        draw_text_line(display, frame - 1, visible - 1, false);
+        XCopyArea(display.x_display(), display.x_window(), display.x_window(), scroll_gc_,
+                  text_.x, text_.y + LINE_HEIGHT, text_.width, (visible - 1) * LINE_HEIGHT,
+                  text_.x, text_.y);
+        draw_text_line(display, frame, visible - 1, true);
+    }
+
+    // --- Status bar ---
+
+    void draw_status(Display& display, int frame) {
+        clip(display, status_);
+        fill(display, STATUS_BG, status_.x, status_.y, status_.width, status_.height);
+        display.set_foreground(pixels_[BEVEL_DARK]);
+        display.draw_line(status_.x, status_.y, status_.x + status_.width - 1, status_.y);
+        text(display, status_.x + 8, status_.y + 15,
+             "Frame " + std::to_string(frame) + " | " +
+             std::to_string(buttons_.size()) + " buttons", false);
+        unclip(display);
+    }
+};
+
+class BenchToolkitButtons : public ToolkitWorkload {
+public:
+    BenchToolkitButtons() : ToolkitWorkload({12, 6, 8, 0, false}) {}
+    std::string name() const override { return "toolkit_buttons"; }
+    std::string description() const override {
+        return "Button grid with 8 buttons changing state per frame";
+    }
+};
+REGISTER_BENCH(BenchToolkitButtons)
+
+class BenchToolkitList : public ToolkitWorkload {
+public:
+    BenchToolkitList() : ToolkitWorkload({0, 0, 0, 4, false}) {}
+    std::string name() const override { return "toolkit_list"; }
+    std::string description() const override {
+        return "List view smooth-scrolling 4 px per frame with a moving selection";
+    }
+};
+REGISTER_BENCH(BenchToolkitList)
+
+class BenchToolkitText : public ToolkitWorkload {
+public:
+    BenchToolkitText() : ToolkitWorkload({0, 0, 0, 0, true}) {}
+    std::string name() const override { return "toolkit_text"; }
+    std::string description() const override {
+        return "Terminal-like text view scrolling one line per frame";
+    }
+};
+REGISTER_BENCH(BenchToolkitText)
+
+class BenchToolkitMixed : public ToolkitWorkload {
+public:
+    BenchToolkitMixed() : ToolkitWorkload({10, 3, 4, 3, true}) {}
+    std::string name() const override { return "toolkit_mixed"; }
+    std::string description() const override {
+        return "Button grid, list view and text view updating in the same frame";
+    }
+};
+REGISTER_BENCH(BenchToolkitMixed)
+
+} // namespace x11bench
@@ -0,0 +1,97 @@
+#include "complexity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace x11bench {
+
+namespace {
+struct Model {
+    const char* name;
+    double (*f)(double n);
+    bool superlinear;
+};
+
+const Model MODELS[] = {
+    {"O(n)", [](double n) { return n; }, false},
+    {"O(n log n)", [](double n) { return n * std::log2(std::max(n, 1.0)); }, true},
+    {"O(n^2)", [](double n) { return n * n; }, true},
+};
+
+// A higher order must cut the residual sum of squares at least this much
+const double IMPROVEMENT = 0.5;
+
+// ... and its growth term must be this share of the time at the largest size
+const double MIN_GROWTH_SHARE = 0.1;
+} // namespace
+
+ComplexityFit fit_complexity(const std::vector<double>& sizes, const std::vector<double>& times_ms) {
+    ComplexityFit fit;
+    size_t count = std::min(sizes.size(), times_ms.size());
+    if (std::set<double>(sizes.begin(), sizes.begin() + count).size() < 3) {
+        return fit;
+    }
+
+    double mean_t = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        mean_t += times_ms[i];
+    }
+    mean_t /= count;
+
+    double n_max = *std::max_element(sizes.begin(), sizes.begin() + count);
+    double t_max = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        if (sizes[i] == n_max) t_max = std::max(t_max, times_ms[i]);
+    }
+
+    // O(1): the mean
+    double best_rss = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        best_rss += (times_ms[i] - mean_t) * (times_ms[i] - mean_t);
+    }
+    fit.valid = true;
+    fit.model = "O(1)";
+    fit.intercept_ms = mean_t;
+
+    for (const Model& model : MODELS) {
+        double mean_f = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            mean_f += model.f(sizes[i]);
+        }
+        mean_f /= count;
+
+        double cov = 0.0, var = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            double df = model.f(sizes[i]) - mean_f;
+            cov += df * (times_ms[i] - mean_t);
+            var += df * df;
+        }
+        if (var <= 0.0 || cov <= 0.0) {
+            continue;  // Flat or shrinking: no growth to explain
+        }
+        double b = cov / var;
+        double a = mean_t - b * mean_f;
+
+        double rss = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            double r = times_ms[i] - (a + b * model.f(sizes[i]));
+            rss += r * r;
+        }
+        bool growth_matters = b * model.f(n_max) >= MIN_GROWTH_SHARE * t_max;
+        if (growth_matters && rss < IMPROVEMENT * best_rss) {
+            best_rss = rss;
+            fit.model = model.name;
+            fit.coefficient = b;
+            fit.intercept_ms = a;
+            fit.superlinear = model.superlinear;
+        }
+    }
+
+    if (mean_t > 0.0) {
+        fit.residual_percent = 100.0 * std::sqrt(best_rss / count) / mean_t;
+    }
+    return fit;
+}
+
+} // namespace x11bench
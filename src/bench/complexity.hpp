@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// Growth model of step time over input size n, fitted by least squares as
+// t = intercept + coefficient * f(n). The intercept absorbs the fixed cost
+// every step pays (the sync round trip, request headers).
+struct ComplexityFit {
+    bool valid = false;        // At least three distinct sizes
+    std::string model;         // "O(1)", "O(n)", "O(n log n)" or "O(n^2)"
+    double coefficient = 0.0;  // ms per unit of f(n)
+    double intercept_ms = 0.0;
+    double residual_percent = 0.0;  // RMS residual relative to the mean time
+    bool superlinear = false;  // Grows faster than O(n)
+};
+
+// Picks the lowest-order model that explains the timings: a higher order is
+// only chosen when it at least halves the residual of the one below and its
+// growth term is a real share of the largest size's time, so noise on flat
+// or linear data doesn't read as superlinear.
+ComplexityFit fit_complexity(const std::vector<double>& sizes, const std::vector<double>& times_ms);
+
+} // namespace x11bench
@@ -0,0 +1,514 @@
+#include "soak.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <unistd.h>
+
+// Xlibint is needed for raw X-Resource requests (libXRes is not a
+// dependency); it defines min/max macros that would break the headers above
+#include <X11/Xlibint.h>
+#include <X11/extensions/XResproto.h>
+#undef min
+#undef max
+
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_RESET   "\033[0m"
+
+namespace x11bench {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const char* SERVER_USAGE_MARK = "soak: server usage";
+
+// --- X-Resource ---
+
+bool xres_query_clients(::Display* dpy, int opcode, std::vector<xXResClient>& clients) {
+    LockDisplay(dpy);
+    xXResQueryClientsReq* req;
+    GetReq(XResQueryClients, req);
+    req->reqType = opcode;
+    req->XResReqType = X_XResQueryClients;
+
+    xXResQueryClientsReply rep;
+    bool ok = _XReply(dpy, reinterpret_cast<xReply*>(&rep), 0, xFalse);
+    if (ok) {
+        clients.resize(rep.num_clients);
+        if (rep.num_clients > 0) {
+            _XRead(dpy, reinterpret_cast<char*>(clients.data()),
+                   static_cast<long>(rep.num_clients) * sz_xXResClient);
+        }
+    }
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return ok;
+}
+
+bool xres_client_resources(::Display* dpy, int opcode, XID client, uint64_t& total) {
+    LockDisplay(dpy);
+    xXResQueryClientResourcesReq* req;
+    GetReq(XResQueryClientResources, req);
+    req->reqType = opcode;
+    req->XResReqType = X_XResQueryClientResources;
+    req->xid = client;
+
+    xXResQueryClientResourcesReply rep;
+    bool ok = _XReply(dpy, reinterpret_cast<xReply*>(&rep), 0, xFalse);
+    if (ok) {
+        std::vector<xXResType> types(rep.num_types);
+        if (rep.num_types > 0) {
+            _XRead(dpy, reinterpret_cast<char*>(types.data()),
+                   static_cast<long>(rep.num_types) * sz_xXResType);
+        }
+        total = 0;
+        for (const auto& type : types) {
+            total += type.count;
+        }
+    }
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return ok;
+}
+
+bool xres_pixmap_bytes(::Display* dpy, int opcode, XID client, uint64_t& bytes) {
+    LockDisplay(dpy);
+    xXResQueryClientPixmapBytesReq* req;
+    GetReq(XResQueryClientPixmapBytes, req);
+    req->reqType = opcode;
+    req->XResReqType = X_XResQueryClientPixmapBytes;
+    req->xid = client;
+
+    xXResQueryClientPixmapBytesReply rep;
+    bool ok = _XReply(dpy, reinterpret_cast<xReply*>(&rep), 0, xFalse);
+    if (ok) {
+        bytes = (static_cast<uint64_t>(rep.bytes_overflow) << 32) | rep.bytes;
+    }
+    UnlockDisplay(dpy);
+    SyncHandle();
+    return ok;
+}
+
+// Totals over every client. Clients that disconnect between the requests
+// raise BadValue, which the caller discards by mark.
+ServerUsage query_server_usage(Display& display, int opcode) {
+    ServerUsage usage;
+    ::Display* dpy = display.x_display();
+    std::vector<xXResClient> clients;
+    if (opcode == 0 || !xres_query_clients(dpy, opcode, clients)) {
+        return usage;
+    }
+    usage.available = true;
+    usage.clients = clients.size();
+
+    XID own_base = static_cast<XID>(dpy->resource_base);
+    for (const auto& client : clients) {
+        uint64_t resources = 0;
+        uint64_t bytes = 0;
+        if (xres_client_resources(dpy, opcode, client.resource_base, resources)) {
+            usage.resources += resources;
+            if (client.resource_base == own_base) {
+                usage.own_resources = resources;
+            }
+        }
+        if (xres_pixmap_bytes(dpy, opcode, client.resource_base, bytes)) {
+            usage.pixmap_bytes += bytes;
+        }
+    }
+    return usage;
+}
+
+uint64_t resident_kb() {
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size_pages = 0, resident_pages = 0;
+    if (!(statm >> size_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+// --- Workload ---
+
+// Operations cycled through; each is followed by an XSync and timed
+enum SoakOp { OP_PRIMITIVES, OP_RENDER, OP_TEXT, OP_CHURN, OP_IMAGE, OP_COUNT };
+
+class SoakWorkload {
+public:
+    static constexpr uint32_t SIZE = 512;
+    static constexpr int IMAGE_SIZE = 128;
+
+    bool setup(Display& display) {
+        ::Display* dpy = display.x_display();
+        if (!display.create_window(SIZE, SIZE, "x11bench: soak")) {
+            return false;
+        }
+        display.show_window();
+        display.wait_for_expose(2000);
+
+        for (int i = 0; i < 8; i++) {
+            pixels_.push_back(display.alloc_color(40 + i * 25, 200 - i * 20, (i * 67) % 256));
+        }
+
+        font_ = display.load_font("sans", 12);
+        if (!font_) font_ = display.load_font("fixed", 12);
+
+        // No GraphicsExpose/NoExpose event per copy
+        copy_gc_ = display.create_gc_for_window(display.x_window());
+        XSetGraphicsExposures(dpy, copy_gc_, False);
+
+        // Translucent ARGB source for compositing
+        XRenderPictFormat* argb = XRenderFindStandardFormat(dpy, PictStandardARGB32);
+        if (display.picture() && argb) {
+            source_pixmap_ = XCreatePixmap(dpy, display.x_window(), 64, 64, 32);
+            source_ = XRenderCreatePicture(dpy, source_pixmap_, argb, 0, nullptr);
+            XRenderColor color = {0x8000, 0x2000, 0x6000, 0x8000};
+            XRenderFillRectangle(dpy, PictOpSrc, source_, &color, 0, 0, 64, 64);
+        }
+
+        upload_ = XCreateImage(dpy, display.visual(), display.depth(), ZPixmap, 0, nullptr,
+                               IMAGE_SIZE, IMAGE_SIZE, 32, 0);
+        if (upload_) {
+            upload_->data = static_cast<char*>(
+                std::malloc(static_cast<size_t>(upload_->bytes_per_line) * IMAGE_SIZE));
+            for (int y = 0; y < IMAGE_SIZE; y++) {
+                for (int x = 0; x < IMAGE_SIZE; x++) {
+                    XPutPixel(upload_, x, y, pixels_[(x / 16 + y / 16) % pixels_.size()]);
+                }
+            }
+        }
+        return true;
+    }
+
+    void op(Display& display, uint64_t index) {
+        ::Display* dpy = display.x_display();
+        ::Window win = display.x_window();
+        GC gc = display.gc();
+        int x = static_cast<int>((index * 37) % (SIZE - IMAGE_SIZE));
+        int y = static_cast<int>((index * 53) % (SIZE - IMAGE_SIZE));
+        unsigned long pixel = pixels_[index % pixels_.size()];
+
+        switch (index % OP_COUNT) {
+            case OP_PRIMITIVES: {
+                XSetForeground(dpy, gc, pixel);
+                XRectangle rects[32];
+                XSegment segments[32];
+                for (int i = 0; i < 32; i++) {
+                    rects[i] = {static_cast<short>(x + (i % 8) * 12),
+                                static_cast<short>(y + (i / 8) * 12), 10, 10};
+                    segments[i] = {static_cast<short>(x), static_cast<short>(y + i * 4),
+                                   static_cast<short>(x + IMAGE_SIZE),
+                                   static_cast<short>(y + IMAGE_SIZE - i * 4)};
+                }
+                XFillRectangles(dpy, win, gc, rects, 32);
+                XDrawSegments(dpy, win, gc, segments, 32);
+                XDrawArc(dpy, win, gc, x, y, IMAGE_SIZE, IMAGE_SIZE / 2, 0, 360 * 64);
+                break;
+            }
+            case OP_RENDER:
+                if (source_) {
+                    XRenderComposite(dpy, PictOpOver, source_, None, display.picture(),
+                                     0, 0, 0, 0, x, y, 64, 64);
+                    display.render_fill_rectangle(x + 64, y, 32, 32, 20, 120, 220, 160);
+                } else {
+                    XSetForeground(dpy, gc, pixel);
+                    XFillRectangle(dpy, win, gc, x, y, 64, 64);
+                }
+                break;
+            case OP_TEXT:
+                if (font_) {
+                    display.draw_text(font_, x, y + 20, "soak " + std::to_string(index),
+                                      30, 30, 30);
+                }
+                break;
+            case OP_CHURN: {
+                // A child window and a pixmap live for one operation each
+                ::Window child = XCreateSimpleWindow(dpy, win, x, y, 64, 64, 0, pixel, pixel);
+                XMapWindow(dpy, child);
+                Pixmap pixmap = XCreatePixmap(dpy, win, 64, 64, display.depth());
+                XSetForeground(dpy, gc, pixel);
+                XFillRectangle(dpy, pixmap, gc, 0, 0, 64, 64);
+                XCopyArea(dpy, pixmap, win, copy_gc_, 0, 0, 64, 64, x + 64, y);
+                XFreePixmap(dpy, pixmap);
+                XDestroyWindow(dpy, child);
+                break;
+            }
+            case OP_IMAGE:
+                if (upload_) {
+                    XPutImage(dpy, win, gc, upload_, 0, 0, x, y, IMAGE_SIZE, IMAGE_SIZE);
+                }
+                if (XImage* readback = XGetImage(dpy, win, x, y, 64, 64, AllPlanes, ZPixmap)) {
+                    XDestroyImage(readback);
+                }
+                break;
+        }
+    }
+
+    void teardown(Display& display) {
+        ::Display* dpy = display.x_display();
+        if (upload_) {
+            XDestroyImage(upload_);
+            upload_ = nullptr;
+        }
+        if (source_) {
+            XRenderFreePicture(dpy, source_);
+            source_ = 0;
+        }
+        if (source_pixmap_) {
+            XFreePixmap(dpy, source_pixmap_);
+            source_pixmap_ = 0;
+        }
+        if (font_) {
+            display.free_font(font_);
+            font_ = nullptr;
+        }
+        if (copy_gc_) {
+            display.free_gc(copy_gc_);
+            copy_gc_ = nullptr;
+        }
+        display.destroy_window();
+    }
+
+private:
+    std::vector<unsigned long> pixels_;
+    XftFont* font_ = nullptr;
+    GC copy_gc_ = nullptr;
+    Pixmap source_pixmap_ = 0;
+    Picture source_ = 0;
+    XImage* upload_ = nullptr;
+};
+
+// --- Trends ---
+
+// Least-squares line through (x, y); returns the fitted values at the ends
+void fit_line(const std::vector<double>& x, const std::vector<double>& y,
+              double& first, double& last) {
+    double mean_x = 0, mean_y = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        mean_x += x[i];
+        mean_y += y[i];
+    }
+    mean_x /= x.size();
+    mean_y /= y.size();
+    double cov = 0, var = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+        cov += (x[i] - mean_x) * (y[i] - mean_y);
+        var += (x[i] - mean_x) * (x[i] - mean_x);
+    }
+    double slope = var > 0 ? cov / var : 0.0;
+    first = mean_y + slope * (x.front() - mean_x);
+    last = mean_y + slope * (x.back() - mean_x);
+}
+
+// Fewer samples than this give no trend worth flagging
+const size_t MIN_TREND_SAMPLES = 4;
+} // namespace
+
+SoakRunner::SoakRunner(const SoakOptions& options)
+    : options_(options) {
+}
+
+bool SoakRunner::run() {
+    samples_.clear();
+    problems_.clear();
+
+    Display display;
+    if (!display.connect(options_.display_name)) {
+        std::cerr << "Failed to connect to X display" << std::endl;
+        return false;
+    }
+    ::Display* dpy = display.x_display();
+
+    int xres_opcode = 0, first_event = 0, first_error = 0;
+    if (!XQueryExtension(dpy, XRES_NAME, &xres_opcode, &first_event, &first_error)) {
+        xres_opcode = 0;
+        std::cout << "X-Resource not available; server usage will not be sampled\n";
+    }
+
+    SoakWorkload workload;
+    display.mark("soak: setup");
+    if (!workload.setup(display)) {
+        std::cerr << "Failed to create window" << std::endl;
+        return false;
+    }
+    display.sync();
+
+    std::cout << "Soaking for " << options_.duration_s << " s, sampling every "
+              << options_.interval_s << " s\n";
+
+    auto start = Clock::now();
+    auto seconds_since = [](Clock::time_point t) {
+        return std::chrono::duration<double>(Clock::now() - t).count();
+    };
+    auto interval_start = start;
+    std::vector<double> op_ms;
+    uint64_t op = 0;
+    bool done = false;
+    while (!done) {
+        display.mark("soak: workload");
+        auto op_start = Clock::now();
+        workload.op(display, op++);
+        display.sync();
+        op_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - op_start).count());
+        // Expose events from the churned child windows would otherwise
+        // pile up in Xlib's queue and show as client RSS growth
+        display.process_pending_events();
+
+        if (display.has_io_error()) {
+            problems_.push_back("connection to the X server lost after " +
+                                std::to_string(static_cast<long>(seconds_since(start))) + " s");
+            break;
+        }
+
+        done = seconds_since(start) >= options_.duration_s;
+        if (!done && seconds_since(interval_start) < options_.interval_s) {
+            continue;
+        }
+
+        SoakSample sample;
+        sample.elapsed_s = seconds_since(start);
+        double interval_s = seconds_since(interval_start);
+        sample.ops_per_second = interval_s > 0 ? op_ms.size() / interval_s : 0.0;
+        sample.latency = LatencyStats::from_samples(std::move(op_ms));
+        op_ms.clear();
+        sample.rss_kb = resident_kb();
+
+        display.mark(SERVER_USAGE_MARK);
+        sample.server = query_server_usage(display, xres_opcode);
+        for (const auto& error : display.take_errors()) {
+            if (error.context != SERVER_USAGE_MARK) {
+                sample.x_errors++;
+                if (sample.x_errors == 1) {
+                    problems_.push_back("X error at " +
+                                        std::to_string(static_cast<long>(sample.elapsed_s)) +
+                                        " s: " + display.describe_error(error));
+                }
+            }
+        }
+
+        report(sample);
+        samples_.push_back(sample);
+        interval_start = Clock::now();
+    }
+
+    workload.teardown(display);
+    detect_degradation();
+
+    if (!options_.csv_path.empty() && !write_csv()) {
+        std::cerr << "Cannot write " << options_.csv_path << std::endl;
+    }
+
+    if (problems_.empty()) {
+        std::cout << COLOR_GREEN << "Stable" << COLOR_RESET << ": no degradation over "
+                  << samples_.size() << " samples\n";
+    } else {
+        std::cout << COLOR_RED << "Degradation" << COLOR_RESET << ":\n";
+        for (const auto& problem : problems_) {
+            std::cout << "  " << problem << "\n";
+        }
+    }
+    return true;
+}
+
+void SoakRunner::report(const SoakSample& sample) const {
+    std::cout << std::fixed << std::setprecision(0) << "  t=" << std::setw(6) << sample.elapsed_s
+              << " s  " << std::setw(7) << sample.ops_per_second << " ops/s"
+              << std::setprecision(3)
+              << "  p50 " << sample.latency.p50_ms
+              << "  p95 " << sample.latency.p95_ms
+              << "  p99 " << sample.latency.p99_ms << " ms"
+              << std::setprecision(1) << "  rss " << sample.rss_kb / 1024.0 << " MB";
+    if (sample.server.available) {
+        std::cout << "  server " << sample.server.resources << " resources ("
+                  << sample.server.own_resources << " ours), "
+                  << sample.server.pixmap_bytes / (1024.0 * 1024.0) << " MB pixmaps";
+    }
+    if (sample.x_errors > 0) {
+        std::cout << "  " << COLOR_RED << sample.x_errors << " X errors" << COLOR_RESET;
+    }
+    std::cout << "\n";
+}
+
+void SoakRunner::detect_degradation() {
+    // The first sample includes warm-up (font and glyph caches, first
+    // allocations); leave it out of the trends when there are enough others
+    size_t skip = samples_.size() > MIN_TREND_SAMPLES ? 1 : 0;
+    if (samples_.size() - skip < MIN_TREND_SAMPLES) {
+        if (options_.verbose) {
+            std::cout << "Too few samples for trend detection\n";
+        }
+        return;
+    }
+
+    std::vector<double> t;
+    for (size_t i = skip; i < samples_.size(); i++) {
+        t.push_back(samples_[i].elapsed_s);
+    }
+    auto series = [&](auto value) {
+        std::vector<double> v;
+        for (size_t i = skip; i < samples_.size(); i++) {
+            v.push_back(static_cast<double>(value(samples_[i])));
+        }
+        return v;
+    };
+
+    // Flags a fitted change beyond both a relative and an absolute threshold;
+    // `sign` is +1 for metrics that must not grow, -1 for ones that must not shrink
+    auto check = [&](const char* metric, const std::vector<double>& values, int sign,
+                     double max_percent, double min_absolute, const char* unit) {
+        double first = 0, last = 0;
+        fit_line(t, values, first, last);
+        double change = (last - first) * sign;
+        double percent = first != 0 ? 100.0 * change / std::abs(first) : 0.0;
+        if (change > min_absolute && percent > max_percent) {
+            char text[160];
+            std::snprintf(text, sizeof(text), "%s %s from %.2f to %.2f %s (%.0f%%)", metric,
+                          sign > 0 ? "grew" : "fell", first, last, unit, percent);
+            problems_.push_back(text);
+        }
+    };
+
+    check("throughput", series([](const SoakSample& s) { return s.ops_per_second; }),
+          -1, 10.0, 0.0, "ops/s");
+    check("p50 latency", series([](const SoakSample& s) { return s.latency.p50_ms; }),
+          +1, 20.0, 0.01, "ms");
+    check("p99 latency", series([](const SoakSample& s) { return s.latency.p99_ms; }),
+          +1, 50.0, 0.05, "ms");
+    check("client RSS", series([](const SoakSample& s) { return s.rss_kb / 1024.0; }),
+          +1, 10.0, 8.0, "MB");
+    if (samples_.back().server.available) {
+        check("own server resources",
+              series([](const SoakSample& s) { return s.server.own_resources; }),
+              +1, 5.0, 50.0, "");
+        check("server resources", series([](const SoakSample& s) { return s.server.resources; }),
+              +1, 10.0, 200.0, "");
+        check("server pixmap memory",
+              series([](const SoakSample& s) { return s.server.pixmap_bytes / (1024.0 * 1024.0); }),
+              +1, 10.0, 8.0, "MB");
+    }
+}
+
+bool SoakRunner::write_csv() const {
+    std::ofstream out(options_.csv_path);
+    if (!out) {
+        return false;
+    }
+    out << "elapsed_s,ops_per_s,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,rss_kb,"
+           "server_clients,server_resources,server_pixmap_bytes,own_resources,x_errors\n";
+    for (const auto& s : samples_) {
+        out << s.elapsed_s << "," << s.ops_per_second << "," << s.latency.mean_ms << ","
+            << s.latency.p50_ms << "," << s.latency.p95_ms << "," << s.latency.p99_ms << ","
+            << s.latency.max_ms << "," << s.rss_kb << "," << s.server.clients << ","
+            << s.server.resources << "," << s.server.pixmap_bytes << ","
+            << s.server.own_resources << "," << s.x_errors << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace x11bench
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bench_runner.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+struct SoakOptions {
+    std::string display_name;
+    double duration_s = 3600.0;
+    double interval_s = 10.0;   // One sample per interval
+    std::string csv_path;       // Samples as CSV
+    bool verbose = false;
+};
+
+// Server-side resource usage from the X-Resource extension
+struct ServerUsage {
+    bool available = false;
+    uint64_t clients = 0;
+    uint64_t resources = 0;      // All clients
+    uint64_t pixmap_bytes = 0;   // All clients
+    uint64_t own_resources = 0;  // This connection
+};
+
+struct SoakSample {
+    double elapsed_s = 0.0;
+    double ops_per_second = 0.0;
+    LatencyStats latency;        // Per-operation wall times of the interval
+    uint64_t rss_kb = 0;         // Client resident set
+    ServerUsage server;
+    size_t x_errors = 0;
+};
+
+// Drives a mixed workload (core primitives, XRender, Xft text, window and
+// pixmap churn, image upload and readback) back to back for a long time,
+// one synced operation after another, and samples throughput, latency, the
+// client's RSS and the server's resource counts every interval. Trends over
+// the whole run are fitted at the end: throughput decay, latency creep and
+// memory or resource growth are reported as degradations.
+class SoakRunner {
+public:
+    explicit SoakRunner(const SoakOptions& options);
+
+    // False if the display could not be opened
+    bool run();
+
+    const std::vector<SoakSample>& samples() const { return samples_; }
+
+    // One line per detected degradation or X error; empty when stable
+    const std::vector<std::string>& problems() const { return problems_; }
+
+private:
+    SoakOptions options_;
+    std::vector<SoakSample> samples_;
+    std::vector<std::string> problems_;
+
+    void report(const SoakSample& sample) const;
+    void detect_degradation();
+    bool write_csv() const;
+};
+
+} // namespace x11bench
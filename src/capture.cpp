@@ -1,7 +1,12 @@
 #include "capture.hpp"
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 
 namespace x11bench {
 
@@ -43,33 +48,190 @@ Image Capture::capture_region(Display& display, int x, int y,
 }
 
 namespace {
-uint8_t extract_channel(unsigned long pixel, unsigned long mask) {
-    if (mask == 0) {
-        return 0;
+bool host_is_lsb_first();
+
+// Read a drawable through a temporary shared-memory segment. Returns an
+// empty image if any step fails so the caller can fall back to XGetImage.
+Image shm_read_argb32(Display& display, Drawable drawable, Visual* visual,
+                      uint32_t width, uint32_t height) {
+    ::Display* dpy = display.x_display();
+    XShmSegmentInfo shm = {};
+    XImage* ximg = XShmCreateImage(dpy, visual, 32, ZPixmap, nullptr, &shm, width, height);
+    if (!ximg) {
+        return Image();
+    }
+
+    shm.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(ximg->bytes_per_line) * height,
+                       IPC_CREAT | 0600);
+    if (shm.shmid < 0) {
+        XDestroyImage(ximg);
+        return Image();
+    }
+    shm.shmaddr = ximg->data = static_cast<char*>(shmat(shm.shmid, nullptr, 0));
+    shm.readOnly = False;
+
+    // XShmAttach returns True whether or not the server could attach; a
+    // refusal only shows as an error, which must not fail the test
+    bool attached = false;
+    if (shm.shmaddr != reinterpret_cast<char*>(-1)) {
+        display.trap_errors();
+        XShmAttach(dpy, &shm);
+        attached = display.untrap_errors();
+    }
+
+    Image result;
+    if (attached) {
+        // Segment disappears once both sides detach
+        shmctl(shm.shmid, IPC_RMID, nullptr);
+
+        if (XShmGetImage(dpy, drawable, ximg, 0, 0, AllPlanes)) {
+            bool swap = (ximg->byte_order == LSBFirst) != host_is_lsb_first();
+            result = Capture::argb32_to_image(reinterpret_cast<const uint8_t*>(ximg->data),
+                                              width, height, ximg->bytes_per_line, swap);
+        }
+        XShmDetach(dpy, &shm);
+        XSync(dpy, False);
+    } else {
+        shmctl(shm.shmid, IPC_RMID, nullptr);
+    }
+
+    if (shm.shmaddr != reinterpret_cast<char*>(-1)) {
+        shmdt(shm.shmaddr);
+    }
+    ximg->data = nullptr;  // Not malloc'd; keep XDestroyImage away from it
+    XDestroyImage(ximg);
+    return result;
+}
+} // namespace
+
+Image Capture::capture_window_argb(Display& display) {
+    if (!display.is_connected() || !display.has_window()) {
+        throw std::runtime_error("Display not connected or no window");
+    }
+
+    ::Display* dpy = display.x_display();
+    XRenderPictFormat* argb = display.has_xrender()
+        ? XRenderFindStandardFormat(dpy, PictStandardARGB32) : nullptr;
+    XVisualInfo vinfo;
+    bool have_depth32 = XMatchVisualInfo(dpy, display.screen(), 32, TrueColor, &vinfo);
+    if (!argb || !display.picture() || !have_depth32) {
+        return capture_window(display);
+    }
+
+    uint32_t width = display.window_width();
+    uint32_t height = display.window_height();
+
+    Pixmap pixmap = XCreatePixmap(dpy, display.x_window(), width, height, 32);
+    Picture target = XRenderCreatePicture(dpy, pixmap, argb, 0, nullptr);
+
+    // Src copies the window's pixels, converting to a8r8g8b8; windows without
+    // an alpha channel come out with alpha 0xff
+    XRenderComposite(dpy, PictOpSrc, display.picture(), None, target,
+                     0, 0, 0, 0, 0, 0, width, height);
+
+    Image result;
+    if (display.has_shm()) {
+        result = shm_read_argb32(display, pixmap, vinfo.visual, width, height);
+    }
+    if (result.empty()) {
+        display.sync(false);
+        XImage* ximg = XGetImage(dpy, pixmap, 0, 0, width, height, AllPlanes, ZPixmap);
+        if (ximg) {
+            bool swap = (ximg->byte_order == LSBFirst) != host_is_lsb_first();
+            result = argb32_to_image(reinterpret_cast<const uint8_t*>(ximg->data),
+                                     width, height, ximg->bytes_per_line, swap);
+            XDestroyImage(ximg);
+        }
+    }
+
+    XRenderFreePicture(dpy, target);
+    XFreePixmap(dpy, pixmap);
+
+    if (result.empty()) {
+        throw std::runtime_error("ARGB capture failed");
+    }
+    return result;
+}
+
+Image Capture::argb32_to_image(const uint8_t* data, uint32_t width, uint32_t height,
+                               size_t stride, bool swap_bytes) {
+    Image img(width, height);
+    uint8_t* out = img.data();
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = data + y * stride;
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t pixel;
+            std::memcpy(&pixel, row + x * 4, sizeof(pixel));
+            if (swap_bytes) {
+                pixel = __builtin_bswap32(pixel);
+            }
+            uint32_t alpha = pixel >> 24;
+            uint32_t rgb[3] = {(pixel >> 16) & 0xff, (pixel >> 8) & 0xff, pixel & 0xff};
+            for (int c = 0; c < 3; c++) {
+                // Back to straight alpha, as PNG stores it
+                if (alpha != 0xff) {
+                    rgb[c] = alpha ? std::min<uint32_t>(255, (rgb[c] * 255 + alpha / 2) / alpha)
+                                   : 0;
+                }
+                out[c] = static_cast<uint8_t>(rgb[c]);
+            }
+            out[3] = static_cast<uint8_t>(alpha);
+            out += 4;
+        }
     }
 
-    // Find shift and max value from mask
+    return img;
+}
+
+namespace {
+// Channel decoding precomputed once per image: mask position plus a lookup
+// table that scales the channel's value range to 0-255.
+struct ChannelLayout {
+    unsigned long mask = 0;
     int shift = 0;
-    while (((mask >> shift) & 1UL) == 0UL && shift < static_cast<int>(sizeof(unsigned long) * 8)) {
-        shift++;
+    std::vector<uint8_t> scale;
+
+    uint8_t extract(unsigned long pixel) const {
+        if (mask == 0) {
+            return 0;
+        }
+        return scale[(pixel & mask) >> shift];
+    }
+};
+
+ChannelLayout make_layout(unsigned long mask) {
+    ChannelLayout layout;
+    layout.mask = mask;
+    if (mask == 0) {
+        return layout;
+    }
+
+    while (((mask >> layout.shift) & 1UL) == 0UL &&
+           layout.shift < static_cast<int>(sizeof(unsigned long) * 8)) {
+        layout.shift++;
     }
 
-    unsigned long shifted_mask = mask >> shift;
-    int bits = 0;
-    unsigned long tmp = shifted_mask;
-    while (tmp) {
-        bits += (tmp & 1UL);
-        tmp >>= 1;
+    unsigned long max_value = mask >> layout.shift;
+    // Channels wider than 16 bits don't occur in X visuals; clamp the table
+    if (max_value > 0xFFFF) {
+        max_value = 0xFFFF;
+        layout.mask = max_value << layout.shift;
     }
 
-    if (bits == 0) {
-        return 0;
+    layout.scale.resize(max_value + 1);
+    for (unsigned long v = 0; v <= max_value; v++) {
+        double normalized = static_cast<double>(v) * 255.0 / static_cast<double>(max_value);
+        layout.scale[v] = static_cast<uint8_t>(std::lround(std::min(255.0, normalized)));
     }
+    return layout;
+}
 
-    unsigned long value = (pixel & mask) >> shift;
-    double max_val = static_cast<double>(shifted_mask);
-    double normalized = (max_val > 0.0) ? (static_cast<double>(value) * 255.0 / max_val) : 0.0;
-    return static_cast<uint8_t>(std::lround(std::min(255.0, normalized)));
+bool host_is_lsb_first() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
 }
 } // namespace
 
@@ -101,24 +263,158 @@ Image Capture::ximage_to_image(XImage* ximg) {
         alpha_mask = pixel_mask & ~rgb_mask;
     }
 
+    ChannelLayout red = make_layout(ximg->red_mask);
+    ChannelLayout green = make_layout(ximg->green_mask);
+    ChannelLayout blue = make_layout(ximg->blue_mask);
+    ChannelLayout alpha = make_layout(alpha_mask);
+
+    // Native-order 16/32-bit pixels are read straight from the image rows;
+    // anything else goes through XGetPixel.
+    bool native = (ximg->byte_order == LSBFirst) == host_is_lsb_first();
+    bool direct32 = native && ximg->bits_per_pixel == 32;
+    bool direct16 = native && ximg->bits_per_pixel == 16;
+
+    uint8_t* out = img.data();
     for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = reinterpret_cast<const uint8_t*>(ximg->data) +
+                             static_cast<size_t>(y) * ximg->bytes_per_line;
         for (uint32_t x = 0; x < width; x++) {
-            unsigned long pixel = XGetPixel(ximg, x, y);
+            unsigned long pixel;
+            if (direct32) {
+                uint32_t value;
+                std::memcpy(&value, row + x * 4, sizeof(value));
+                pixel = value;
+            } else if (direct16) {
+                uint16_t value;
+                std::memcpy(&value, row + x * 2, sizeof(value));
+                pixel = value;
+            } else {
+                pixel = XGetPixel(ximg, x, y);
+            }
 
-            uint8_t r = extract_channel(pixel, ximg->red_mask);
-            uint8_t g = extract_channel(pixel, ximg->green_mask);
-            uint8_t b = extract_channel(pixel, ximg->blue_mask);
-            uint8_t a = alpha_mask ? extract_channel(pixel, alpha_mask) : 255;
+            uint8_t a = alpha_mask ? alpha.extract(pixel) : 255;
             if (alpha_mask && a == 0) {
                 // Many ARGB visuals leave alpha at 0 for opaque drawables; treat as fully opaque.
                 a = 255;
             }
 
-            img.set_pixel(x, y, r, g, b, a);
+            out[0] = red.extract(pixel);
+            out[1] = green.extract(pixel);
+            out[2] = blue.extract(pixel);
+            out[3] = a;
+            out += 4;
         }
     }
 
     return img;
 }
 
+namespace {
+// Create a ZPixmap XImage whose data is a fresh segment, attached on both
+// sides. The segment is marked for removal right away, so it disappears
+// once both sides detach. Returns false with ximage set if the image was
+// created but not attached; a server refusing the segment doesn't raise an
+// error against the caller.
+bool attach_shm_image(Display& display, Visual* visual, int depth, uint32_t width,
+                      uint32_t height, XImage*& ximage, XShmSegmentInfo& shm) {
+    ::Display* dpy = display.x_display();
+    ximage = XShmCreateImage(dpy, visual, depth, ZPixmap, nullptr, &shm, width, height);
+    if (!ximage) {
+        return false;
+    }
+    shm.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(ximage->bytes_per_line) * height,
+                       IPC_CREAT | 0600);
+    if (shm.shmid < 0) {
+        return false;
+    }
+    shm.shmaddr = ximage->data = static_cast<char*>(shmat(shm.shmid, nullptr, 0));
+    shm.readOnly = False;
+    bool attached = false;
+    if (shm.shmaddr != reinterpret_cast<char*>(-1)) {
+        display.trap_errors();
+        XShmAttach(dpy, &shm);
+        attached = display.untrap_errors();
+    }
+    shmctl(shm.shmid, IPC_RMID, nullptr);
+    return attached;
+}
+
+void release_shm_image(::Display* dpy, bool attached, XImage* ximage, XShmSegmentInfo& shm) {
+    if (attached) {
+        XShmDetach(dpy, &shm);
+        XSync(dpy, False);
+    }
+    if (shm.shmaddr && shm.shmaddr != reinterpret_cast<char*>(-1)) {
+        shmdt(shm.shmaddr);
+    }
+    if (ximage) {
+        ximage->data = nullptr;  // Not malloc'd; keep XDestroyImage away from it
+        XDestroyImage(ximage);
+    }
+}
+} // namespace
+
+ShmRegion::ShmRegion(Display& display, Visual* visual, int depth,
+                     uint32_t width, uint32_t height)
+    : display_(display.x_display()) {
+    if (!display_ || !display.has_shm()) {
+        return;
+    }
+    attached_ = attach_shm_image(display, visual, depth, width, height, ximage_, shm_);
+}
+
+ShmRegion::~ShmRegion() {
+    release_shm_image(display_, attached_, ximage_, shm_);
+}
+
+bool ShmRegion::read(Drawable drawable, int x, int y) {
+    return attached_ && XShmGetImage(display_, drawable, ximage_, x, y, AllPlanes);
+}
+
+unsigned long ShmRegion::pixel(int x, int y) const {
+    return attached_ ? XGetPixel(ximage_, x, y) : 0;
+}
+
+unsigned long ImageView::pixel(uint32_t x, uint32_t y) const {
+    // XGetPixel only reads, despite its non-const signature
+    return ximage_ ? XGetPixel(const_cast<XImage*>(ximage_), x, y) : 0;
+}
+
+Image ImageView::to_image() const {
+    return Capture::ximage_to_image(const_cast<XImage*>(ximage_));
+}
+
+ShmPixmap::ShmPixmap(Display& display, uint32_t width, uint32_t height)
+    : display_(display.x_display()) {
+    if (!display_ || !display.has_shm()) {
+        return;
+    }
+    int major = 0, minor = 0;
+    Bool shared_pixmaps = False;
+    if (!XShmQueryVersion(display_, &major, &minor, &shared_pixmaps) || !shared_pixmaps ||
+        XShmPixmapFormat(display_) != ZPixmap) {
+        return;
+    }
+    attached_ = attach_shm_image(display, display.visual(), display.depth(), width, height,
+                                 ximage_, shm_);
+    if (!attached_) {
+        return;
+    }
+    // Checked like the attach, so a refused pixmap leaves valid() false and
+    // the runner renders to the window instead
+    display.trap_errors();
+    Pixmap pixmap = XShmCreatePixmap(display_, display.root_window(), shm_.shmaddr, &shm_,
+                                     width, height, display.depth());
+    if (display.untrap_errors()) {
+        pixmap_ = pixmap;
+    }
+}
+
+ShmPixmap::~ShmPixmap() {
+    if (pixmap_) {
+        XFreePixmap(display_, pixmap_);
+    }
+    release_shm_image(display_, attached_, ximage_, shm_);
+}
+
 } // namespace x11bench
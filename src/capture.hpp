@@ -2,6 +2,7 @@
 
 #include "image.hpp"
 #include "display.hpp"
+#include <X11/extensions/XShm.h>
 #include <memory>
 
 namespace x11bench {
@@ -15,9 +16,106 @@ public:
     static Image capture_region(Display& display, int x, int y,
                                 uint32_t width, uint32_t height);
 
-private:
-    // Convert XImage to our Image format
+    // Capture with exact alpha: the window's XRender Picture is composited
+    // with PictOpSrc into an a8r8g8b8 pixmap and read back through MIT-SHM
+    // when the server is local. Every window depth comes back in the same
+    // 32-bit layout. Falls back to capture_window() without XRender or
+    // 32-bit pixmap support.
+    static Image capture_window_argb(Display& display);
+
+    // Convert XImage to our Image format. Shared by every capture path so
+    // each pixel format (16, 24, 30 and 32-bit) has one conversion kernel.
     static Image ximage_to_image(XImage* ximg);
+
+    // Convert premultiplied a8r8g8b8 rows (as stored by XRender) to
+    // straight-alpha RGBA.
+    // swap_bytes is set when the rows are in the other byte order than the host.
+    static Image argb32_to_image(const uint8_t* data, uint32_t width, uint32_t height,
+                                 size_t stride, bool swap_bytes);
+};
+
+// A small region read repeatedly through one MIT-SHM segment that stays
+// attached for the object's lifetime, so each read is a single XShmGetImage
+// round trip with no allocation. Pixels stay in the drawable's native format.
+class ShmRegion {
+public:
+    ShmRegion(Display& display, Visual* visual, int depth, uint32_t width, uint32_t height);
+    ~ShmRegion();
+
+    ShmRegion(const ShmRegion&) = delete;
+    ShmRegion& operator=(const ShmRegion&) = delete;
+
+    // False when the server is remote or lacks MIT-SHM
+    bool valid() const { return attached_; }
+
+    // Read the region at (x, y) of the drawable into the segment
+    bool read(Drawable drawable, int x, int y);
+
+    // Native pixel value from the last read
+    unsigned long pixel(int x, int y) const;
+
+private:
+    ::Display* display_ = nullptr;
+    XImage* ximage_ = nullptr;
+    XShmSegmentInfo shm_ = {};
+    bool attached_ = false;
+};
+
+// Read-only view of pixels in the server's native format, borrowed from an
+// XImage without copying. Valid while the owner lives and until the next
+// request draws to the pixels.
+class ImageView {
+public:
+    ImageView() = default;
+    explicit ImageView(const XImage* ximage) : ximage_(ximage) {}
+
+    bool empty() const { return !ximage_; }
+    uint32_t width() const { return ximage_ ? ximage_->width : 0; }
+    uint32_t height() const { return ximage_ ? ximage_->height : 0; }
+    size_t stride() const { return ximage_ ? ximage_->bytes_per_line : 0; }
+    int bits_per_pixel() const { return ximage_ ? ximage_->bits_per_pixel : 0; }
+    const uint8_t* row(uint32_t y) const {
+        return reinterpret_cast<const uint8_t*>(ximage_->data) + y * stride();
+    }
+
+    // Native pixel value
+    unsigned long pixel(uint32_t x, uint32_t y) const;
+
+    // RGBA copy, through the same conversion as every capture
+    Image to_image() const;
+
+private:
+    const XImage* ximage_ = nullptr;
+};
+
+// A pixmap whose storage is a MIT-SHM segment mapped into this process
+// (XShmCreatePixmap). Drawing goes to the pixmap like to a window; after an
+// XSync the pixels are read in place through view(), with no request and no
+// copy. Needs a local server with shared pixmap support in ZPixmap format.
+class ShmPixmap {
+public:
+    ShmPixmap(Display& display, uint32_t width, uint32_t height);
+    ~ShmPixmap();
+
+    ShmPixmap(const ShmPixmap&) = delete;
+    ShmPixmap& operator=(const ShmPixmap&) = delete;
+
+    // False when the server is remote or can't share pixmaps
+    bool valid() const { return pixmap_ != 0; }
+
+    Pixmap pixmap() const { return pixmap_; }
+    uint32_t width() const { return ximage_ ? ximage_->width : 0; }
+    uint32_t height() const { return ximage_ ? ximage_->height : 0; }
+
+    // Current pixels; sync first so the server has finished drawing
+    ImageView view() const { return ImageView(pixmap_ ? ximage_ : nullptr); }
+
+private:
+    ::Display* display_ = nullptr;
+    XImage* ximage_ = nullptr;
+    XShmSegmentInfo shm_ = {};
+    bool attached_ = false;
+    Pixmap pixmap_ = 0;
 };
 
 } // namespace x11bench
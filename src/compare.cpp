@@ -1,10 +1,67 @@
 #include "compare.hpp"
 #include <algorithm>
 #include <cmath>
+#include <map>
+#include <mutex>
 #include <sstream>
 
 namespace x11bench {
 
+namespace {
+// Below this size the full comparison is cheaper than building levels
+const uint32_t PYRAMID_MIN_PIXELS = 64 * 64;
+const uint32_t PYRAMID_MAX_BLOCK = 256;
+const size_t PYRAMID_CACHE_SIZE = 256;
+} // namespace
+
+ImagePyramid::ImagePyramid(const Image& image)
+    : width_(image.width()), height_(image.height()) {
+    if (image.empty()) {
+        return;
+    }
+
+    // First level straight from the pixels
+    Level first;
+    first.block = 2;
+    first.width = (width_ + 1) / 2;
+    first.height = (height_ + 1) / 2;
+    first.sums.assign(static_cast<size_t>(first.width) * first.height * 4, 0);
+    const uint8_t* data = image.data();
+    for (uint32_t y = 0; y < height_; y++) {
+        const uint8_t* row = data + y * image.stride();
+        uint32_t* out = first.sums.data() + static_cast<size_t>(y / 2) * first.width * 4;
+        for (uint32_t x = 0; x < width_; x++) {
+            uint32_t* block = out + (x / 2) * 4;
+            block[0] += row[x * 4 + 0];
+            block[1] += row[x * 4 + 1];
+            block[2] += row[x * 4 + 2];
+            block[3] += row[x * 4 + 3];
+        }
+    }
+    levels_.push_back(std::move(first));
+
+    // Each further level sums 2x2 blocks of the one below
+    while (levels_.back().block < PYRAMID_MAX_BLOCK &&
+           (levels_.back().width > 1 || levels_.back().height > 1)) {
+        const Level& below = levels_.back();
+        Level level;
+        level.block = below.block * 2;
+        level.width = (below.width + 1) / 2;
+        level.height = (below.height + 1) / 2;
+        level.sums.assign(static_cast<size_t>(level.width) * level.height * 4, 0);
+        for (uint32_t y = 0; y < below.height; y++) {
+            const uint32_t* in = below.sums.data() + static_cast<size_t>(y) * below.width * 4;
+            uint32_t* out = level.sums.data() + static_cast<size_t>(y / 2) * level.width * 4;
+            for (uint32_t x = 0; x < below.width; x++) {
+                for (int c = 0; c < 4; c++) {
+                    out[(x / 2) * 4 + c] += in[x * 4 + c];
+                }
+            }
+        }
+        levels_.push_back(std::move(level));
+    }
+}
+
 int Compare::channel_diff(uint8_t a, uint8_t b) {
     return std::abs(static_cast<int>(a) - static_cast<int>(b));
 }
@@ -14,6 +71,11 @@ CompareResult Compare::exact(const Image& img1, const Image& img2) {
 }
 
 CompareResult Compare::fuzzy(const Image& img1, const Image& img2, int tolerance) {
+    return fuzzy_tiles(img1, img2, tolerance, 0, {});
+}
+
+CompareResult Compare::fuzzy_tiles(const Image& img1, const Image& img2, int tolerance,
+                                   uint32_t tile, const std::vector<bool>& dirty) {
     CompareResult result;
 
     // Check dimensions
@@ -36,31 +98,47 @@ CompareResult Compare::fuzzy(const Image& img1, const Image& img2, int tolerance
     result.different_pixels = 0;
     result.max_channel_diff = 0.0;
     double total_diff = 0.0;
-    uint64_t channel_count = 0;
 
-    for (uint32_t y = 0; y < img1.height(); y++) {
-        for (uint32_t x = 0; x < img1.width(); x++) {
-            Pixel p1 = img1.get_pixel(x, y);
-            Pixel p2 = img2.get_pixel(x, y);
+    // Without a mask the whole image is one dirty tile
+    uint32_t tile_w = tile > 0 ? tile : img1.width();
+    uint32_t tile_h = tile > 0 ? tile : img1.height();
+    uint32_t columns = (img1.width() + tile_w - 1) / tile_w;
+    uint32_t rows = (img1.height() + tile_h - 1) / tile_h;
+
+    for (uint32_t ty = 0; ty < rows; ty++) {
+        for (uint32_t tx = 0; tx < columns; tx++) {
+            size_t index = static_cast<size_t>(ty) * columns + tx;
+            if (tile > 0 && index < dirty.size() && !dirty[index]) {
+                continue;
+            }
+            uint32_t x_end = std::min(img1.width(), (tx + 1) * tile_w);
+            uint32_t y_end = std::min(img1.height(), (ty + 1) * tile_h);
+            for (uint32_t y = ty * tile_h; y < y_end; y++) {
+                for (uint32_t x = tx * tile_w; x < x_end; x++) {
+                    Pixel p1 = img1.get_pixel(x, y);
+                    Pixel p2 = img2.get_pixel(x, y);
 
-            int dr = channel_diff(p1.r, p2.r);
-            int dg = channel_diff(p1.g, p2.g);
-            int db = channel_diff(p1.b, p2.b);
-            int da = channel_diff(p1.a, p2.a);
+                    int dr = channel_diff(p1.r, p2.r);
+                    int dg = channel_diff(p1.g, p2.g);
+                    int db = channel_diff(p1.b, p2.b);
+                    int da = channel_diff(p1.a, p2.a);
 
-            int max_diff = std::max({dr, dg, db, da});
-            result.max_channel_diff = std::max(result.max_channel_diff, static_cast<double>(max_diff));
+                    int max_diff = std::max({dr, dg, db, da});
+                    result.max_channel_diff = std::max(result.max_channel_diff,
+                                                       static_cast<double>(max_diff));
 
-            total_diff += dr + dg + db + da;
-            channel_count += 4;
+                    total_diff += dr + dg + db + da;
 
-            if (max_diff > tolerance) {
-                result.different_pixels++;
+                    if (max_diff > tolerance) {
+                        result.different_pixels++;
+                    }
+                }
             }
         }
     }
 
-    result.avg_channel_diff = channel_count > 0 ? total_diff / channel_count : 0.0;
+    // Skipped tiles are identical, so they only add zeros to the average
+    result.avg_channel_diff = total_diff / (4.0 * result.total_pixels);
     result.difference_percent = result.total_pixels > 0 ?
         (100.0 * result.different_pixels / result.total_pixels) : 0.0;
     result.match = (result.different_pixels == 0);
@@ -85,8 +163,11 @@ CompareResult Compare::fuzzy(const Image& img1, const Image& img2, int tolerance
 
 CompareResult Compare::fuzzy_percent(const Image& img1, const Image& img2,
                                       double max_diff_percent, int tolerance) {
-    CompareResult result = fuzzy(img1, img2, tolerance);
+    return within_percent(fuzzy(img1, img2, tolerance), max_diff_percent, tolerance);
+}
 
+CompareResult Compare::within_percent(CompareResult result, double max_diff_percent,
+                                      int tolerance) {
     // Override match based on percentage threshold
     result.match = (result.difference_percent <= max_diff_percent);
 
@@ -104,6 +185,142 @@ CompareResult Compare::fuzzy_percent(const Image& img1, const Image& img2,
     return result;
 }
 
+uint32_t Compare::allowed_differing(uint32_t total_pixels, double max_diff_percent) {
+    // Same test as fuzzy_percent(): 100 * differing / total <= max_diff_percent
+    uint32_t allowed = static_cast<uint32_t>(max_diff_percent * total_pixels / 100.0);
+    while (allowed < total_pixels && 100.0 * (allowed + 1) / total_pixels <= max_diff_percent) {
+        allowed++;
+    }
+    while (allowed > 0 && 100.0 * allowed / total_pixels > max_diff_percent) {
+        allowed--;
+    }
+    return allowed;
+}
+
+std::shared_ptr<const ImagePyramid> Compare::reference_pyramid(const Image& reference,
+                                                               const std::string& key) {
+    if (key.empty()) {
+        return std::make_shared<ImagePyramid>(reference);
+    }
+
+    static std::mutex mutex;
+    static std::map<std::string, std::shared_ptr<const ImagePyramid>> cache;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(key);
+        if (it != cache.end() && it->second->width() == reference.width() &&
+            it->second->height() == reference.height()) {
+            return it->second;
+        }
+    }
+
+    auto pyramid = std::make_shared<const ImagePyramid>(reference);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cache.size() >= PYRAMID_CACHE_SIZE) {
+        cache.clear();
+    }
+    cache[key] = pyramid;
+    return pyramid;
+}
+
+bool Compare::pyramid_reject(const Image& reference, const Image& captured,
+                             int tolerance, uint32_t max_differing,
+                             CompareResult& result, const std::string& reference_key) {
+    if (reference.width() != captured.width() || reference.height() != captured.height() ||
+        reference.empty() || captured.empty() ||
+        reference.width() * reference.height() < PYRAMID_MIN_PIXELS) {
+        return false;
+    }
+
+    auto ref = reference_pyramid(reference, reference_key);
+    ImagePyramid cap(captured);
+    uint32_t width = captured.width();
+    uint32_t height = captured.height();
+
+    // |sum_a - sum_b| <= pixels * max per-pixel diff, so a block whose sums
+    // are further apart than pixels * tolerance holds a pixel beyond
+    // tolerance. Returns the rounded-up mean gap, or 0 for an unproven block.
+    auto block_gap = [&](size_t level, uint32_t bx, uint32_t by) -> uint32_t {
+        const ImagePyramid::Level& a = ref->levels()[level];
+        const ImagePyramid::Level& b = cap.levels()[level];
+        uint32_t pixels = std::min(a.block, width - bx * a.block) *
+                          std::min(a.block, height - by * a.block);
+        size_t index = (static_cast<size_t>(by) * a.width + bx) * 4;
+        uint32_t gap = 0;
+        for (int c = 0; c < 4; c++) {
+            uint32_t sa = a.sums[index + c];
+            uint32_t sb = b.sums[index + c];
+            gap = std::max(gap, sa > sb ? sa - sb : sb - sa);
+        }
+        if (gap <= static_cast<uint64_t>(pixels) * static_cast<uint32_t>(tolerance)) {
+            return 0;
+        }
+        return (gap + pixels - 1) / pixels;
+    };
+
+    // Scan whole levels top-down until one proves too many differing pixels.
+    // A proven block always has a proven child, so from there on only the
+    // children of proven blocks are visited to localize the difference.
+    std::vector<std::pair<uint32_t, uint32_t>> proven;
+    bool rejected = false;
+    uint32_t max_mean_diff = 0;
+    for (size_t level = ref->levels().size(); level-- > 0;) {
+        const ImagePyramid::Level& a = ref->levels()[level];
+        std::vector<std::pair<uint32_t, uint32_t>> next;
+        max_mean_diff = 0;
+        auto visit = [&](uint32_t bx, uint32_t by) {
+            if (bx >= a.width || by >= a.height) return;
+            uint32_t gap = block_gap(level, bx, by);
+            if (gap > 0) {
+                next.emplace_back(bx, by);
+                max_mean_diff = std::max(max_mean_diff, gap);
+            }
+        };
+
+        if (!rejected) {
+            for (uint32_t by = 0; by < a.height; by++) {
+                for (uint32_t bx = 0; bx < a.width; bx++) {
+                    visit(bx, by);
+                }
+            }
+        } else {
+            for (const auto& [px, py] : proven) {
+                visit(px * 2, py * 2);
+                visit(px * 2 + 1, py * 2);
+                visit(px * 2, py * 2 + 1);
+                visit(px * 2 + 1, py * 2 + 1);
+            }
+        }
+        proven = std::move(next);
+        rejected = rejected || proven.size() > max_differing;
+    }
+    if (!rejected) {
+        return false;
+    }
+
+    uint32_t block = ref->levels().front().block;
+    uint32_t x0 = width, y0 = height, x1 = 0, y1 = 0;
+    for (const auto& [bx, by] : proven) {
+        x0 = std::min(x0, bx * block);
+        y0 = std::min(y0, by * block);
+        x1 = std::max(x1, std::min(width, (bx + 1) * block));
+        y1 = std::max(y1, std::min(height, (by + 1) * block));
+    }
+
+    result.match = false;
+    result.total_pixels = width * height;
+    result.different_pixels = static_cast<uint32_t>(proven.size());
+    result.difference_percent = 100.0 * result.different_pixels / result.total_pixels;
+    result.max_channel_diff = max_mean_diff;
+    result.avg_channel_diff = 0.0;
+
+    std::ostringstream oss;
+    oss << "at least " << result.different_pixels << " pixels differ (coarse check), in region "
+        << x0 << "," << y0 << " " << (x1 - x0) << "x" << (y1 - y0);
+    result.message = oss.str();
+    return true;
+}
+
 Image Compare::generate_diff(const Image& img1, const Image& img2, int tolerance) {
     uint32_t width = std::max(img1.width(), img2.width());
     uint32_t height = std::max(img1.height(), img2.height());
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "image.hpp"
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace x11bench {
 
@@ -15,6 +17,31 @@ struct CompareResult {
     std::string message;
 };
 
+// Box-filtered mip levels of an image for coarse-to-fine comparison. Level i
+// holds, for each 2^(i+1) x 2^(i+1) block, the exact per-channel sums of its
+// pixels (edge blocks cover fewer pixels). Levels stop at 256x256 blocks so
+// the sums fit 32 bits.
+class ImagePyramid {
+public:
+    struct Level {
+        uint32_t width = 0;          // In blocks
+        uint32_t height = 0;
+        uint32_t block = 0;          // Block edge in full-resolution pixels
+        std::vector<uint32_t> sums;  // RGBA, 4 per block, row-major
+    };
+
+    explicit ImagePyramid(const Image& image);
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    const std::vector<Level>& levels() const { return levels_; }
+
+private:
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    std::vector<Level> levels_;
+};
+
 class Compare {
 public:
     // Exact pixel comparison
@@ -28,11 +55,38 @@ public:
                                         double max_diff_percent,
                                         int tolerance = 0);
 
+    // fuzzy() restricted to the tile x tile blocks whose entry in `dirty`
+    // (row-major, as Image::tile_hashes) is set. Clean tiles must be known
+    // identical; the counts are then the same as a full fuzzy() pass.
+    static CompareResult fuzzy_tiles(const Image& img1, const Image& img2, int tolerance,
+                                     uint32_t tile, const std::vector<bool>& dirty);
+
+    // Apply fuzzy_percent()'s threshold to an existing fuzzy result
+    static CompareResult within_percent(CompareResult result, double max_diff_percent,
+                                        int tolerance = 0);
+
+    // Coarse-to-fine pre-check. Walks the pyramids of both images from the
+    // coarsest level down; a block whose mean differs by more than
+    // `tolerance` in any channel proves at least one of its pixels does. As
+    // soon as a level proves more than `max_differing` pixels differ, fills
+    // `result` (different_pixels is then a lower bound) and returns true.
+    // Returns false when the full comparison is still needed. Reference
+    // pyramids are cached under `reference_key` when one is given.
+    static bool pyramid_reject(const Image& reference, const Image& captured,
+                               int tolerance, uint32_t max_differing,
+                               CompareResult& result,
+                               const std::string& reference_key = "");
+
+    // Largest number of differing pixels fuzzy_percent() accepts
+    static uint32_t allowed_differing(uint32_t total_pixels, double max_diff_percent);
+
     // Generate a diff image (highlights differences in red)
     static Image generate_diff(const Image& img1, const Image& img2, int tolerance = 0);
 
 private:
     static int channel_diff(uint8_t a, uint8_t b);
+    static std::shared_ptr<const ImagePyramid> reference_pyramid(const Image& reference,
+                                                                 const std::string& key);
 };
 
 } // namespace x11bench
@@ -0,0 +1,288 @@
+#include "dir_compare.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_RESET   "\033[0m"
+
+namespace x11bench {
+
+namespace {
+// Runner by-products that sit next to references
+bool is_comparable(const fs::path& path) {
+    if (path.extension() != ".png") {
+        return false;
+    }
+    std::string stem = path.stem().string();
+    auto ends_with = [&](const char* suffix) {
+        std::string s = suffix;
+        return stem.size() > s.size() && stem.compare(stem.size() - s.size(), s.size(), s) == 0;
+    };
+    return !ends_with("_fail") && !ends_with("_diff");
+}
+
+// Relative path without extension, '/'-separated
+std::map<std::string, std::string> scan(const std::string& dir) {
+    std::map<std::string, std::string> images;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, ec);
+         !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (!it->is_regular_file() || !is_comparable(it->path())) {
+            continue;
+        }
+        fs::path relative = fs::relative(it->path(), dir);
+        relative.replace_extension();
+        images[relative.generic_string()] = it->path().string();
+    }
+    return images;
+}
+
+std::string json_escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+const char* status_name(TestStatus status) {
+    switch (status) {
+        case TestStatus::Passed: return "passed";
+        case TestStatus::Failed: return "failed";
+        case TestStatus::Error: return "error";
+        case TestStatus::Generated: return "generated";
+        case TestStatus::Unchanged: return "unchanged";
+        case TestStatus::Timeout: return "timeout";
+    }
+    return "error";
+}
+} // namespace
+
+DirCompare::DirCompare(const DirCompareOptions& options)
+    : options_(options) {
+    // Self-verifying tests (tolerance -1) have no references; anything found
+    // under their name is compared exactly
+    for (const auto& info : get_test_registry()) {
+        auto test = info.factory();
+        Tolerances t;
+        t.tolerance = std::max(0, test->tolerance());
+        t.allowed_diff_percent = test->allowed_diff_percent();
+        tolerances_[test->name()] = t;
+    }
+}
+
+bool DirCompare::run() {
+    results_.clear();
+    std::vector<ImagePair> pairs;
+    if (!collect_pairs(pairs)) {
+        return false;
+    }
+
+    std::vector<TestResult> results(pairs.size());
+    std::vector<CompareResult> compares(pairs.size());
+    {
+        ThreadPool pool(options_.jobs);
+        for (size_t i = 0; i < pairs.size(); i++) {
+            pool.submit([this, &pairs, &results, &compares, i]() {
+                results[i] = compare_pair(pairs[i], compares[i]);
+            });
+        }
+        pool.wait();
+    }
+
+    for (const auto& result : results) {
+        print(result);
+    }
+    results_ = std::move(results);
+
+    if (!options_.report_path.empty() && !write_report(pairs, compares)) {
+        error_ = "cannot write report " + options_.report_path;
+        return false;
+    }
+    return true;
+}
+
+bool DirCompare::collect_pairs(std::vector<ImagePair>& pairs) {
+    if (!options_.pairs_file.empty()) {
+        std::ifstream in(options_.pairs_file);
+        if (!in) {
+            error_ = "cannot read " + options_.pairs_file;
+            return false;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            ImagePair pair;
+            if (!(fields >> pair.path_a >> pair.path_b) || pair.path_a[0] == '#') {
+                continue;
+            }
+            if (!(fields >> pair.name)) {
+                pair.name = fs::path(pair.path_b).stem().string();
+            }
+            pairs.push_back(pair);
+        }
+        return true;
+    }
+
+    for (const auto& dir : {options_.dir_a, options_.dir_b}) {
+        if (!fs::is_directory(dir)) {
+            error_ = dir + " is not a directory";
+            return false;
+        }
+    }
+    auto images_a = scan(options_.dir_a);
+    auto images_b = scan(options_.dir_b);
+    for (const auto& [name, path] : images_a) {
+        auto other = images_b.find(name);
+        pairs.push_back({name, path, other != images_b.end() ? other->second : ""});
+    }
+    for (const auto& [name, path] : images_b) {
+        if (!images_a.count(name)) {
+            pairs.push_back({name, "", path});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(),
+              [](const ImagePair& a, const ImagePair& b) { return a.name < b.name; });
+    return true;
+}
+
+DirCompare::Tolerances DirCompare::tolerances_for(const std::string& name) const {
+    std::string test = fs::path(name).filename().string();
+    test = test.substr(0, test.find_first_of("@~"));
+
+    Tolerances t;
+    auto it = tolerances_.find(test);
+    if (it != tolerances_.end()) {
+        t = it->second;
+    }
+    if (options_.tolerance >= 0) {
+        t.tolerance = options_.tolerance;
+    }
+    return t;
+}
+
+TestResult DirCompare::compare_pair(const ImagePair& pair, CompareResult& cmp) const {
+    auto start = std::chrono::steady_clock::now();
+    TestResult result;
+    result.name = pair.name;
+    result.status = TestStatus::Error;
+
+    Image a, b;
+    if (pair.path_a.empty() || pair.path_b.empty()) {
+        result.message = std::string("only in ") + (pair.path_a.empty() ? "B" : "A");
+    } else if (!a.load_png(pair.path_a)) {
+        result.message = "cannot load " + pair.path_a;
+    } else if (!b.load_png(pair.path_b)) {
+        result.message = "cannot load " + pair.path_b;
+    } else {
+        // Same steps as a live run, minus the tile manifest
+        Tolerances t = tolerances_for(pair.name);
+        uint32_t allowed = t.allowed_diff_percent > 0
+            ? Compare::allowed_differing(b.width() * b.height(), t.allowed_diff_percent)
+            : 0;
+        if (!Compare::pyramid_reject(a, b, t.tolerance, allowed, cmp)) {
+            cmp = Compare::fuzzy(a, b, t.tolerance);
+            if (t.allowed_diff_percent > 0) {
+                cmp = Compare::within_percent(std::move(cmp), t.allowed_diff_percent,
+                                              t.tolerance);
+            }
+        }
+        result.status = cmp.match ? TestStatus::Passed : TestStatus::Failed;
+        result.message = cmp.match ? "" : cmp.message;
+        if (cmp.match && options_.verbose && cmp.different_pixels > 0) {
+            result.message = std::to_string(cmp.different_pixels) + " pixels within tolerance";
+        }
+
+        if (!cmp.match && !options_.diff_dir.empty()) {
+            fs::path diff_path = fs::path(options_.diff_dir) / (pair.name + "_diff.png");
+            std::error_code ec;
+            fs::create_directories(diff_path.parent_path(), ec);
+            if (Compare::generate_diff(a, b, t.tolerance).save_png(diff_path.string()) &&
+                options_.verbose) {
+                result.message += "\n    Saved diff: " + diff_path.string();
+            }
+        }
+    }
+
+    result.duration_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+bool DirCompare::write_report(const std::vector<ImagePair>& pairs,
+                              const std::vector<CompareResult>& compares) const {
+    std::ofstream out(options_.report_path);
+    if (!out) {
+        return false;
+    }
+
+    int passed = 0;
+    out << "{\n  \"a\": \"" << json_escape(options_.pairs_file.empty() ? options_.dir_a : "")
+        << "\",\n  \"b\": \"" << json_escape(options_.pairs_file.empty() ? options_.dir_b : "")
+        << "\",\n  \"results\": [";
+    for (size_t i = 0; i < results_.size(); i++) {
+        const TestResult& r = results_[i];
+        const CompareResult& c = compares[i];
+        passed += r.status == TestStatus::Passed;
+        out << (i ? "," : "") << "\n    {\"name\": \"" << json_escape(r.name)
+            << "\", \"status\": \"" << status_name(r.status)
+            << "\", \"a\": \"" << json_escape(pairs[i].path_a)
+            << "\", \"b\": \"" << json_escape(pairs[i].path_b)
+            << "\", \"different_pixels\": " << c.different_pixels
+            << ", \"total_pixels\": " << c.total_pixels
+            << ", \"difference_percent\": " << c.difference_percent
+            << ", \"max_channel_diff\": " << c.max_channel_diff
+            << ", \"message\": \"" << json_escape(r.message) << "\"}";
+    }
+    out << "\n  ],\n  \"passed\": " << passed
+        << ",\n  \"failed\": " << (results_.size() - passed) << "\n}\n";
+    return static_cast<bool>(out);
+}
+
+void DirCompare::print(const TestResult& result) const {
+    std::cout << std::left << std::setw(35) << result.name << " ";
+    switch (result.status) {
+        case TestStatus::Passed:
+            std::cout << COLOR_GREEN << "[PASS]" << COLOR_RESET;
+            if (!result.message.empty()) {
+                std::cout << " (" << result.message << ")";
+            }
+            break;
+        case TestStatus::Failed:
+            std::cout << COLOR_RED << "[FAIL]" << COLOR_RESET << " " << result.message;
+            break;
+        default:
+            std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " " << result.message;
+            break;
+    }
+    if (options_.verbose) {
+        std::cout << " (" << std::fixed << std::setprecision(1) << result.duration_ms << " ms)";
+    }
+    std::cout << "\n";
+}
+
+} // namespace x11bench
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "compare.hpp"
+#include "runner.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+struct DirCompareOptions {
+    std::string dir_a;         // Expected images (e.g. the reference tree)
+    std::string dir_b;         // Actual images (e.g. captures from another machine)
+    std::string pairs_file;    // Alternative to the directories: "A B [NAME]" per line
+    unsigned jobs = 0;         // Compare threads; 0 = hardware concurrency
+    int tolerance = -1;        // Overrides every test's tolerance when >= 0
+    std::string report_path;   // JSON report
+    std::string diff_dir;      // Diff images of failures go here
+    bool verbose = false;
+};
+
+// One pair of images to compare. The name is the path relative to the
+// directory without ".png"; its last component, minus any "@checkpoint"
+// and "~variant", picks the registered test whose tolerances apply.
+struct ImagePair {
+    std::string name;
+    std::string path_a;        // Empty when only B has the image
+    std::string path_b;        // Empty when only A has the image
+};
+
+// Compares captured images without an X connection: pairs PNGs by name
+// across two directory trees (or from a pairs file) and compares each pair
+// on a thread pool with the same pyramid pre-check and tolerance semantics
+// as a live run.
+class DirCompare {
+public:
+    explicit DirCompare(const DirCompareOptions& options);
+
+    // False if the inputs could not be read
+    bool run();
+
+    const std::vector<TestResult>& results() const { return results_; }
+    const std::string& error() const { return error_; }
+
+private:
+    struct Tolerances {
+        int tolerance = 0;
+        double allowed_diff_percent = 0.0;
+    };
+
+    DirCompareOptions options_;
+    std::map<std::string, Tolerances> tolerances_;  // By test name
+    std::vector<TestResult> results_;
+    std::string error_;
+
+    bool collect_pairs(std::vector<ImagePair>& pairs);
+    Tolerances tolerances_for(const std::string& name) const;
+    TestResult compare_pair(const ImagePair& pair, CompareResult& cmp) const;
+    bool write_report(const std::vector<ImagePair>& pairs,
+                      const std::vector<CompareResult>& compares) const;
+    void print(const TestResult& result) const;
+};
+
+} // namespace x11bench
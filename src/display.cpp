@@ -1,10 +1,38 @@
 #include "display.hpp"
+#include "profile.hpp"
+#include <X11/extensions/XShm.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
 #include <chrono>
+#include <map>
+#include <mutex>
 
 namespace x11bench {
 
+namespace {
+// Xft keeps an unlocked process-wide list of per-display state, so every Xft
+// call (and XCloseDisplay, which triggers Xft's close hook) is serialized when
+// the runner drives several connections from separate threads.
+std::mutex& xft_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Connections known to the process-wide error handlers
+std::mutex& registry_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::map<::Display*, Display*>& connection_registry() {
+    static std::map<::Display*, Display*> registry;
+    return registry;
+}
+
+const size_t MAX_MARKS = 64;
+} // namespace
+
 Display::Display() = default;
 
 Display::~Display() {
@@ -14,14 +42,22 @@ Display::~Display() {
 Display::Display(Display&& other) noexcept
     : display_(other.display_), window_(other.window_), screen_(other.screen_),
       visual_(other.visual_), colormap_(other.colormap_), depth_(other.depth_),
-      gc_(other.gc_), width_(other.width_), height_(other.height_),
-      has_xrender_(other.has_xrender_), picture_(other.picture_),
-      pict_format_(other.pict_format_), xft_draw_(other.xft_draw_) {
+      own_colormap_(other.own_colormap_), gc_(other.gc_), width_(other.width_), height_(other.height_),
+      has_xrender_(other.has_xrender_), has_shm_(other.has_shm_), picture_(other.picture_),
+      pict_format_(other.pict_format_), xft_draw_(other.xft_draw_),
+      tiles_(std::move(other.tiles_)), main_(other.main_), tile_(other.tile_) {
     other.display_ = nullptr;
     other.window_ = 0;
+    other.own_colormap_ = false;
     other.gc_ = nullptr;
     other.picture_ = 0;
     other.xft_draw_ = nullptr;
+    other.tiles_.clear();
+    other.main_ = Target();
+    other.tile_ = -1;
+    if (display_) {
+        register_connection();
+    }
 }
 
 Display& Display::operator=(Display&& other) noexcept {
@@ -33,25 +69,38 @@ Display& Display::operator=(Display&& other) noexcept {
         visual_ = other.visual_;
         colormap_ = other.colormap_;
         depth_ = other.depth_;
+        own_colormap_ = other.own_colormap_;
         gc_ = other.gc_;
         width_ = other.width_;
         height_ = other.height_;
         has_xrender_ = other.has_xrender_;
+        has_shm_ = other.has_shm_;
         picture_ = other.picture_;
         pict_format_ = other.pict_format_;
         xft_draw_ = other.xft_draw_;
+        tiles_ = std::move(other.tiles_);
+        main_ = other.main_;
+        tile_ = other.tile_;
 
         other.display_ = nullptr;
         other.window_ = 0;
+        other.own_colormap_ = false;
         other.gc_ = nullptr;
         other.picture_ = 0;
         other.xft_draw_ = nullptr;
+        other.tiles_.clear();
+        other.main_ = Target();
+        other.tile_ = -1;
+        if (display_) {
+            register_connection();
+        }
     }
     return *this;
 }
 
 void Display::cleanup() {
     if (xft_draw_) {
+        std::lock_guard<std::mutex> lock(xft_mutex());
         XftDrawDestroy(xft_draw_);
         xft_draw_ = nullptr;
     }
@@ -63,37 +112,255 @@ void Display::cleanup() {
     disconnect();
 }
 
-bool Display::connect(const std::string& display_name) {
+bool Display::connect(const std::string& display_name, VisualID visual_id) {
     if (display_) {
         return true;  // Already connected
     }
 
     const char* name = display_name.empty() ? nullptr : display_name.c_str();
-    display_ = XOpenDisplay(name);
+    {
+        StartupProfile::Scope scope("XOpenDisplay");
+        display_ = XOpenDisplay(name);
+    }
     if (!display_) {
         return false;
     }
+    StartupProfile::Scope scope("extension queries");
+    io_error_ = false;
+    register_connection();
 
     screen_ = DefaultScreen(display_);
     visual_ = DefaultVisual(display_, screen_);
     depth_ = DefaultDepth(display_, screen_);
     colormap_ = DefaultColormap(display_, screen_);
 
-    // Check for XRender
+    if (visual_id != 0 && visual_id != XVisualIDFromVisual(visual_)) {
+        XVisualInfo templ;
+        templ.visualid = visual_id;
+        templ.screen = screen_;
+        int count = 0;
+        XVisualInfo* info = XGetVisualInfo(display_, VisualIDMask | VisualScreenMask,
+                                           &templ, &count);
+        if (!info || count == 0) {
+            if (info) XFree(info);
+            disconnect();
+            return false;
+        }
+
+        visual_ = info[0].visual;
+        depth_ = info[0].depth;
+        XFree(info);
+
+        // Windows of a non-default visual need a colormap of that visual
+        colormap_ = XCreateColormap(display_, RootWindow(display_, screen_),
+                                    visual_, AllocNone);
+        own_colormap_ = true;
+    }
+
+    // Check for XRender and the visual's format, once per connection
     int event_base, error_base;
     has_xrender_ = XRenderQueryExtension(display_, &event_base, &error_base);
+    pict_format_ = has_xrender_ ? XRenderFindVisualFormat(display_, visual_) : nullptr;
+
+    // The server can only attach our segments if it runs on this machine
+    const char* connected = DisplayString(display_);
+    has_shm_ = XShmQueryExtension(display_) && connected &&
+               (connected[0] == ':' || std::strncmp(connected, "unix:", 5) == 0);
 
     return true;
 }
 
+void Display::register_connection() {
+    static std::once_flag installed;
+    std::call_once(installed, []() { XSetErrorHandler(&Display::handle_error); });
+
+#ifdef HAVE_XSETIOERROREXITHANDLER
+    // Let a broken connection fail the current test instead of exit()ing
+    XSetIOErrorExitHandler(display_, &Display::handle_io_error_exit, nullptr);
+#endif
+
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    connection_registry()[display_] = this;
+}
+
+void Display::unregister_connection() {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    connection_registry().erase(display_);
+}
+
+int Display::handle_error(::Display* display, XErrorEvent* event) {
+    Display* self = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        auto it = connection_registry().find(display);
+        if (it != connection_registry().end()) {
+            self = it->second;
+        }
+    }
+    if (!self) {
+        return 0;
+    }
+
+    XErrorRecord record;
+    record.serial = event->serial;
+    record.error_code = event->error_code;
+    record.request_code = event->request_code;
+    record.minor_code = event->minor_code;
+
+    std::lock_guard<std::mutex> lock(self->errors_mutex_);
+    if (self->trapping_ && record.serial >= self->trap_serial_) {
+        self->trapped_++;
+        return 0;
+    }
+    // Marks are in serial order; the owning context is the last one at or
+    // before the failing request
+    auto owner = std::upper_bound(
+        self->marks_.begin(), self->marks_.end(), record.serial,
+        [](unsigned long serial, const std::pair<unsigned long, std::string>& mark) {
+            return serial < mark.first;
+        });
+    if (owner != self->marks_.begin()) {
+        record.context = std::prev(owner)->second;
+    }
+    self->errors_.push_back(std::move(record));
+    return 0;
+}
+
+void Display::handle_io_error_exit(::Display* display, void* /*user_data*/) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    auto it = connection_registry().find(display);
+    if (it != connection_registry().end()) {
+        it->second->io_error_ = true;
+    }
+}
+
+void Display::mark(const std::string& context) {
+    if (!display_) return;
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    marks_.emplace_back(NextRequest(display_), context);
+    if (marks_.size() > MAX_MARKS) {
+        marks_.pop_front();
+    }
+}
+
+std::vector<XErrorRecord> Display::take_errors() {
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    std::vector<XErrorRecord> errors;
+    errors.swap(errors_);
+    return errors;
+}
+
+void Display::trap_errors() {
+    if (!display_) return;
+    // Earlier requests' errors still belong to their marks
+    XSync(display_, False);
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    trapping_ = true;
+    trap_serial_ = NextRequest(display_);
+    trapped_ = 0;
+}
+
+bool Display::untrap_errors() {
+    if (!display_) return false;
+    XSync(display_, False);
+    std::lock_guard<std::mutex> lock(errors_mutex_);
+    trapping_ = false;
+    return trapped_ == 0 && !io_error_;
+}
+
+std::string Display::describe_error(const XErrorRecord& error) const {
+    char text[256] = "unknown error";
+    char request[256] = "";
+    if (display_) {
+        XGetErrorText(display_, error.error_code, text, sizeof(text));
+        std::string key = std::to_string(error.request_code);
+        XGetErrorDatabaseText(display_, "XRequest", key.c_str(), "", request, sizeof(request));
+    }
+
+    std::string description = text;
+    description += " in ";
+    description += request[0] ? request : "request " + std::to_string(error.request_code) +
+                                          "." + std::to_string(error.minor_code);
+    description += " (serial " + std::to_string(error.serial);
+    if (!error.context.empty()) {
+        description += ", " + error.context;
+    }
+    description += ")";
+    return description;
+}
+
 void Display::disconnect() {
+    if (display_ && own_colormap_) {
+        XFreeColormap(display_, colormap_);
+        own_colormap_ = false;
+    }
     if (display_) {
+        unregister_connection();
+        std::lock_guard<std::mutex> lock(xft_mutex());
         XCloseDisplay(display_);
         display_ = nullptr;
     }
 }
 
-bool Display::create_window(uint32_t width, uint32_t height, const std::string& title) {
+std::vector<VisualSpec> Display::truecolor_visuals() const {
+    std::vector<VisualSpec> visuals;
+    if (!display_) {
+        return visuals;
+    }
+
+    Visual* default_visual = DefaultVisual(display_, screen_);
+    VisualSpec primary;
+    primary.id = XVisualIDFromVisual(default_visual);
+    primary.depth = DefaultDepth(display_, screen_);
+    primary.tag = visual_tag(primary.depth);
+    visuals.push_back(primary);
+
+    XVisualInfo templ;
+    templ.screen = screen_;
+    templ.c_class = TrueColor;
+    int count = 0;
+    XVisualInfo* info = XGetVisualInfo(display_, VisualScreenMask | VisualClassMask,
+                                       &templ, &count);
+    for (int i = 0; info && i < count; i++) {
+        bool seen = false;
+        for (const auto& v : visuals) {
+            seen = seen || v.depth == info[i].depth;
+        }
+        if (!seen) {
+            visuals.push_back({info[i].visualid, info[i].depth, visual_tag(info[i].depth)});
+        }
+    }
+    if (info) {
+        XFree(info);
+    }
+
+    return visuals;
+}
+
+std::string Display::visual_tag(int depth) {
+    switch (depth) {
+        case 24: return "";
+        case 32: return "argb32";
+        default: return "depth" + std::to_string(depth);
+    }
+}
+
+unsigned long Display::white_pixel() {
+    if (!own_colormap_) {
+        return WhitePixel(display_, screen_);
+    }
+    return alloc_color(255, 255, 255);
+}
+
+unsigned long Display::black_pixel() {
+    if (!own_colormap_) {
+        return BlackPixel(display_, screen_);
+    }
+    return alloc_color(0, 0, 0);
+}
+
+bool Display::create_window(uint32_t width, uint32_t height, const std::string& title,
+                            int x, int y) {
     if (!display_) {
         return false;
     }
@@ -106,15 +373,15 @@ bool Display::create_window(uint32_t width, uint32_t height, const std::string&
 
     // Create window with simple attributes
     XSetWindowAttributes attrs;
-    attrs.background_pixel = WhitePixel(display_, screen_);
-    attrs.border_pixel = BlackPixel(display_, screen_);
+    attrs.background_pixel = white_pixel();
+    attrs.border_pixel = black_pixel();
     attrs.event_mask = ExposureMask | StructureNotifyMask;
     attrs.colormap = colormap_;
 
     window_ = XCreateWindow(
         display_,
         RootWindow(display_, screen_),
-        0, 0,
+        x, y,
         width, height,
         0,
         depth_,
@@ -132,58 +399,50 @@ bool Display::create_window(uint32_t width, uint32_t height, const std::string&
     XStoreName(display_, window_, title.c_str());
 
     // Create graphics context
-    gc_ = XCreateGC(display_, window_, 0, nullptr);
-    if (!gc_) {
+    if (!init_gc()) {
         XDestroyWindow(display_, window_);
         window_ = 0;
         return false;
     }
 
-    // Initialize GC with known defaults to avoid server-defined surprises
-    XSetForeground(display_, gc_, BlackPixel(display_, screen_));
-    XSetBackground(display_, gc_, WhitePixel(display_, screen_));
-    XSetFunction(display_, gc_, GXcopy);
-    XSetPlaneMask(display_, gc_, AllPlanes);
-
-    // Initialize XRender for this window
-    if (has_xrender_) {
-        init_xrender();
-    }
-
-    // Initialize Xft
-    init_xft();
-
     return true;
 }
 
-bool Display::init_xrender() {
-    if (!has_xrender_ || !window_) {
-        return false;
-    }
-
-    pict_format_ = XRenderFindVisualFormat(display_, visual_);
-    if (!pict_format_) {
+bool Display::init_gc() {
+    gc_ = XCreateGC(display_, window_, 0, nullptr);
+    if (!gc_) {
         return false;
     }
 
-    XRenderPictureAttributes pa;
-    pa.subwindow_mode = IncludeInferiors;
-    picture_ = XRenderCreatePicture(display_, window_, pict_format_,
-                                     CPSubwindowMode, &pa);
-    return picture_ != 0;
+    // Initialize GC with known defaults to avoid server-defined surprises
+    XSetForeground(display_, gc_, black_pixel());
+    XSetBackground(display_, gc_, white_pixel());
+    XSetFunction(display_, gc_, GXcopy);
+    XSetPlaneMask(display_, gc_, AllPlanes);
+    return true;
 }
 
-bool Display::init_xft() {
-    if (!window_) {
-        return false;
+Picture Display::picture() {
+    if (!picture_ && pict_format_ && window_) {
+        XRenderPictureAttributes pa;
+        pa.subwindow_mode = IncludeInferiors;
+        picture_ = XRenderCreatePicture(display_, window_, pict_format_,
+                                        CPSubwindowMode, &pa);
     }
+    return picture_;
+}
 
-    xft_draw_ = XftDrawCreate(display_, window_, visual_, colormap_);
-    return xft_draw_ != nullptr;
+XftDraw* Display::xft_draw() {
+    if (!xft_draw_ && display_ && window_) {
+        std::lock_guard<std::mutex> lock(xft_mutex());
+        xft_draw_ = XftDrawCreate(display_, window_, visual_, colormap_);
+    }
+    return xft_draw_;
 }
 
-void Display::destroy_window() {
+void Display::release_targets() {
     if (xft_draw_) {
+        std::lock_guard<std::mutex> lock(xft_mutex());
         XftDrawDestroy(xft_draw_);
         xft_draw_ = nullptr;
     }
@@ -195,6 +454,15 @@ void Display::destroy_window() {
         XFreeGC(display_, gc_);
         gc_ = nullptr;
     }
+}
+
+void Display::destroy_window() {
+    // Tiles are destroyed along with their parent; offscreen pixmaps
+    // belong to the caller
+    use_tile(-1);
+    tiles_.clear();
+
+    release_targets();
     if (window_ && display_) {
         XDestroyWindow(display_, window_);
         window_ = 0;
@@ -203,6 +471,80 @@ void Display::destroy_window() {
     height_ = 0;
 }
 
+int Display::add_tile(int x, int y, uint32_t width, uint32_t height) {
+    if (!display_ || !window_ || tile_ >= 0) {
+        return -1;
+    }
+
+    XSetWindowAttributes attrs;
+    attrs.background_pixel = white_pixel();
+    attrs.event_mask = ExposureMask;
+    attrs.colormap = colormap_;
+    ::Window tile = XCreateWindow(display_, window_, x, y, width, height, 0, depth_,
+                                  InputOutput, visual_,
+                                  CWBackPixel | CWEventMask | CWColormap, &attrs);
+    if (!tile) {
+        return -1;
+    }
+    XMapWindow(display_, tile);
+
+    Target target;
+    target.window = tile;
+    target.width = width;
+    target.height = height;
+    tiles_.push_back(target);
+    return static_cast<int>(tiles_.size()) - 1;
+}
+
+int Display::add_offscreen(Pixmap pixmap, uint32_t width, uint32_t height) {
+    if (!display_ || !pixmap || tile_ >= 0) {
+        return -1;
+    }
+
+    Target target;
+    target.window = pixmap;
+    target.width = width;
+    target.height = height;
+    target.offscreen = true;
+    tiles_.push_back(target);
+    return static_cast<int>(tiles_.size()) - 1;
+}
+
+void Display::use_tile(int index) {
+    if (!display_ || index == tile_ || index >= static_cast<int>(tiles_.size())) {
+        return;
+    }
+
+    if (tile_ < 0) {
+        main_ = {window_, gc_, picture_, xft_draw_, width_, height_};
+        gc_ = nullptr;
+        picture_ = 0;
+        xft_draw_ = nullptr;
+    } else {
+        // A tile's GC and pictures never outlive its turn
+        release_targets();
+    }
+
+    if (index < 0) {
+        window_ = main_.window;
+        gc_ = main_.gc;
+        picture_ = main_.picture;
+        xft_draw_ = main_.xft_draw;
+        width_ = main_.width;
+        height_ = main_.height;
+        main_ = Target();
+        tile_ = -1;
+        return;
+    }
+
+    const Target& tile = tiles_[index];
+    window_ = tile.window;
+    width_ = tile.width;
+    height_ = tile.height;
+    init_gc();
+    tile_ = index;
+}
+
 void Display::show_window() {
     if (display_ && window_) {
         XMapWindow(display_, window_);
@@ -255,8 +597,8 @@ void Display::set_window_position(int x, int y, uint32_t width, uint32_t height)
     if (!display_) return 0;
 
     XSetWindowAttributes attrs;
-    attrs.background_pixel = WhitePixel(display_, screen_);
-    attrs.border_pixel = BlackPixel(display_, screen_);
+    attrs.background_pixel = white_pixel();
+    attrs.border_pixel = black_pixel();
     attrs.event_mask = ExposureMask | StructureNotifyMask;
     attrs.colormap = colormap_;
     attrs.override_redirect = False;
@@ -408,7 +750,7 @@ void Display::draw_arc(int x, int y, int width, int height, int angle1, int angl
 
 void Display::draw_text(XftFont* font, int x, int y, const std::string& text,
                         uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!xft_draw_ || !font) return;
+    if (!font || !xft_draw()) return;
 
     XftColor color;
     XRenderColor render_color;
@@ -417,15 +759,28 @@ void Display::draw_text(XftFont* font, int x, int y, const std::string& text,
     render_color.blue = b * 257;
     render_color.alpha = a * 257;
 
+    std::lock_guard<std::mutex> lock(xft_mutex());
     XftColorAllocValue(display_, visual_, colormap_, &render_color, &color);
     XftDrawStringUtf8(xft_draw_, &color, font, x, y,
                       reinterpret_cast<const FcChar8*>(text.c_str()), text.length());
     XftColorFree(display_, visual_, colormap_, &color);
 }
 
+void Display::set_text_clip(const XRectangle* rects, int n) {
+    // Nothing to unclip before the first text
+    if (n > 0 ? !xft_draw() : !xft_draw_) return;
+
+    std::lock_guard<std::mutex> lock(xft_mutex());
+    if (n > 0) {
+        XftDrawSetClipRectangles(xft_draw_, 0, 0, rects, n);
+    } else {
+        XftDrawSetClip(xft_draw_, nullptr);
+    }
+}
+
 void Display::render_fill_rectangle(int x, int y, int width, int height,
                                     uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
-    if (!has_xrender_ || !picture_) return;
+    if (!picture()) return;
 
     XRenderColor color;
     color.red = r * 257;
@@ -440,15 +795,36 @@ XftFont* Display::load_font(const std::string& font_name, int size) {
     if (!display_) return nullptr;
 
     std::string pattern = font_name + ":size=" + std::to_string(size);
-    return XftFontOpenName(display_, screen_, pattern.c_str());
+    std::lock_guard<std::mutex> lock(xft_mutex());
+
+    // Fontconfig loads its configuration and font cache on first use
+    static bool fontconfig_ready = false;
+    auto start = std::chrono::steady_clock::now();
+    XftFont* font = XftFontOpenName(display_, screen_, pattern.c_str());
+    if (!fontconfig_ready) {
+        fontconfig_ready = true;
+        StartupProfile::instance().add("fontconfig init", start);
+    }
+    return font;
 }
 
 void Display::free_font(XftFont* font) {
     if (display_ && font) {
+        std::lock_guard<std::mutex> lock(xft_mutex());
         XftFontClose(display_, font);
     }
 }
 
+int Display::text_width(XftFont* font, const std::string& text) {
+    if (!display_ || !font) return 0;
+
+    XGlyphInfo extents;
+    std::lock_guard<std::mutex> lock(xft_mutex());
+    XftTextExtentsUtf8(display_, font, reinterpret_cast<const FcChar8*>(text.c_str()),
+                       static_cast<int>(text.size()), &extents);
+    return extents.xOff;
+}
+
 void Display::flush() {
     if (display_) {
         XFlush(display_);
@@ -462,10 +838,20 @@ void Display::sync(bool discard) {
 }
 
 void Display::clear_window() {
-    if (display_ && window_) {
+    if (!display_ || !window_) {
+        return;
+    }
+    if (tile_ >= 0 && tiles_[tile_].offscreen) {
+        // Pixmaps have no background; paint the one a window would have
+        XGCValues values;
+        values.foreground = white_pixel();
+        GC gc = XCreateGC(display_, window_, GCForeground, &values);
+        XFillRectangle(display_, window_, gc, 0, 0, width_, height_);
+        XFreeGC(display_, gc);
+    } else {
         XClearWindow(display_, window_);
-        XSync(display_, False);
     }
+    XSync(display_, False);
 }
 
 bool Display::wait_for_expose(int timeout_ms) {
@@ -4,13 +4,33 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/Xrender.h>
 #include <X11/Xft/Xft.h>
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <functional>
+#include <vector>
 
 namespace x11bench {
 
+// A TrueColor visual the suite can render through
+struct VisualSpec {
+    VisualID id = 0;   // 0 selects the screen's default visual
+    int depth = 0;
+    std::string tag;   // Reference subdirectory; empty for plain 24-bit RGB
+};
+
+// An X protocol error, attributed to the context that issued the request
+struct XErrorRecord {
+    unsigned long serial = 0;
+    int error_code = 0;
+    int request_code = 0;
+    int minor_code = 0;
+    std::string context;   // Last mark() at or before the failing request
+};
+
 class Display {
 public:
     Display();
@@ -24,14 +44,17 @@ public:
     Display(Display&& other) noexcept;
     Display& operator=(Display&& other) noexcept;
 
-    // Connection
-    bool connect(const std::string& display_name = "");
+    // Connection. A non-zero visual_id renders through that visual (with its
+    // own colormap) instead of the screen default.
+    bool connect(const std::string& display_name = "", VisualID visual_id = 0);
     void disconnect();
     bool is_connected() const { return display_ != nullptr; }
 
     // Window management
+    // x/y place the window on the root so parallel runner lanes don't overlap
     bool create_window(uint32_t width, uint32_t height,
-                       const std::string& title = "x11bench");
+                       const std::string& title = "x11bench",
+                       int x = 0, int y = 0);
     void destroy_window();
     void show_window();
     void hide_window();
@@ -77,6 +100,19 @@ public:
     uint32_t window_width() const { return width_; }
     uint32_t window_height() const { return height_; }
 
+    // Atlas tiles: child windows of the window, mapped along with it.
+    // use_tile(i) retargets x_window(), gc(), picture(), xft_draw(), the
+    // window size and every drawing helper at tile i, with freshly created
+    // GC, Picture and XftDraw, so a test renders into the tile exactly as
+    // into a window of its own. use_tile(-1) returns to the window.
+    int add_tile(int x, int y, uint32_t width, uint32_t height);
+    void use_tile(int index);
+
+    // Offscreen target: a tile whose drawable is a caller-owned pixmap of the
+    // connection's depth (e.g. a ShmPixmap), usable without any window.
+    // clear_window() fills it white, like a fresh window's background.
+    int add_offscreen(Pixmap pixmap, uint32_t width, uint32_t height);
+
     // Graphics context for basic drawing
     GC gc() const { return gc_; }
 
@@ -88,15 +124,32 @@ public:
     Colormap colormap() const { return colormap_; }
     int depth() const { return depth_; }
 
-    // XRender support
+    // One TrueColor visual per depth offered by the screen, default first
+    std::vector<VisualSpec> truecolor_visuals() const;
+
+    // Reference subdirectory for a pixel format ("" for 24-bit RGB)
+    static std::string visual_tag(int depth);
+
+    // Extensions are queried once at connect; the window's Picture and
+    // XftDraw are only created when a test first asks for them, so tests
+    // that never touch XRender or Xft don't pay for either
     bool has_xrender() const { return has_xrender_; }
-    Picture picture() const { return picture_; }
+    Picture picture();
     XRenderPictFormat* pict_format() const { return pict_format_; }
 
-    // Xft font support
-    XftDraw* xft_draw() const { return xft_draw_; }
+    // MIT-SHM present and the server on this machine
+    bool has_shm() const { return has_shm_; }
+
+    // Xft font support. The first load_font() in the process initializes
+    // fontconfig.
+    XftDraw* xft_draw();
     XftFont* load_font(const std::string& font_name, int size);
     void free_font(XftFont* font);
+    // Horizontal advance of text in font, in pixels
+    int text_width(XftFont* font, const std::string& text);
+
+    // Clip for draw_text(); n == 0 removes the clip
+    void set_text_clip(const XRectangle* rects, int n);
 
     // Basic drawing operations (for convenience)
     void set_foreground(uint8_t r, uint8_t g, uint8_t b);
@@ -152,6 +205,24 @@ public:
     // Color allocation
     unsigned long alloc_color(uint8_t r, uint8_t g, uint8_t b);
 
+    // Asynchronous error attribution. Errors are collected by a process-wide
+    // handler as they arrive, without an XSync per call; each is attributed to
+    // the latest mark() whose first request serial precedes it.
+    void mark(const std::string& context);
+    std::vector<XErrorRecord> take_errors();
+    std::string describe_error(const XErrorRecord& error) const;
+
+    // Requests that may legitimately fail, e.g. XShmAttach against a server
+    // that can't reach the segment. Errors of requests issued between the
+    // two calls are dropped instead of collected; untrap_errors() syncs and
+    // returns true if there were none.
+    void trap_errors();
+    bool untrap_errors();
+
+    // True once the connection failed (e.g. shut down by the watchdog).
+    // Xlib calls on a broken connection return immediately.
+    bool has_io_error() const { return io_error_; }
+
 private:
     ::Display* display_ = nullptr;
     ::Window window_ = 0;
@@ -159,21 +230,54 @@ private:
     Visual* visual_ = nullptr;
     Colormap colormap_ = 0;
     int depth_ = 0;
+    bool own_colormap_ = false;
     GC gc_ = nullptr;
     uint32_t width_ = 0;
     uint32_t height_ = 0;
 
-    // XRender
+    // Extensions
     bool has_xrender_ = false;
+    bool has_shm_ = false;
     Picture picture_ = 0;
     XRenderPictFormat* pict_format_ = nullptr;
 
     // Xft
     XftDraw* xft_draw_ = nullptr;
 
+    // Atlas tiles; the window's own targets are parked in main_ while a
+    // tile is in use
+    struct Target {
+        ::Window window = 0;
+        GC gc = nullptr;
+        Picture picture = 0;
+        XftDraw* xft_draw = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool offscreen = false;  // A pixmap: never destroyed or exposed here
+    };
+    std::vector<Target> tiles_;
+    Target main_;
+    int tile_ = -1;
+
+    // Error attribution
+    std::mutex errors_mutex_;
+    std::deque<std::pair<unsigned long, std::string>> marks_;
+    std::vector<XErrorRecord> errors_;
+    bool trapping_ = false;
+    unsigned long trap_serial_ = 0;
+    int trapped_ = 0;
+    std::atomic<bool> io_error_{false};
+
+    static int handle_error(::Display* display, XErrorEvent* event);
+    static void handle_io_error_exit(::Display* display, void* user_data);
+    void register_connection();
+    void unregister_connection();
+
     void cleanup();
-    bool init_xrender();
-    bool init_xft();
+    unsigned long white_pixel();
+    unsigned long black_pixel();
+    bool init_gc();
+    void release_targets();
 };
 
 } // namespace x11bench
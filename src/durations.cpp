@@ -0,0 +1,68 @@
+#include "durations.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace x11bench {
+
+bool DurationHistory::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        double ms = 0.0;
+        if (fields >> name >> ms && ms > 0.0) {
+            durations_[name] = ms;
+        }
+    }
+    return true;
+}
+
+bool DurationHistory::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    out << std::fixed << std::setprecision(1);
+    for (const auto& [name, ms] : durations_) {
+        out << name << " " << ms << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+double DurationHistory::get(const std::string& name, double fallback_ms) const {
+    auto it = durations_.find(name);
+    return it != durations_.end() ? it->second : fallback_ms;
+}
+
+void DurationHistory::record(const std::string& name, double duration_ms) {
+    if (duration_ms <= 0.0) {
+        return;
+    }
+    auto it = durations_.find(name);
+    if (it == durations_.end()) {
+        durations_[name] = duration_ms;
+    } else {
+        it->second = 0.5 * it->second + 0.5 * duration_ms;
+    }
+}
+
+double DurationHistory::mean(double fallback_ms) const {
+    if (durations_.empty()) {
+        return fallback_ms;
+    }
+    double total = 0.0;
+    for (const auto& entry : durations_) {
+        total += entry.second;
+    }
+    return total / durations_.size();
+}
+
+} // namespace x11bench
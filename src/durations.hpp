@@ -0,0 +1,31 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+namespace x11bench {
+
+// Per-test wall times from previous runs, used to schedule the longest tests
+// first. Stored as "name milliseconds" lines; new samples are blended with
+// the stored value so one noisy run doesn't reorder the whole suite.
+class DurationHistory {
+public:
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // Recorded duration, or fallback_ms when the test has no history
+    double get(const std::string& name, double fallback_ms) const;
+
+    // Blend a new sample into the history
+    void record(const std::string& name, double duration_ms);
+
+    // Mean of all recorded durations (fallback_ms when empty)
+    double mean(double fallback_ms) const;
+
+    bool empty() const { return durations_.empty(); }
+
+private:
+    std::map<std::string, double> durations_;
+};
+
+} // namespace x11bench
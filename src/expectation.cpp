@@ -0,0 +1,144 @@
+#include "expectation.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace x11bench {
+
+Expectation& Expectation::fill(int x, int y, int width, int height,
+                               uint8_t r, uint8_t g, uint8_t b) {
+    regions_.push_back({x, y, width, height, {r, g, b, 255}, false});
+    return *this;
+}
+
+Expectation& Expectation::outline(int x, int y, int width, int height,
+                                  uint8_t r, uint8_t g, uint8_t b) {
+    fill(x, y, width + 1, 1, r, g, b);
+    fill(x, y + height, width + 1, 1, r, g, b);
+    fill(x, y, 1, height + 1, r, g, b);
+    fill(x + width, y, 1, height + 1, r, g, b);
+    return *this;
+}
+
+Expectation& Expectation::ignore(int x, int y, int width, int height) {
+    regions_.push_back({x, y, width, height, {0, 0, 0, 0}, true});
+    return *this;
+}
+
+std::vector<uint32_t> Expectation::owners(uint32_t width, uint32_t height) const {
+    std::vector<uint32_t> owner(static_cast<size_t>(width) * height, 0);
+    for (size_t i = 0; i < regions_.size(); i++) {
+        const ExpectedRegion& region = regions_[i];
+        int x0 = std::max(region.x, 0);
+        int y0 = std::max(region.y, 0);
+        int x1 = std::min<int64_t>(int64_t(region.x) + region.width, width);
+        int y1 = std::min<int64_t>(int64_t(region.y) + region.height, height);
+        for (int y = y0; y < y1; y++) {
+            std::fill(owner.begin() + size_t(y) * width + x0,
+                      owner.begin() + size_t(y) * width + std::max(x0, x1),
+                      static_cast<uint32_t>(i + 1));
+        }
+    }
+    return owner;
+}
+
+CompareResult Expectation::check(const Image& captured, int tolerance) const {
+    CompareResult result;
+    uint32_t width = captured.width();
+    uint32_t height = captured.height();
+    result.total_pixels = width * height;
+
+    std::vector<uint32_t> owner = owners(width, height);
+    uint64_t total_diff = 0;
+    uint64_t checked = 0;
+    int first_x = -1, first_y = -1;
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = captured.data() + y * captured.stride();
+        const uint32_t* row_owner = owner.data() + size_t(y) * width;
+
+        uint32_t x = 0;
+        while (x < width) {
+            // One run of pixels owned by the same region
+            uint32_t id = row_owner[x];
+            uint32_t end = x + 1;
+            while (end < width && row_owner[end] == id) {
+                end++;
+            }
+            if (id == 0 || regions_[id - 1].dont_care) {
+                x = end;
+                continue;
+            }
+
+            const Pixel& color = regions_[id - 1].color;
+            checked += end - x;
+
+            // Exact compare first; most runs match and take no more
+            uint32_t mismatched = 0;
+            for (uint32_t i = x; i < end; i++) {
+                const uint8_t* p = row + i * 4;
+                mismatched += p[0] != color.r || p[1] != color.g || p[2] != color.b;
+            }
+
+            if (mismatched > 0) {
+                for (uint32_t i = x; i < end; i++) {
+                    const uint8_t* p = row + i * 4;
+                    int dr = std::abs(int(p[0]) - color.r);
+                    int dg = std::abs(int(p[1]) - color.g);
+                    int db = std::abs(int(p[2]) - color.b);
+                    int max_diff = std::max({dr, dg, db});
+                    total_diff += dr + dg + db;
+                    result.max_channel_diff = std::max(result.max_channel_diff,
+                                                       static_cast<double>(max_diff));
+                    if (max_diff > tolerance) {
+                        if (result.different_pixels == 0) {
+                            first_x = static_cast<int>(i);
+                            first_y = static_cast<int>(y);
+                        }
+                        result.different_pixels++;
+                    }
+                }
+            }
+            x = end;
+        }
+    }
+
+    result.avg_channel_diff = checked > 0 ? double(total_diff) / (3.0 * checked) : 0.0;
+    result.difference_percent = result.total_pixels > 0 ?
+        (100.0 * result.different_pixels / result.total_pixels) : 0.0;
+    result.match = (result.different_pixels == 0);
+
+    std::ostringstream oss;
+    if (result.match) {
+        oss << "Matches expectation";
+        if (tolerance > 0) {
+            oss << " (within tolerance " << tolerance << ")";
+        }
+    } else {
+        oss << result.different_pixels << " pixels differ from expectation ("
+            << std::fixed << result.difference_percent << "%), "
+            << "max channel diff: " << result.max_channel_diff
+            << ", first at (" << first_x << ", " << first_y << ")";
+    }
+    result.message = oss.str();
+    return result;
+}
+
+Image Expectation::render(const Image& captured) const {
+    Image image = captured;
+    std::vector<uint32_t> owner = owners(image.width(), image.height());
+    for (uint32_t y = 0; y < image.height(); y++) {
+        for (uint32_t x = 0; x < image.width(); x++) {
+            uint32_t id = owner[size_t(y) * image.width() + x];
+            if (id != 0 && !regions_[id - 1].dont_care) {
+                Pixel color = regions_[id - 1].color;
+                color.a = captured.get_pixel(x, y).a;
+                image.set_pixel(x, y, color);
+            }
+        }
+    }
+    return image;
+}
+
+} // namespace x11bench
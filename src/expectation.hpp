@@ -0,0 +1,55 @@
+#pragma once
+
+#include "compare.hpp"
+#include "image.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace x11bench {
+
+// One region of an analytic expectation: every pixel of the rectangle has
+// `color`, or may be anything when `dont_care` is set
+struct ExpectedRegion {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    Pixel color = {0, 0, 0, 255};
+    bool dont_care = false;
+};
+
+// A reference described as geometry instead of a PNG: regions painted in
+// order, later ones over earlier ones, on a canvas of whatever size the
+// capture has. Pixels no region covers are not checked, and neither is alpha,
+// so the same spec holds on every visual.
+class Expectation {
+public:
+    Expectation& fill(int x, int y, int width, int height, uint8_t r, uint8_t g, uint8_t b);
+
+    // The pixels a zero-width XDrawRectangle(x, y, width, height) touches:
+    // the outline of the (width + 1) x (height + 1) box
+    Expectation& outline(int x, int y, int width, int height, uint8_t r, uint8_t g, uint8_t b);
+
+    Expectation& ignore(int x, int y, int width, int height);
+
+    bool empty() const { return regions_.empty(); }
+    const std::vector<ExpectedRegion>& regions() const { return regions_; }
+
+    // Check a capture against the spec, counting pixels with an RGB channel
+    // more than `tolerance` off. Each run of pixels with the same expected
+    // color is compared channel by channel, with no PNG to decode.
+    CompareResult check(const Image& captured, int tolerance) const;
+
+    // The spec as an image; unchecked pixels are copied from `captured`, so
+    // a diff against it shows only real mismatches
+    Image render(const Image& captured) const;
+
+private:
+    std::vector<ExpectedRegion> regions_;
+
+    // Index + 1 of the region owning each pixel, 0 where none does
+    std::vector<uint32_t> owners(uint32_t width, uint32_t height) const;
+};
+
+} // namespace x11bench
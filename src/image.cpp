@@ -1,5 +1,6 @@
 #include "image.hpp"
 #include <png.h>
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
@@ -75,6 +76,101 @@ void Image::fill(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
     fill(Pixel{r, g, b, a});
 }
 
+uint64_t Image::pixel_hash() const {
+    // FNV-1a over 64-bit words, seeded with the dimensions
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = (hash ^ width_) * prime;
+    hash = (hash ^ height_) * prime;
+
+    size_t words = data_.size() / 8;
+    const uint8_t* bytes = data_.data();
+    for (size_t i = 0; i < words; i++) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+    for (size_t i = words * 8; i < data_.size(); i++) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return hash;
+}
+
+Image Image::crop(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const {
+    x = std::min(x, width_);
+    y = std::min(y, height_);
+    w = std::min(w, width_ - x);
+    h = std::min(h, height_ - y);
+
+    Image out(w, h);
+    for (uint32_t row = 0; row < h; row++) {
+        std::memcpy(out.data() + row * out.stride(), data_.data() + (y + row) * stride() + x * 4,
+                    static_cast<size_t>(w) * 4);
+    }
+    return out;
+}
+
+std::vector<uint64_t> Image::tile_hashes(uint32_t tile) const {
+    const uint64_t prime = 0x100000001b3ULL;
+    const uint64_t lane_seed = 0x9e3779b97f4a7c15ULL;
+    uint32_t columns = (width_ + tile - 1) / tile;
+    uint32_t rows = (height_ + tile - 1) / tile;
+    std::vector<uint64_t> hashes(static_cast<size_t>(columns) * rows);
+
+    // Four independent accumulators per tile: consecutive words go to
+    // different lanes, so the multiplies don't form one serial chain and the
+    // inner loop can be vectorized
+    std::vector<uint64_t> lanes(static_cast<size_t>(columns) * 4);
+    for (uint32_t ty = 0; ty < rows; ty++) {
+        for (size_t i = 0; i < lanes.size(); i++) {
+            lanes[i] = 0xcbf29ce484222325ULL ^ (lane_seed * (i % 4 + 1));
+        }
+
+        uint32_t y_end = std::min(height_, (ty + 1) * tile);
+        for (uint32_t y = ty * tile; y < y_end; y++) {
+            const uint8_t* row = data_.data() + y * stride();
+            for (uint32_t tx = 0; tx < columns; tx++) {
+                const uint8_t* bytes = row + static_cast<size_t>(tx) * tile * 4;
+                size_t length = static_cast<size_t>(std::min(tile, width_ - tx * tile)) * 4;
+                uint64_t* lane = &lanes[tx * 4];
+
+                size_t words = length / 8;
+                size_t i = 0;
+                for (; i + 4 <= words; i += 4) {
+                    for (int k = 0; k < 4; k++) {
+                        uint64_t word;
+                        std::memcpy(&word, bytes + (i + k) * 8, sizeof(word));
+                        lane[k] = ((lane[k] << 23 | lane[k] >> 41) ^ word) * prime;
+                    }
+                }
+                for (; i < words; i++) {
+                    uint64_t word;
+                    std::memcpy(&word, bytes + i * 8, sizeof(word));
+                    lane[0] = ((lane[0] << 23 | lane[0] >> 41) ^ word) * prime;
+                }
+                if (length % 8) {
+                    uint32_t word;
+                    std::memcpy(&word, bytes + words * 8, sizeof(word));
+                    lane[1] = ((lane[1] << 23 | lane[1] >> 41) ^ word) * prime;
+                }
+            }
+        }
+
+        for (uint32_t tx = 0; tx < columns; tx++) {
+            const uint64_t* lane = &lanes[tx * 4];
+            uint64_t hash = (static_cast<uint64_t>(tx) << 32 | ty) * prime;
+            for (int k = 0; k < 4; k++) {
+                hash = (hash ^ lane[k]) * prime;
+                hash ^= hash >> 29;
+            }
+            hashes[static_cast<size_t>(ty) * columns + tx] = hash;
+        }
+    }
+    return hashes;
+}
+
 bool Image::save_png(const std::string& filename) const {
     FILE* fp = fopen(filename.c_str(), "wb");
     if (!fp) {
@@ -49,6 +49,16 @@ public:
     size_t stride() const { return width_ * 4; }
     size_t size() const { return data_.size(); }
 
+    // Copy of the w x h rectangle at (x, y), clipped to the image
+    Image crop(uint32_t x, uint32_t y, uint32_t w, uint32_t h) const;
+
+    // 64-bit hash of dimensions and pixel data; equal images hash equal
+    uint64_t pixel_hash() const;
+
+    // One 64-bit hash per tile x tile block (edge tiles are smaller),
+    // row-major. Equal tiles hash equal, so matching grids localize changes.
+    std::vector<uint64_t> tile_hashes(uint32_t tile) const;
+
     // PNG I/O
     bool save_png(const std::string& filename) const;
     bool load_png(const std::string& filename);
@@ -1,37 +1,41 @@
-#include "display.hpp"
-#include "image.hpp"
-#include "capture.hpp"
-#include "compare.hpp"
+#include "bench/bench_runner.hpp"
+#include "bench/soak.hpp"
+#include "dir_compare.hpp"
+#include "durations.hpp"
+#include "profile.hpp"
+#include "runner.hpp"
+#include "server.hpp"
+#include "trace.hpp"
 #include "tests/test_base.hpp"
 
 #include <iostream>
-#include <iomanip>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
 #include <filesystem>
 #include <algorithm>
-#include <chrono>
-#include <thread>
+#include <cctype>
+#include <memory>
 
 namespace fs = std::filesystem;
 
-// ANSI color codes
-#define COLOR_RED     "\033[31m"
-#define COLOR_GREEN   "\033[32m"
-#define COLOR_YELLOW  "\033[33m"
-#define COLOR_BLUE    "\033[34m"
-#define COLOR_RESET   "\033[0m"
-#define COLOR_BOLD    "\033[1m"
-
 struct Options {
-    bool regenerate = false;
-    bool verbose = false;
     bool list_only = false;
-    bool save_failures = false;
-    std::string reference_dir = "reference";
     std::string filter;
+    std::string durations_file = ".x11bench-durations";
+    x11bench::RunnerOptions run;
+    bool managed_server = false;
+    x11bench::ServerOptions server;
+    bool all_visuals = false;
+    bool startup_profile = false;
+};
+
+// One pass of the suite: a screen and a visual on it
+struct MatrixEntry {
     std::string display_name;
+    x11bench::VisualSpec visual;
+    bool screen_default = true;  // The root window has this visual's depth
 };
 
 void print_usage(const char* program) {
@@ -43,13 +47,41 @@ void print_usage(const char* program) {
               << "  -v, --verbose        Verbose output\n"
               << "  -f, --filter PATTERN Run only tests matching pattern\n"
               << "  -d, --display NAME   X11 display to connect to\n"
+              << "  -j, --jobs N         Run tests on N parallel X connections (default: 1)\n"
               << "  --ref-dir DIR        Directory for reference images (default: reference)\n"
+              << "  --variant TAG        Reference variant --regenerate writes (TEST~TAG.png)\n"
               << "  --save-failures      Save captured images on test failures\n"
+              << "  --timeout MS         Per-test wall time limit, 0 to disable (default: 30000)\n"
+              << "  --settle MS          Wait after rendering before capture (default: 50)\n"
+              << "  --atlas              Pack tests into tiles of one window per lane, capture once\n"
+              << "  --offscreen          Render into MIT-SHM pixmaps and read pixels in place\n"
+              << "  --durations FILE     Test duration history for scheduling (default: .x11bench-durations)\n"
+              << "  --tiles FILE         Reference tile hash cache (default: .x11bench-tiles)\n"
+              << "  --visuals all        Run the suite through every TrueColor depth the server offers\n"
+              << "  --startup-profile    Break down the time to the first test by startup phase\n"
+              << "\nManaged server:\n"
+              << "  --server PROGRAM     Launch and own a headless server (Xvfb, Xephyr, Xvnc)\n"
+              << "  --screen WxHxD       Screen geometry and depth (default: 1024x768x24)\n"
+              << "  --depths LIST        Xvfb with one screen per depth, e.g. 16,24,30\n"
+              << "  --reuse-server       Reuse a warm server from the lease file, keep it running\n"
+              << "  --lease-file PATH    Lease file (default: per configuration in $XDG_RUNTIME_DIR)\n"
+              << "\nSubcommands:\n"
+              << "  record [options] [-- COMMAND...]  Record a client's requests through a proxy display\n"
+              << "  replay [options] FILE             Replay a recorded trace and time it\n"
+              << "  bench [options]                   Run the timed workload benchmarks\n"
+              << "  compare [options] DIR_A DIR_B     Compare image trees offline, no X needed\n"
+              << "  soak [options]                    Run a mixed workload for hours, watch for decay\n"
+              << "  (run '" << program << " record --help' for details)\n"
               << std::endl;
 }
 
 Options parse_args(int argc, char* argv[]) {
     Options opts;
+#ifndef HAVE_XSETIOERROREXITHANDLER
+    // Without XSetIOErrorExitHandler a connection the watchdog shuts down
+    // exit()s the whole process, so there is no watchdog by default
+    opts.run.timeout_ms = 0;
+#endif
 
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -60,17 +92,86 @@ Options parse_args(int argc, char* argv[]) {
         } else if (arg == "-l" || arg == "--list") {
             opts.list_only = true;
         } else if (arg == "-r" || arg == "--regenerate") {
-            opts.regenerate = true;
+            opts.run.regenerate = true;
         } else if (arg == "-v" || arg == "--verbose") {
-            opts.verbose = true;
+            opts.run.verbose = true;
         } else if (arg == "--save-failures") {
-            opts.save_failures = true;
+            opts.run.save_failures = true;
         } else if ((arg == "-f" || arg == "--filter") && i + 1 < argc) {
             opts.filter = argv[++i];
         } else if ((arg == "-d" || arg == "--display") && i + 1 < argc) {
-            opts.display_name = argv[++i];
+            opts.run.display_name = argv[++i];
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            int jobs = std::atoi(argv[++i]);
+            opts.run.jobs = jobs > 0 ? static_cast<unsigned>(jobs) : 1;
         } else if (arg == "--ref-dir" && i + 1 < argc) {
-            opts.reference_dir = argv[++i];
+            opts.run.reference_dir = argv[++i];
+        } else if (arg == "--variant" && i + 1 < argc) {
+            opts.run.variant = argv[++i];
+            // Tags become file names and manifest keys
+            bool valid = !opts.run.variant.empty() &&
+                std::all_of(opts.run.variant.begin(), opts.run.variant.end(), [](char c) {
+                    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' ||
+                           c == '.';
+                });
+            if (!valid) {
+                std::cerr << "Invalid variant tag: " << opts.run.variant << std::endl;
+                exit(1);
+            }
+        } else if (arg == "--server" && i + 1 < argc) {
+            opts.managed_server = true;
+            opts.server.program = argv[++i];
+        } else if (arg == "--screen" && i + 1 < argc) {
+            if (!x11bench::XServer::parse_screen(argv[++i], opts.server)) {
+                std::cerr << "Invalid screen spec: " << argv[i] << std::endl;
+                exit(1);
+            }
+        } else if (arg == "--timeout" && i + 1 < argc) {
+            opts.run.timeout_ms = std::max(0, std::atoi(argv[++i]));
+#ifndef HAVE_XSETIOERROREXITHANDLER
+            if (opts.run.timeout_ms > 0) {
+                std::cerr << "--timeout needs libX11 1.7 or newer (XSetIOErrorExitHandler); "
+                          << "this build can only run with --timeout 0" << std::endl;
+                exit(1);
+            }
+#endif
+        } else if (arg == "--settle" && i + 1 < argc) {
+            opts.run.settle_ms = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--atlas") {
+            opts.run.atlas = true;
+        } else if (arg == "--offscreen") {
+            opts.run.offscreen = true;
+        } else if (arg == "--startup-profile") {
+            opts.startup_profile = true;
+        } else if (arg == "--durations" && i + 1 < argc) {
+            opts.durations_file = argv[++i];
+        } else if (arg == "--tiles" && i + 1 < argc) {
+            opts.run.tiles_file = argv[++i];
+        } else if (arg == "--visuals" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode != "all" && mode != "default") {
+                std::cerr << "Invalid visuals mode: " << mode << std::endl;
+                exit(1);
+            }
+            opts.all_visuals = (mode == "all");
+        } else if (arg == "--depths" && i + 1 < argc) {
+            opts.managed_server = true;
+            std::string list = argv[++i];
+            size_t pos = 0;
+            while (pos <= list.size()) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                int depth = std::atoi(list.substr(pos, comma - pos).c_str());
+                if (depth > 0) {
+                    opts.server.screen_depths.push_back(depth);
+                }
+                pos = comma + 1;
+            }
+        } else if (arg == "--reuse-server") {
+            opts.managed_server = true;
+            opts.server.reuse = true;
+        } else if (arg == "--lease-file" && i + 1 < argc) {
+            opts.server.lease_file = argv[++i];
         } else {
             std::cerr << "Unknown option: " << arg << std::endl;
             print_usage(argv[0]);
@@ -78,214 +179,519 @@ Options parse_args(int argc, char* argv[]) {
         }
     }
 
+    if (!opts.server.screen_depths.empty() && opts.server.program != "Xvfb") {
+        std::cerr << "--depths needs Xvfb (one screen per depth)" << std::endl;
+        exit(1);
+    }
+
     return opts;
 }
 
+// Expand the requested screens and visuals into suite passes. Formats are
+// deduplicated by reference tag so each pixel format runs once.
+std::vector<MatrixEntry> build_matrix(const Options& opts, int screens) {
+    std::vector<MatrixEntry> matrix;
+    bool expand = opts.all_visuals || screens > 1;
+    if (!expand) {
+        matrix.push_back({opts.run.display_name, x11bench::VisualSpec{}});
+        return matrix;
+    }
+
+    std::string base = opts.run.display_name;
+    std::vector<std::string> seen;
+    for (int screen = 0; screen < screens; screen++) {
+        std::string name = screens > 1 ? base + "." + std::to_string(screen) : base;
+
+        x11bench::Display probe;
+        if (!probe.connect(name)) {
+            std::cerr << "Failed to connect to X display " << name << std::endl;
+            continue;
+        }
+
+        auto visuals = probe.truecolor_visuals();
+        if (!opts.all_visuals) {
+            visuals.resize(1);  // Screen default only
+        }
+        for (size_t i = 0; i < visuals.size(); i++) {
+            const auto& visual = visuals[i];
+            if (std::find(seen.begin(), seen.end(), visual.tag) != seen.end()) {
+                continue;
+            }
+            seen.push_back(visual.tag);
+            matrix.push_back({name, visual, i == 0});
+        }
+    }
+    return matrix;
+}
+
 bool matches_filter(const std::string& name, const std::string& filter) {
     if (filter.empty()) return true;
     return name.find(filter) != std::string::npos;
 }
 
-int main(int argc, char* argv[]) {
-    Options opts = parse_args(argc, argv);
-
-    auto& tests = x11bench::get_test_registry();
-
-    if (tests.empty()) {
-        std::cerr << "No tests registered!" << std::endl;
-        return 1;
+int run_bench(int argc, char* argv[]) {
+    x11bench::BenchOptions options;
+    std::string filter;
+    bool list_only = false;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " bench [options]\n"
+                      << "\nOptions:\n"
+                      << "  -l, --list           List all benchmarks\n"
+                      << "  -f, --filter PATTERN Run only benchmarks matching pattern\n"
+                      << "  -d, --display NAME   X11 display to connect to\n"
+                      << "  -n, --iterations N   Steps per benchmark (default: per benchmark)\n"
+                      << "  -v, --verbose        Verbose output\n"
+                      << "  --save-failures      Save final and expected frames on mismatch\n";
+            return 0;
+        } else if (arg == "-l" || arg == "--list") {
+            list_only = true;
+        } else if ((arg == "-f" || arg == "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if ((arg == "-d" || arg == "--display") && i + 1 < argc) {
+            options.display_name = argv[++i];
+        } else if ((arg == "-n" || arg == "--iterations") && i + 1 < argc) {
+            options.iterations = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg == "--save-failures") {
+            options.save_failures = true;
+        } else {
+            std::cerr << "Unknown bench option: " << arg << std::endl;
+            return 1;
+        }
     }
 
-    // Sort tests by name, but put window tests (win_*) at the end
-    // Window tests create/destroy many windows which can cause compositor lag
-    std::sort(tests.begin(), tests.end(),
-              [](const x11bench::TestInfo& a, const x11bench::TestInfo& b) {
-                  auto ta = a.factory();
-                  auto tb = b.factory();
-                  std::string na = ta->name();
-                  std::string nb = tb->name();
-                  bool a_is_win = na.substr(0, 4) == "win_";
-                  bool b_is_win = nb.substr(0, 4) == "win_";
-                  if (a_is_win != b_is_win) return b_is_win;  // non-win before win
-                  return na < nb;
+    std::vector<x11bench::BenchInfo> selected;
+    for (const auto& info : x11bench::get_bench_registry()) {
+        if (matches_filter(info.factory()->name(), filter)) {
+            selected.push_back(info);
+        }
+    }
+    std::sort(selected.begin(), selected.end(),
+              [](const x11bench::BenchInfo& a, const x11bench::BenchInfo& b) {
+                  return a.factory()->name() < b.factory()->name();
               });
 
-    // List tests if requested
-    if (opts.list_only) {
-        std::cout << "Available tests (" << tests.size() << "):\n";
-        for (const auto& test_info : tests) {
-            auto test = test_info.factory();
-            std::cout << "  " << test->name() << " - " << test->description() << "\n";
+    if (list_only) {
+        std::cout << "Available benchmarks (" << selected.size() << "):\n";
+        for (const auto& info : selected) {
+            auto bench = info.factory();
+            std::cout << "  " << bench->name() << " - " << bench->description() << "\n";
         }
         return 0;
     }
 
-    // Create reference directory if needed
-    if (!fs::exists(opts.reference_dir)) {
-        fs::create_directories(opts.reference_dir);
+    // Xlib must be told before the first call when a benchmark shares a
+    // connection between threads
+    if (std::any_of(selected.begin(), selected.end(),
+                    [](const x11bench::BenchInfo& info) {
+                        return info.factory()->needs_threads();
+                    })) {
+        XInitThreads();
     }
 
-    // Connect to X display
-    x11bench::Display display;
-    if (!display.connect(opts.display_name)) {
-        std::cerr << "Failed to connect to X display" << std::endl;
+    x11bench::BenchRunner runner(options);
+    if (!runner.run(selected)) {
         return 1;
     }
+    bool any_failed = std::any_of(runner.results().begin(), runner.results().end(),
+                                  [](const x11bench::BenchResult& r) { return r.failed; });
+    return any_failed ? 1 : 0;
+}
 
-    if (opts.verbose) {
-        std::cout << "Connected to X display\n";
-        std::cout << "XRender support: " << (display.has_xrender() ? "yes" : "no") << "\n";
+int run_compare(int argc, char* argv[]) {
+    x11bench::DirCompareOptions options;
+    std::vector<std::string> dirs;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " compare [options] DIR_A DIR_B\n"
+                      << "       " << argv[0] << " compare [options] --pairs FILE\n"
+                      << "\nPairs PNGs by relative path (A expected, B actual) and compares\n"
+                      << "them with each registered test's tolerances.\n"
+                      << "\nOptions:\n"
+                      << "  --pairs FILE         Compare the pairs listed as 'A B [NAME]' lines\n"
+                      << "  -j, --jobs N         Compare threads (default: all cores)\n"
+                      << "  --tolerance N        Per-channel tolerance for every image\n"
+                      << "  --report FILE        Write a JSON report\n"
+                      << "  --diff-dir DIR       Save diff images of failures\n"
+                      << "  -v, --verbose        Verbose output\n";
+            return 0;
+        } else if (arg == "--pairs" && i + 1 < argc) {
+            options.pairs_file = argv[++i];
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            options.jobs = static_cast<unsigned>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            options.tolerance = std::min(255, std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--report" && i + 1 < argc) {
+            options.report_path = argv[++i];
+        } else if (arg == "--diff-dir" && i + 1 < argc) {
+            options.diff_dir = argv[++i];
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg[0] != '-') {
+            dirs.push_back(arg);
+        } else {
+            std::cerr << "Unknown compare option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (options.pairs_file.empty() ? dirs.size() != 2 : !dirs.empty()) {
+        std::cerr << "compare needs DIR_A DIR_B or --pairs FILE" << std::endl;
+        return 1;
+    }
+    if (dirs.size() == 2) {
+        options.dir_a = dirs[0];
+        options.dir_b = dirs[1];
     }
 
-    // Run tests
-    int passed = 0;
-    int failed = 0;
-    int skipped = 0;
+    x11bench::DirCompare compare(options);
+    if (!compare.run()) {
+        std::cerr << "compare: " << compare.error() << std::endl;
+        return 1;
+    }
+    x11bench::Runner::print_summary(compare.results(), 0);
+    bool any_failed = std::any_of(compare.results().begin(), compare.results().end(),
+                                  [](const x11bench::TestResult& r) {
+                                      return x11bench::is_failure(r.status);
+                                  });
+    return any_failed ? 1 : 0;
+}
 
-    std::cout << "\n" << COLOR_BOLD << "Running X11 visual tests" << COLOR_RESET << "\n";
-    std::cout << std::string(60, '=') << "\n\n";
+// "90", "90s", "15m" or "6h" in seconds; negative if malformed
+double parse_duration(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    std::string unit = end ? end : "";
+    if (end == text.c_str() || value <= 0) return -1;
+    if (unit.empty() || unit == "s") return value;
+    if (unit == "m") return value * 60;
+    if (unit == "h") return value * 3600;
+    return -1;
+}
 
-    for (const auto& test_info : tests) {
-        auto test = test_info.factory();
+int run_soak(int argc, char* argv[]) {
+    x11bench::SoakOptions options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " soak [options]\n"
+                      << "\nOptions:\n"
+                      << "  -d, --display NAME   X11 display to connect to\n"
+                      << "  --duration TIME      Total run time, e.g. 90s, 30m, 8h (default: 1h)\n"
+                      << "  --interval TIME      Time between samples (default: 10s)\n"
+                      << "  --csv FILE           Write every sample as CSV\n"
+                      << "  -v, --verbose        Verbose output\n";
+            return 0;
+        } else if ((arg == "-d" || arg == "--display") && i + 1 < argc) {
+            options.display_name = argv[++i];
+        } else if ((arg == "--duration" || arg == "--interval") && i + 1 < argc) {
+            double seconds = parse_duration(argv[++i]);
+            if (seconds <= 0) {
+                std::cerr << "Invalid time: " << argv[i] << std::endl;
+                return 1;
+            }
+            (arg == "--duration" ? options.duration_s : options.interval_s) = seconds;
+        } else if (arg == "--csv" && i + 1 < argc) {
+            options.csv_path = argv[++i];
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.verbose = true;
+        } else {
+            std::cerr << "Unknown soak option: " << arg << std::endl;
+            return 1;
+        }
+    }
 
-        if (!matches_filter(test->name(), opts.filter)) {
-            skipped++;
-            continue;
+    x11bench::SoakRunner runner(options);
+    if (!runner.run()) {
+        return 1;
+    }
+    return runner.problems().empty() ? 0 : 1;
+}
+
+int run_record(int argc, char* argv[]) {
+    x11bench::RecordOptions options;
+    int i = 2;
+    for (; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " record [options] [-- COMMAND...]\n"
+                      << "\nProxy one client to the real server and record its requests.\n"
+                      << "\nOptions:\n"
+                      << "  -d, --display NAME   Upstream server (default: $DISPLAY)\n"
+                      << "  --listen N           Proxy display number (default: 9)\n"
+                      << "  -o, --output FILE    Trace file (default: trace.x11t)\n"
+                      << "\nWithout COMMAND, waits for a client to connect to the proxy display.\n";
+            return 0;
+        } else if ((arg == "-d" || arg == "--display") && i + 1 < argc) {
+            options.upstream_display = argv[++i];
+        } else if (arg == "--listen" && i + 1 < argc) {
+            options.listen_display = std::atoi(argv[++i]);
+        } else if ((arg == "-o" || arg == "--output") && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--") {
+            i++;
+            break;
+        } else {
+            std::cerr << "Unknown record option: " << arg << std::endl;
+            return 1;
         }
-        std::string ref_path = opts.reference_dir + "/" + test->name() + ".png";
+    }
+    for (; i < argc; i++) {
+        options.command.push_back(argv[i]);
+    }
 
-        std::cout << std::left << std::setw(35) << test->name() << " ";
-        std::cout.flush();
+    if (options.command.empty()) {
+        std::cout << "Waiting for a client on :" << options.listen_display << std::endl;
+    }
+    x11bench::TraceRecorder recorder(options);
+    if (!recorder.run()) {
+        std::cerr << "Recording failed: " << recorder.error() << std::endl;
+        return 1;
+    }
+    std::cout << "Recorded " << recorder.trace().requests.size() << " requests ("
+              << recorder.trace().extensions.size() << " extensions) to "
+              << options.output << std::endl;
+    return 0;
+}
 
-        // Create window for this test
-        display.destroy_window();
-        if (!display.create_window(test->width(), test->height(), "x11bench - " + test->name())) {
-            std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " Failed to create window\n";
-            failed++;
-            continue;
+int run_replay(int argc, char* argv[]) {
+    x11bench::ReplayOptions options;
+    std::string path;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            std::cout << "Usage: " << argv[0] << " replay [options] FILE\n"
+                      << "\nOptions:\n"
+                      << "  -d, --display NAME   X11 display to replay against\n"
+                      << "  --realtime           Keep the recorded gaps between requests\n"
+                      << "  --per-request        Round-trip after each request and time it by type\n"
+                      << "  --loops N            Replay the trace N times (default: 1)\n";
+            return 0;
+        } else if ((arg == "-d" || arg == "--display") && i + 1 < argc) {
+            options.display_name = argv[++i];
+        } else if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--per-request") {
+            options.per_request = true;
+        } else if (arg == "--loops" && i + 1 < argc) {
+            options.loops = std::max(1, std::atoi(argv[++i]));
+        } else if (path.empty() && arg[0] != '-') {
+            path = arg;
+        } else {
+            std::cerr << "Unknown replay option: " << arg << std::endl;
+            return 1;
         }
+    }
+    if (path.empty()) {
+        std::cerr << "replay needs a trace file" << std::endl;
+        return 1;
+    }
 
-        display.show_window();
+    x11bench::Trace trace;
+    if (!trace.load(path)) {
+        std::cerr << "Cannot read trace " << path << std::endl;
+        return 1;
+    }
 
-        // Wait for the window to be mapped and exposed
-        if (!display.wait_for_expose(2000)) {
-            if (opts.verbose) {
-                std::cout << COLOR_YELLOW << "[WARN]" << COLOR_RESET << " Expose timeout\n";
-            }
+    x11bench::ReplayStats stats;
+    x11bench::TraceReplayer replayer(trace, options);
+    if (!replayer.run(stats)) {
+        std::cerr << "Replay failed: " << replayer.error() << std::endl;
+        return 1;
+    }
+
+    std::cout << "Replayed " << stats.requests << " requests in " << stats.total_ms << " ms";
+    if (stats.total_ms > 0) {
+        std::cout << " (" << static_cast<uint64_t>(stats.requests * 1000.0 / stats.total_ms)
+                  << " req/s)";
+    }
+    std::cout << ", " << stats.errors << " X errors\n";
+
+    // Most expensive types first when timed, most frequent otherwise
+    std::vector<std::pair<std::string, x11bench::ReplayStats::TypeStats>> types(
+        stats.per_type.begin(), stats.per_type.end());
+    std::sort(types.begin(), types.end(), [&](const auto& a, const auto& b) {
+        return options.per_request ? a.second.total_ms > b.second.total_ms
+                                   : a.second.count > b.second.count;
+    });
+    for (const auto& [name, type] : types) {
+        std::cout << "  " << name << ": " << type.count;
+        if (options.per_request) {
+            std::cout << " requests, " << type.total_ms << " ms ("
+                      << type.total_ms * 1000.0 / type.count << " us each)";
         }
+        std::cout << "\n";
+    }
+    return stats.errors > 0 ? 1 : 0;
+}
 
-        // Clear window to ensure it starts fresh
-        display.clear_window();
 
-        // Render the test pattern
-        test->render(display);
+int main(int argc, char* argv[]) {
+    x11bench::StartupProfile::instance();  // Starts the startup clock
 
-        // Ensure all drawing commands are sent and processed
-        display.flush();
-        display.sync(false);
+    if (argc > 1 && std::strcmp(argv[1], "record") == 0) {
+        return run_record(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "replay") == 0) {
+        return run_replay(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        return run_bench(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "compare") == 0) {
+        return run_compare(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "soak") == 0) {
+        return run_soak(argc, argv);
+    }
 
-        // Delay to allow X server to fully rasterize the rendering.
-        // XSync only ensures commands are received, not that compositing/
-        // rasterization is complete.
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Options opts = parse_args(argc, argv);
 
-        display.sync(false);
+    auto& tests = x11bench::get_test_registry();
 
-        // Self-verifying tests handle their own verification
-        if (test->is_self_verifying()) {
-            if (test->test_passed()) {
-                std::cout << COLOR_GREEN << "[PASS]" << COLOR_RESET << "\n";
-                passed++;
-            } else {
-                std::cout << COLOR_RED << "[FAIL]" << COLOR_RESET << " " << test->failure_reason() << "\n";
-                failed++;
-            }
-            continue;
+    if (tests.empty()) {
+        std::cerr << "No tests registered!" << std::endl;
+        return 1;
+    }
+
+    // Instantiate each test once for its name rather than per comparison
+    std::vector<std::pair<std::string, x11bench::TestInfo>> named;
+    {
+        x11bench::StartupProfile::Scope scope("registry setup");
+        named.reserve(tests.size());
+        for (const auto& test_info : tests) {
+            named.emplace_back(test_info.factory()->name(), test_info);
         }
 
-        // Capture window content
-        x11bench::Image captured;
-        try {
-            captured = x11bench::Capture::capture_window(display);
-        } catch (const std::exception& e) {
-            std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " " << e.what() << "\n";
-            failed++;
-            continue;
+        // Name order for --list and for ties in the runner's schedule, which
+        // decides when each test actually runs
+        std::sort(named.begin(), named.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+    }
+
+    // List tests if requested
+    if (opts.list_only) {
+        std::cout << "Available tests (" << named.size() << "):\n";
+        for (const auto& [name, test_info] : named) {
+            auto test = test_info.factory();
+            std::cout << "  " << name << " - " << test->description() << "\n";
         }
+        return 0;
+    }
 
-        // Handle reference image
-        if (opts.regenerate || !fs::exists(ref_path)) {
-            // Generate/regenerate reference
-            if (captured.save_png(ref_path)) {
-                std::cout << COLOR_BLUE << "[GENERATED]" << COLOR_RESET;
-                if (opts.regenerate) {
-                    std::cout << " (regenerated)";
-                }
-                std::cout << "\n";
-                passed++;
-            } else {
-                std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " Failed to save reference\n";
-                failed++;
+    // Create reference directory if needed
+    if (!fs::exists(opts.run.reference_dir)) {
+        fs::create_directories(opts.run.reference_dir);
+    }
+
+    std::vector<x11bench::TestInfo> selected;
+    std::vector<x11bench::TestInfo> window_only;  // No screen captures
+    int skipped = 0;
+    for (const auto& [name, test_info] : named) {
+        if (matches_filter(name, opts.filter)) {
+            selected.push_back(test_info);
+            if (!test_info.factory()->captures_screen()) {
+                window_only.push_back(test_info);
             }
         } else {
-            // Compare with reference
-            x11bench::Image reference;
-            if (!reference.load_png(ref_path)) {
-                std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " Failed to load reference\n";
-                failed++;
-                continue;
-            }
+            skipped++;
+        }
+    }
 
-            x11bench::CompareResult result;
-            if (test->allowed_diff_percent() > 0) {
-                result = x11bench::Compare::fuzzy_percent(reference, captured,
-                                                          test->allowed_diff_percent(),
-                                                          test->tolerance());
-            } else {
-                result = x11bench::Compare::fuzzy(reference, captured, test->tolerance());
-            }
+    // Xlib must be told before the first call when connections are used
+    // from more than one thread.
+    if (opts.run.jobs > 1) {
+        XInitThreads();
+    }
 
-            if (result.match) {
-                std::cout << COLOR_GREEN << "[PASS]" << COLOR_RESET;
-                if (opts.verbose && result.different_pixels > 0) {
-                    std::cout << " (" << result.different_pixels << " pixels within tolerance)";
-                }
-                std::cout << "\n";
-                passed++;
-            } else {
-                std::cout << COLOR_RED << "[FAIL]" << COLOR_RESET << " " << result.message << "\n";
-                failed++;
+    // Own the X server for the duration of the run when asked to
+    std::unique_ptr<x11bench::XServer> server;
+    if (opts.managed_server) {
+        server = std::make_unique<x11bench::XServer>(opts.server);
+        x11bench::StartupProfile::Scope scope("server startup");
+        if (!server->start()) {
+            std::cerr << "Failed to start " << opts.server.program << ": "
+                      << server->error() << std::endl;
+            return 1;
+        }
+        opts.run.display_name = server->display_name();
+        if (opts.run.verbose) {
+            std::cout << (server->reused() ? "Reusing " : "Started ") << opts.server.program
+                      << " on " << server->display_name() << " (pid " << server->pid()
+                      << ", " << server->startup_ms() << " ms)\n";
+        }
+    }
 
-                if (opts.save_failures) {
-                    std::string fail_path = opts.reference_dir + "/" + test->name() + "_fail.png";
-                    std::string diff_path = opts.reference_dir + "/" + test->name() + "_diff.png";
+    int screens = server ? server->screen_count() : 1;
+    std::vector<MatrixEntry> matrix = build_matrix(opts, screens);
+    if (matrix.empty()) {
+        return 1;
+    }
 
-                    captured.save_png(fail_path);
+    x11bench::DurationHistory history;
+    history.load(opts.durations_file);
 
-                    auto diff = x11bench::Compare::generate_diff(reference, captured, test->tolerance());
-                    diff.save_png(diff_path);
+    std::vector<x11bench::TestResult> results;
+    auto finish = [&](const std::vector<x11bench::TestResult>& all) {
+        for (const auto& result : all) {
+            history.record(result.name, result.duration_ms);
+        }
+        history.save(opts.durations_file);
 
-                    if (opts.verbose) {
-                        std::cout << "    Saved failure: " << fail_path << "\n";
-                        std::cout << "    Saved diff: " << diff_path << "\n";
-                    }
-                }
-            }
+        x11bench::Runner::print_summary(all, skipped);
+        if (opts.startup_profile) {
+            x11bench::StartupProfile::instance().report(std::cout);
+        }
+    };
+
+    for (const auto& entry : matrix) {
+        x11bench::RunnerOptions run = opts.run;
+        run.display_name = entry.display_name;
+        run.visual = entry.visual.id;
+        run.visual_tag = entry.visual.tag;
+
+        if (matrix.size() > 1) {
+            std::cout << "\nVisual: depth " << entry.visual.depth
+                      << (entry.visual.tag.empty() ? "" : " (" + entry.visual.tag + ")")
+                      << " on " << (entry.display_name.empty() ? "default display"
+                                                               : entry.display_name) << "\n";
         }
-    }
 
-    display.destroy_window();
-    display.disconnect();
+        // Screen captures read the root, whose GetImage leaves windows of
+        // another depth undefined; those tests only run on the default visual
+        const auto& tests = entry.screen_default ? selected : window_only;
+        if (matrix.size() > 1 && tests.size() < selected.size()) {
+            std::cout << "Skipping " << selected.size() - tests.size()
+                      << " screen-capturing tests on a non-default visual\n";
+        }
+        if (tests.empty()) {
+            continue;
+        }
 
-    // Summary
-    std::cout << "\n" << std::string(60, '=') << "\n";
-    std::cout << COLOR_BOLD << "Summary:" << COLOR_RESET << "\n";
-    std::cout << "  " << COLOR_GREEN << "Passed:  " << passed << COLOR_RESET << "\n";
-    std::cout << "  " << COLOR_RED << "Failed:  " << failed << COLOR_RESET << "\n";
-    if (skipped > 0) {
-        std::cout << "  " << COLOR_YELLOW << "Skipped: " << skipped << COLOR_RESET << "\n";
+        x11bench::Runner runner(run, history);
+        runner.set_abort_handler([&](const std::vector<x11bench::TestResult>& partial) {
+            // Earlier passes plus this one's; then the server goes with us
+            std::vector<x11bench::TestResult> all = results;
+            all.insert(all.end(), partial.begin(), partial.end());
+            finish(all);
+            if (server) {
+                server->stop();
+            }
+        });
+        if (!runner.run(tests)) {
+            return 1;
+        }
+        results.insert(results.end(), runner.results().begin(), runner.results().end());
     }
-    std::cout << "  Total:   " << (passed + failed + skipped) << "\n";
 
-    return failed > 0 ? 1 : 0;
+    finish(results);
+
+    bool any_failed = std::any_of(results.begin(), results.end(),
+                                  [](const x11bench::TestResult& r) {
+                                      return x11bench::is_failure(r.status);
+                                  });
+    return any_failed ? 1 : 0;
 }
@@ -0,0 +1,114 @@
+#include "manifest.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace x11bench {
+
+bool TileManifest::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        TileEntry entry;
+        if (!(fields >> name >> std::hex >> entry.file_hash >> std::dec >>
+              entry.width >> entry.height >> entry.tile) || entry.tile == 0) {
+            continue;
+        }
+        size_t count = static_cast<size_t>((entry.width + entry.tile - 1) / entry.tile) *
+                       ((entry.height + entry.tile - 1) / entry.tile);
+        uint64_t hash;
+        while (entry.hashes.size() < count && fields >> std::hex >> hash) {
+            entry.hashes.push_back(hash);
+        }
+        if (entry.hashes.size() == count) {
+            entries_[name] = std::move(entry);
+        }
+    }
+    dirty_ = false;
+    return true;
+}
+
+bool TileManifest::save(const std::string& path) const {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [name, entry] : entries_) {
+            out << name << " " << std::hex << entry.file_hash << std::dec << " "
+                << entry.width << " " << entry.height << " " << entry.tile << std::hex;
+            for (uint64_t hash : entry.hashes) {
+                out << " " << hash;
+            }
+            out << std::dec << "\n";
+        }
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool TileManifest::lookup(const std::string& name, const std::string& png_path,
+                          TileEntry& entry) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(name);
+        if (it == entries_.end()) {
+            return false;
+        }
+        entry = it->second;
+    }
+    return entry.file_hash != 0 && entry.file_hash == file_hash(png_path);
+}
+
+void TileManifest::update(const std::string& name, TileEntry entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[name] = std::move(entry);
+    dirty_ = true;
+}
+
+bool TileManifest::dirty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dirty_;
+}
+
+uint64_t TileManifest::file_hash(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return 0;
+    }
+
+    // FNV-1a over the raw bytes; far cheaper than decoding the PNG
+    const uint64_t prime = 0x100000001b3ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    char buf[65536];
+    while (in.read(buf, sizeof(buf)) || in.gcount() > 0) {
+        std::streamsize n = in.gcount();
+        size_t i = 0;
+        for (; i + 8 <= static_cast<size_t>(n); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, buf + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+            hash ^= hash >> 29;
+        }
+        for (; i < static_cast<size_t>(n); i++) {
+            hash = (hash ^ static_cast<uint8_t>(buf[i])) * prime;
+        }
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+} // namespace x11bench
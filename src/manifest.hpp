@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// Tile hash grid of one reference image
+struct TileEntry {
+    uint64_t file_hash = 0;      // Hash of the PNG file the grid was taken from
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tile = 0;
+    std::vector<uint64_t> hashes;  // Image::tile_hashes(tile), row-major
+};
+
+// Per-directory manifest of reference tile hashes ("tiles.manifest"). A
+// capture whose tile hashes all match passes without decoding the PNG; on a
+// partial match only the differing tiles are compared. Entries are keyed by
+// test name and carry the PNG's file hash, so a reference replaced behind the
+// manifest's back is noticed and its entry rebuilt. Thread-safe.
+class TileManifest {
+public:
+    static constexpr uint32_t TILE_SIZE = 32;
+
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // Entry for `name` whose file hash matches the PNG at `png_path`
+    bool lookup(const std::string& name, const std::string& png_path, TileEntry& entry) const;
+
+    void update(const std::string& name, TileEntry entry);
+
+    // True once update() changed anything since load()
+    bool dirty() const;
+
+    // 64-bit hash of a file's bytes; 0 if it can't be read
+    static uint64_t file_hash(const std::string& path);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, TileEntry> entries_;
+    bool dirty_ = false;
+};
+
+} // namespace x11bench
@@ -0,0 +1,81 @@
+#include "profile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace x11bench {
+
+namespace {
+double ms_between(StartupProfile::Clock::time_point from, StartupProfile::Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+} // namespace
+
+StartupProfile::StartupProfile()
+    : start_(Clock::now()) {
+}
+
+StartupProfile& StartupProfile::instance() {
+    static StartupProfile profile;
+    return profile;
+}
+
+void StartupProfile::add(const std::string& phase, Clock::time_point start) {
+    Clock::time_point end = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = std::find_if(phases_.begin(), phases_.end(),
+                           [&](const auto& entry) { return entry.first == phase; });
+    if (it == phases_.end()) {
+        phases_.emplace_back(phase, Phase());
+        it = phases_.end() - 1;
+    }
+
+    // A phase straddling the first test is split at it
+    Phase& entry = it->second;
+    if (!started_) {
+        entry.before_ms += ms_between(start, end);
+    } else if (start >= first_test_) {
+        entry.after_ms += ms_between(start, end);
+    } else {
+        entry.before_ms += ms_between(start, first_test_);
+        entry.after_ms += ms_between(first_test_, end);
+    }
+    entry.calls++;
+}
+
+void StartupProfile::first_test() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+        first_test_ = Clock::now();
+        started_ = true;
+    }
+}
+
+void StartupProfile::report(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    double total_ms = ms_between(start_, started_ ? first_test_ : Clock::now());
+    char line[128];
+    std::snprintf(line, sizeof(line), "\nStartup profile (%s: %.1f ms)\n",
+                  started_ ? "time to first test" : "no test started", total_ms);
+    out << line;
+
+    double accounted_ms = 0;
+    for (const auto& [name, phase] : phases_) {
+        std::snprintf(line, sizeof(line), "  %-20s %8.1f ms  (%d call%s)", name.c_str(),
+                      phase.before_ms, phase.calls, phase.calls == 1 ? "" : "s");
+        out << line;
+        if (phase.after_ms > 0) {
+            std::snprintf(line, sizeof(line), ", %.1f ms after the first test", phase.after_ms);
+            out << line;
+        }
+        out << "\n";
+        accounted_ms += phase.before_ms;
+    }
+    std::snprintf(line, sizeof(line), "  %-20s %8.1f ms\n", "other",
+                  std::max(0.0, total_ms - accounted_ms));
+    out << line;
+}
+
+} // namespace x11bench
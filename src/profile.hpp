@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace x11bench {
+
+// Where the time before the first test goes (--startup-profile). Phases are
+// accumulated process-wide from any thread, measured from the start of
+// main(). Time a phase spends after the first test started is reported
+// separately: lazy initialization moves costs such as fontconfig's out of
+// startup and into whichever test first needs them.
+class StartupProfile {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static StartupProfile& instance();
+
+    // Adds the time since `start` to `phase`
+    void add(const std::string& phase, Clock::time_point start);
+
+    // Called as each test starts; only the first call counts
+    void first_test();
+
+    void report(std::ostream& out) const;
+
+    // Times one phase for its lifetime
+    class Scope {
+    public:
+        explicit Scope(const char* phase) : phase_(phase), start_(Clock::now()) {}
+        ~Scope() { instance().add(phase_, start_); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* phase_;
+        Clock::time_point start_;
+    };
+
+private:
+    StartupProfile();
+
+    struct Phase {
+        double before_ms = 0;  // Before the first test started
+        double after_ms = 0;
+        int calls = 0;
+    };
+
+    mutable std::mutex mutex_;
+    Clock::time_point start_;
+    Clock::time_point first_test_;
+    bool started_ = false;
+    std::vector<std::pair<std::string, Phase>> phases_;  // In order of first use
+};
+
+} // namespace x11bench
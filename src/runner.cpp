@@ -0,0 +1,1188 @@
+#include "runner.hpp"
+#include "capture.hpp"
+#include "compare.hpp"
+#include "profile.hpp"
+#include "scenario.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <sys/socket.h>
+
+namespace fs = std::filesystem;
+
+// ANSI color codes
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_YELLOW  "\033[33m"
+#define COLOR_BLUE    "\033[34m"
+#define COLOR_RESET   "\033[0m"
+#define COLOR_BOLD    "\033[1m"
+
+namespace x11bench {
+
+Runner::Runner(const RunnerOptions& options, const DurationHistory& history)
+    : options_(options), history_(history) {
+}
+
+bool Runner::run(const std::vector<TestInfo>& tests) {
+    results_.clear();
+
+    // Screen-capturing tests create windows anywhere on the root and read the
+    // whole screen back, so they can't share it with other lanes.
+    std::vector<std::shared_ptr<TestBase>> parallel;
+    std::vector<std::shared_ptr<TestBase>> serial;
+    uint32_t slot_width = 1;
+    uint32_t slot_height = 1;
+    {
+        StartupProfile::Scope scope("registry setup");
+        for (const auto& test_info : tests) {
+            std::shared_ptr<TestBase> test = test_info.factory();
+            if (test->captures_screen()) {
+                serial.push_back(test);
+            } else {
+                slot_width = std::max(slot_width, test->width());
+                slot_height = std::max(slot_height, test->height());
+                parallel.push_back(test);
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    lanes.push_back(std::make_unique<Lane>());
+    if (!lanes[0]->display.connect(options_.display_name, options_.visual)) {
+        std::cerr << "Failed to connect to X display" << std::endl;
+        return false;
+    }
+
+    Display& primary = lanes[0]->display;
+    if (options_.verbose) {
+        std::cout << "Connected to X display\n";
+        std::cout << "XRender support: " << (primary.has_xrender() ? "yes" : "no") << "\n";
+        std::cout << "Visual depth: " << primary.depth() << "\n";
+    }
+
+    fs::create_directories(reference_dir());
+    manifest_.load(manifest_path());
+    load_variants();
+
+    // Divide the screen into non-overlapping slots, one per lane
+    uint32_t columns = std::max(1u, primary.screen_width() / slot_width);
+    uint32_t rows = std::max(1u, primary.screen_height() / slot_height);
+    size_t lane_count = std::min<size_t>(options_.jobs, columns * rows);
+    lane_count = std::max<size_t>(1, std::min(lane_count, parallel.size()));
+
+    if (options_.atlas) {
+        // Fewest, largest slots that still give every lane one: the whole
+        // screen for a single lane
+        uint32_t atlas_columns = 1;
+        while (atlas_columns < columns &&
+               (atlas_columns * atlas_columns < lane_count ||
+                (lane_count + atlas_columns - 1) / atlas_columns > rows)) {
+            atlas_columns++;
+        }
+        uint32_t atlas_rows = static_cast<uint32_t>((lane_count + atlas_columns - 1) / atlas_columns);
+        columns = atlas_columns;
+        slot_width = primary.screen_width() / atlas_columns;
+        slot_height = primary.screen_height() / atlas_rows;
+    }
+    lanes[0]->slot_width = slot_width;
+    lanes[0]->slot_height = slot_height;
+
+    for (size_t i = 1; i < lane_count; i++) {
+        auto lane = std::make_unique<Lane>();
+        if (!lane->display.connect(options_.display_name, options_.visual)) {
+            break;
+        }
+        lane->origin_x = static_cast<int>((i % columns) * slot_width);
+        lane->origin_y = static_cast<int>((i / columns) * slot_height);
+        lane->slot_width = slot_width;
+        lane->slot_height = slot_height;
+        lanes.push_back(std::move(lane));
+    }
+
+    if (options_.verbose && options_.jobs > 1) {
+        std::cout << "Lanes: " << lanes.size() << " (slot " << slot_width << "x"
+                  << slot_height << "), verify threads: " << pool_.size() << "\n";
+    }
+
+    std::cout << "\n" << COLOR_BOLD << "Running X11 visual tests" << COLOR_RESET << "\n";
+    std::cout << std::string(60, '=') << "\n\n";
+
+    // Longest-processing-time-first: tests without history are assumed to
+    // take the average, then each goes to the lane with the least work queued
+    double fallback_ms = history_.mean(100.0);
+    std::vector<Scheduled> order;
+    for (const auto& test : parallel) {
+        order.push_back({test, history_.get(qualified_name(*test), fallback_ms)});
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const Scheduled& a, const Scheduled& b) {
+                         return a.estimate_ms > b.estimate_ms;
+                     });
+    for (auto& item : order) {
+        auto target = std::min_element(lanes.begin(), lanes.end(),
+                                       [](const auto& a, const auto& b) {
+                                           return a->pending_ms < b->pending_ms;
+                                       });
+        (*target)->pending_ms += item.estimate_ms;
+        (*target)->queue.push_back(std::move(item));
+    }
+
+    std::atomic<bool> watching{true};
+    std::thread watchdog;
+    if (options_.timeout_ms > 0) {
+        watchdog = std::thread([&]() { watchdog_loop(lanes, watching); });
+    }
+
+    auto lane_loop = [&](Lane& lane) {
+        Scheduled item;
+        while (lane.display.is_connected() && next_test(lane, lanes, item)) {
+            if (!options_.atlas || !fits_atlas(*item.test, lane)) {
+                run_on_lane(lane, item.test);
+                continue;
+            }
+
+            // Shelf-pack following tests into the lane's slot until one
+            // doesn't fit; that one goes back to the front of the queue
+            std::vector<std::shared_ptr<TestBase>> batch;
+            std::vector<XRectangle> tiles;
+            int x = 0, y = 0, shelf = 0;
+            auto place = [&](const TestBase& test) {
+                int w = static_cast<int>(test.width());
+                int h = static_cast<int>(test.height());
+                if (x + w > static_cast<int>(lane.slot_width)) {
+                    x = 0;
+                    y += shelf;
+                    shelf = 0;
+                }
+                if (y + h > static_cast<int>(lane.slot_height)) {
+                    return false;
+                }
+                tiles.push_back({static_cast<short>(x), static_cast<short>(y),
+                                 static_cast<unsigned short>(w), static_cast<unsigned short>(h)});
+                x += w;
+                shelf = std::max(shelf, h);
+                return true;
+            };
+            place(*item.test);
+            batch.push_back(item.test);
+            while (next_test(lane, lanes, item)) {
+                if (!fits_atlas(*item.test, lane) || !place(*item.test)) {
+                    std::lock_guard<std::mutex> lock(lane.mutex);
+                    lane.pending_ms += item.estimate_ms;
+                    lane.queue.push_front(std::move(item));
+                    break;
+                }
+                batch.push_back(item.test);
+            }
+
+            if (batch.size() == 1) {
+                run_on_lane(lane, batch.front());
+            } else {
+                run_atlas(lane, batch, tiles);
+            }
+        }
+        lane.display.destroy_window();
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < lanes.size(); i++) {
+        threads.emplace_back(lane_loop, std::ref(*lanes[i]));
+    }
+    lane_loop(*lanes[0]);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Dedicated lane for screen-capturing tests, once every window slot is
+    // free. Scenarios share the screen with each other, one region apiece.
+    std::vector<std::shared_ptr<TestBase>> scenarios;
+    std::vector<std::shared_ptr<TestBase>> exclusive;
+    for (const auto& test : serial) {
+        (test->scenario() ? scenarios : exclusive).push_back(test);
+    }
+    if (!scenarios.empty() &&
+        (lanes[0]->display.is_connected() || recover_lane(*lanes[0]))) {
+        run_scenarios(*lanes[0], scenarios);
+    }
+    for (const auto& test : exclusive) {
+        if (!lanes[0]->display.is_connected() && !recover_lane(*lanes[0])) {
+            break;
+        }
+        run_on_lane(*lanes[0], test);
+    }
+    lanes[0]->display.destroy_window();
+
+    watching = false;
+    if (watchdog.joinable()) {
+        watchdog.join();
+    }
+
+    pool_.wait();
+    if (manifest_.dirty() && !manifest_.save(manifest_path()) && options_.verbose) {
+        std::cerr << "Failed to write " << manifest_path() << "\n";
+    }
+    return true;
+}
+
+bool Runner::next_test(Lane& lane, std::vector<std::unique_ptr<Lane>>& lanes, Scheduled& out) {
+    {
+        std::lock_guard<std::mutex> lock(lane.mutex);
+        if (!lane.queue.empty()) {
+            out = std::move(lane.queue.front());
+            lane.queue.pop_front();
+            lane.pending_ms -= out.estimate_ms;
+            return true;
+        }
+    }
+
+    // Own queue drained: steal the shortest remaining test of the busiest lane
+    while (true) {
+        Lane* victim = nullptr;
+        double most = 0.0;
+        for (auto& other : lanes) {
+            if (other.get() == &lane) continue;
+            std::lock_guard<std::mutex> lock(other->mutex);
+            if (!other->queue.empty() && (!victim || other->pending_ms > most)) {
+                victim = other.get();
+                most = other->pending_ms;
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->queue.empty()) {
+            out = std::move(victim->queue.back());
+            victim->queue.pop_back();
+            victim->pending_ms -= out.estimate_ms;
+            return true;
+        }
+        // Victim drained in the meantime; rescan
+    }
+}
+
+namespace {
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A lane that stays stuck this long after its connection was shut down is
+// spinning outside Xlib and can't be recovered
+const int64_t WATCHDOG_GRACE_NS = 5000000000LL;
+} // namespace
+
+void Runner::watchdog_loop(std::vector<std::unique_ptr<Lane>>& lanes,
+                           std::atomic<bool>& watching) {
+    while (watching) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        int64_t now = steady_now_ns();
+
+        for (auto& lane : lanes) {
+            int64_t deadline = lane->deadline_ns;
+            int64_t fired = lane->fired_ns;
+            if (deadline == 0) {
+                continue;
+            }
+
+            if (fired == 0 && now > deadline) {
+                // Break the connection: any call blocked on the server (XSync,
+                // XNextEvent, GetImage) returns through the IO error path
+                lane->fired_ns = now;
+                lane->timed_out = true;
+                int fd = lane->fd;
+                if (fd >= 0) {
+                    shutdown(fd, SHUT_RDWR);
+                }
+            } else if (fired != 0 && now - fired > WATCHDOG_GRACE_NS) {
+                abort_run(lanes, *lane);
+            }
+        }
+    }
+}
+
+void Runner::abort_run(std::vector<std::unique_ptr<Lane>>& lanes, const Lane& stuck) {
+    // The stuck thread can't be joined, so run() never returns. Report what
+    // is in flight, then let the caller save its state before exiting.
+    std::vector<TestResult> results;
+    {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        for (auto& lane : lanes) {
+            const TestBase* test = lane->current;
+            if (!test) {
+                continue;
+            }
+            TestResult result;
+            result.name = qualified_name(*test);
+            result.status = TestStatus::Timeout;
+            if (lane.get() == &stuck) {
+                result.duration_ms = options_.timeout_ms + WATCHDOG_GRACE_NS / 1e6;
+                result.message = "lane unresponsive after connection shutdown; run aborted";
+            } else {
+                result.message = "run aborted while in progress";
+            }
+            std::cout << std::left << std::setw(35) << test->name() << " "
+                      << COLOR_RED << "[TIMEOUT]" << COLOR_RESET << " " << result.message
+                      << std::endl;
+            results_.push_back(std::move(result));
+        }
+        results = results_;
+    }
+
+    if (manifest_.dirty()) {
+        manifest_.save(manifest_path());
+    }
+    if (abort_handler_) {
+        abort_handler_(results);
+    }
+    std::cout.flush();
+    std::_Exit(2);
+}
+
+bool Runner::recover_lane(Lane& lane) {
+    lane.offscreen_active = false;
+    lane.offscreen.reset();
+    lane.display.destroy_window();
+    lane.display.disconnect();
+    lane.timed_out = false;
+    lane.fd = -1;
+    return lane.display.connect(options_.display_name, options_.visual);
+}
+
+namespace {
+// File stem of a reference variant; the plain reference has no tag
+std::string variant_name(const std::string& reference_name, const std::string& tag) {
+    return tag.empty() ? reference_name : reference_name + "~" + tag;
+}
+} // namespace
+
+void Runner::load_variants() {
+    std::lock_guard<std::mutex> lock(variants_mutex_);
+    variants_.clear();
+    std::error_code ec;
+    for (auto it = fs::directory_iterator(reference_dir(), ec);
+         !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        const fs::path& path = it->path();
+        std::string stem = path.stem().string();
+        size_t tilde = stem.find('~');
+        if (path.extension() != ".png" || tilde == std::string::npos || tilde == 0 ||
+            tilde + 1 == stem.size()) {
+            continue;
+        }
+        variants_[stem.substr(0, tilde)].push_back(stem.substr(tilde + 1));
+    }
+    for (auto& [name, tags] : variants_) {
+        std::sort(tags.begin(), tags.end());
+    }
+}
+
+std::vector<std::string> Runner::variants_of(const std::string& reference_name) {
+    std::lock_guard<std::mutex> lock(variants_mutex_);
+    auto it = variants_.find(reference_name);
+    return it != variants_.end() ? it->second : std::vector<std::string>();
+}
+
+std::string Runner::manifest_path() const {
+    // A local cache, not part of the references: entries are checked against
+    // their PNG's hash, so a stale or missing file only costs a decode
+    return options_.visual_tag.empty() ? options_.tiles_file
+                                       : options_.tiles_file + "-" + options_.visual_tag;
+}
+
+std::string Runner::qualified_name(const TestBase& test) const {
+    return options_.visual_tag.empty() ? test.name() : options_.visual_tag + "/" + test.name();
+}
+
+std::string Runner::reference_dir() const {
+    if (options_.visual_tag.empty()) {
+        return options_.reference_dir;
+    }
+    return options_.reference_dir + "/" + options_.visual_tag;
+}
+
+void Runner::run_on_lane(Lane& lane, std::shared_ptr<TestBase> test) {
+    StartupProfile::instance().first_test();
+    Display& display = lane.display;
+    TestResult result;
+    result.name = qualified_name(*test);
+    auto start = std::chrono::steady_clock::now();
+
+    auto elapsed_ms = [&start]() {
+        return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    };
+
+    // Arm the watchdog for this test; disarmed on every exit path
+    struct Disarm {
+        Lane& lane;
+        ~Disarm() {
+            lane.deadline_ns = 0;
+            lane.fired_ns = 0;
+            lane.current = nullptr;
+        }
+    } disarm{lane};
+    lane.current = test.get();
+    lane.fd = ConnectionNumber(display.x_display());
+    if (options_.timeout_ms > 0) {
+        lane.deadline_ns = steady_now_ns() + int64_t(options_.timeout_ms) * 1000000;
+    }
+
+    // Create window for this test, or point the display at the lane's
+    // shared-memory pixmap
+    display.mark(test->name() + ": setup");
+    display.destroy_window();
+    if (!use_offscreen(lane, *test)) {
+        if (!display.create_window(test->width(), test->height(), "x11bench - " + test->name(),
+                                   lane.origin_x, lane.origin_y)) {
+            result.duration_ms = elapsed_ms();
+            result.status = TestStatus::Error;
+            result.message = "Failed to create window";
+            report(std::move(result));
+            return;
+        }
+
+        display.show_window();
+
+        // Wait for the window to be mapped and exposed
+        if (!display.wait_for_expose(2000) && options_.verbose) {
+            std::lock_guard<std::mutex> lock(results_mutex_);
+            std::cout << COLOR_YELLOW << "[WARN]" << COLOR_RESET << " "
+                      << test->name() << ": Expose timeout\n";
+        }
+    }
+
+    // Clear window to ensure it starts fresh
+    display.clear_window();
+
+    // Render the test pattern; checkpoints are captured along the way
+    display.mark(test->name() + ": render");
+    test->set_checkpoint_hook([this, &lane, test](Display&, const std::string& label) {
+        run_checkpoint(lane, test, label);
+    });
+    test->render(display);
+    test->set_checkpoint_hook(nullptr);
+
+    // Ensure all drawing commands are sent and processed
+    display.flush();
+    display.sync(false);
+
+    // Delay to allow X server to fully rasterize the rendering.
+    // XSync only ensures commands are received, not that compositing/
+    // rasterization is complete. `bench --filter latency` measures how long
+    // that actually takes on a given server. Pixmaps aren't composited, so
+    // an offscreen target is complete after the sync.
+    if (options_.settle_ms > 0 && !lane.offscreen_active) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.settle_ms));
+    }
+
+    display.sync(false);
+
+    auto report_timeout = [&]() {
+        result.duration_ms = elapsed_ms();
+        result.status = TestStatus::Timeout;
+        result.message = "exceeded " + std::to_string(options_.timeout_ms) + " ms";
+        if (!recover_lane(lane)) {
+            result.message += "; lane could not reconnect";
+        }
+        report(std::move(result));
+    };
+
+    if (lane.timed_out) {
+        report_timeout();
+        return;
+    }
+
+    // The sync above has delivered every error the test's requests produced
+    auto errors = display.take_errors();
+    if (!errors.empty()) {
+        result.duration_ms = elapsed_ms();
+        result.status = TestStatus::Error;
+        result.message = "X error: " + display.describe_error(errors.front());
+        if (errors.size() > 1) {
+            result.message += " (+" + std::to_string(errors.size() - 1) + " more)";
+        }
+        report(std::move(result));
+        return;
+    }
+
+    // Self-verifying tests handle their own verification
+    if (test->is_self_verifying()) {
+        result.duration_ms = elapsed_ms();
+        result.status = test->test_passed() ? TestStatus::Passed : TestStatus::Failed;
+        result.message = test->test_passed() ? "" : test->failure_reason();
+        report(std::move(result));
+        return;
+    }
+
+    // Capture window content
+    display.mark(test->name() + ": capture");
+    Image captured;
+    try {
+        captured = capture_test_window(lane, *test);
+    } catch (const std::exception& e) {
+        if (lane.timed_out) {
+            report_timeout();
+            return;
+        }
+        result.duration_ms = elapsed_ms();
+        result.status = TestStatus::Error;
+        result.message = e.what();
+        report(std::move(result));
+        return;
+    }
+    result.duration_ms = elapsed_ms();
+
+    errors = display.take_errors();
+    if (!errors.empty()) {
+        result.status = TestStatus::Error;
+        result.message = "X error: " + display.describe_error(errors.front());
+        report(std::move(result));
+        return;
+    }
+
+    // Reference I/O and comparison don't need the connection
+    pool_.submit([this, test, captured = std::move(captured), result]() mutable {
+        verify(test, test->name(), std::move(captured), std::move(result));
+    });
+}
+
+Image Runner::capture_test_window(Lane& lane, const TestBase& test) {
+    // Offscreen pixels are already in this process
+    if (lane.offscreen_active) {
+        return lane.offscreen->view().to_image();
+    }
+
+    // 32-bit visuals carry real alpha, so always read them back exactly
+    if (test.exact_alpha() || lane.display.depth() == 32) {
+        return Capture::capture_window_argb(lane.display);
+    }
+    return Capture::capture_window(lane.display);
+}
+
+void Runner::run_checkpoint(Lane& lane, std::shared_ptr<TestBase> test,
+                            const std::string& label) {
+    Display& display = lane.display;
+    std::string reference = test->name() + "@" + label;
+    TestResult result;
+    result.name = qualified_name(*test) + "@" + label;
+
+    // Same settle as the final frame
+    display.flush();
+    display.sync(false);
+    if (options_.settle_ms > 0 && !lane.offscreen_active) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.settle_ms));
+    }
+    display.sync(false);
+    if (lane.timed_out) {
+        return;
+    }
+
+    display.mark(test->name() + ": capture " + label);
+    Image captured;
+    try {
+        captured = capture_test_window(lane, *test);
+    } catch (const std::exception& e) {
+        if (lane.timed_out) {
+            return;
+        }
+        result.status = TestStatus::Error;
+        result.message = e.what();
+        report(std::move(result));
+        return;
+    }
+    display.mark(test->name() + ": render");
+
+    // X errors stay with the test's own result. Checkpoints have no
+    // duration of their own, so they stay out of the scheduling history.
+    pool_.submit([this, test, reference, captured = std::move(captured), result]() mutable {
+        verify(test, reference, std::move(captured), std::move(result));
+    });
+}
+
+bool Runner::fits_offscreen(const TestBase& test, const Lane& lane) const {
+    // Pixmaps have no children, events or screen position, and are read
+    // back with the plain conversion
+    return !test.captures_screen() && !test.is_self_verifying() && !test.exact_alpha() &&
+           lane.display.depth() != 32;
+}
+
+bool Runner::use_offscreen(Lane& lane, const TestBase& test) {
+    lane.offscreen_active = false;
+    if (!options_.offscreen || !fits_offscreen(test, lane)) {
+        return false;
+    }
+
+    // Reuse the segment while the size stays the same
+    if (!lane.offscreen || lane.offscreen->width() != test.width() ||
+        lane.offscreen->height() != test.height()) {
+        lane.offscreen.reset();
+        lane.offscreen = std::make_unique<ShmPixmap>(lane.display, test.width(), test.height());
+    }
+    if (!lane.offscreen->valid()) {
+        return false;
+    }
+
+    int target = lane.display.add_offscreen(lane.offscreen->pixmap(), test.width(), test.height());
+    if (target < 0) {
+        return false;
+    }
+    lane.display.use_tile(target);
+    lane.offscreen_active = true;
+    return true;
+}
+
+bool Runner::fits_atlas(const TestBase& test, const Lane& lane) const {
+    // Tiles are read back in one plain capture of the atlas window
+    return !test.captures_screen() && !test.is_self_verifying() && !test.exact_alpha() &&
+           lane.display.depth() != 32 &&
+           test.width() <= lane.slot_width && test.height() <= lane.slot_height;
+}
+
+void Runner::run_atlas(Lane& lane, const std::vector<std::shared_ptr<TestBase>>& tests,
+                       const std::vector<XRectangle>& tiles) {
+    StartupProfile::instance().first_test();
+    Display& display = lane.display;
+    auto start = std::chrono::steady_clock::now();
+
+    // One watchdog budget per test, as if they had run one after another
+    struct Disarm {
+        Lane& lane;
+        ~Disarm() {
+            lane.deadline_ns = 0;
+            lane.fired_ns = 0;
+            lane.current = nullptr;
+        }
+    } disarm{lane};
+    lane.current = tests.front().get();
+    lane.fd = ConnectionNumber(display.x_display());
+    if (options_.timeout_ms > 0) {
+        lane.deadline_ns = steady_now_ns() +
+                           int64_t(options_.timeout_ms) * 1000000 * int64_t(tests.size());
+    }
+
+    std::vector<TestResult> results(tests.size());
+    for (size_t i = 0; i < tests.size(); i++) {
+        results[i].name = qualified_name(*tests[i]);
+    }
+    auto fail_all = [&](TestStatus status, const std::string& message) {
+        double share_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count() / tests.size();
+        for (auto& result : results) {
+            result.duration_ms = share_ms;
+            result.status = status;
+            result.message = message;
+            report(std::move(result));
+        }
+    };
+
+    // One window, one map and one expose cycle for every tile
+    uint32_t width = 1, height = 1;
+    for (const auto& tile : tiles) {
+        width = std::max<uint32_t>(width, tile.x + tile.width);
+        height = std::max<uint32_t>(height, tile.y + tile.height);
+    }
+    display.mark("atlas: setup");
+    display.destroy_window();
+    if (!display.create_window(width, height, "x11bench - atlas", lane.origin_x, lane.origin_y)) {
+        fail_all(TestStatus::Error, "Failed to create window");
+        return;
+    }
+    for (const auto& tile : tiles) {
+        display.add_tile(tile.x, tile.y, tile.width, tile.height);
+    }
+    display.show_window();
+    if (!display.wait_for_expose(2000) && options_.verbose) {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        std::cout << COLOR_YELLOW << "[WARN]" << COLOR_RESET << " atlas: Expose timeout\n";
+    }
+
+    // Each test renders into its own tile with fresh GC state
+    for (size_t i = 0; i < tests.size(); i++) {
+        const auto& test = tests[i];
+        lane.current = test.get();
+        display.use_tile(static_cast<int>(i));
+        display.clear_window();
+        display.mark(test->name() + ": render");
+        test->set_checkpoint_hook([this, &lane, test](Display&, const std::string& label) {
+            run_checkpoint(lane, test, label);
+        });
+        test->render(display);
+        test->set_checkpoint_hook(nullptr);
+    }
+    display.use_tile(-1);
+
+    // One settle for the whole atlas
+    display.flush();
+    display.sync(false);
+    if (options_.settle_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.settle_ms));
+    }
+    display.sync(false);
+
+    if (lane.timed_out) {
+        fail_all(TestStatus::Timeout, "atlas of " + std::to_string(tests.size()) +
+                                      " tests exceeded " + std::to_string(options_.timeout_ms) +
+                                      " ms per test");
+        recover_lane(lane);
+        return;
+    }
+
+    display.mark("atlas: capture");
+    Image atlas;
+    try {
+        atlas = Capture::capture_window(display);
+    } catch (const std::exception& e) {
+        if (lane.timed_out) {
+            fail_all(TestStatus::Timeout, "exceeded " + std::to_string(options_.timeout_ms) + " ms");
+            recover_lane(lane);
+            return;
+        }
+        fail_all(TestStatus::Error, e.what());
+        return;
+    }
+
+    // Errors belong to the test whose render() issued the request; setup
+    // and capture errors belong to all of them
+    auto errors = display.take_errors();
+    double share_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count() / tests.size();
+    for (size_t i = 0; i < tests.size(); i++) {
+        const auto& test = tests[i];
+        TestResult& result = results[i];
+        result.duration_ms = share_ms;
+
+        std::string prefix = test->name() + ":";
+        auto error = std::find_if(errors.begin(), errors.end(), [&](const XErrorRecord& e) {
+            return e.context.compare(0, prefix.size(), prefix) == 0 ||
+                   e.context.compare(0, 6, "atlas:") == 0;
+        });
+        if (error != errors.end()) {
+            result.status = TestStatus::Error;
+            result.message = "X error: " + display.describe_error(*error);
+            report(std::move(result));
+            continue;
+        }
+
+        const XRectangle& tile = tiles[i];
+        Image captured = atlas.crop(tile.x, tile.y, tile.width, tile.height);
+        pool_.submit([this, test, captured = std::move(captured), result]() mutable {
+            verify(test, test->name(), std::move(captured), std::move(result));
+        });
+    }
+}
+
+void Runner::run_scenarios(Lane& lane, const std::vector<std::shared_ptr<TestBase>>& tests) {
+    StartupProfile::instance().first_test();
+    Display& display = lane.display;
+    auto start = std::chrono::steady_clock::now();
+
+    // One watchdog budget per test: in the worst case they run one at a time
+    struct Disarm {
+        Lane& lane;
+        ~Disarm() {
+            lane.deadline_ns = 0;
+            lane.fired_ns = 0;
+            lane.current = nullptr;
+        }
+    } disarm{lane};
+    lane.current = tests.front().get();
+    lane.fd = ConnectionNumber(display.x_display());
+    if (options_.timeout_ms > 0) {
+        lane.deadline_ns = steady_now_ns() +
+                           int64_t(options_.timeout_ms) * 1000000 * int64_t(tests.size());
+    }
+
+    display.mark("window scenarios");
+    display.destroy_window();
+
+    std::vector<Scenario*> scenarios;
+    for (const auto& test : tests) {
+        scenarios.push_back(test->scenario());
+    }
+
+    // Results are held back until the final sync has delivered any X errors
+    std::vector<TestResult> results(tests.size());
+    std::vector<bool> finished(tests.size(), false);
+    ScenarioScheduler scheduler(display);
+    scheduler.run(scenarios, [&](size_t i) {
+        TestResult& result = results[i];
+        result.name = qualified_name(*tests[i]);
+        result.duration_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        result.status = tests[i]->test_passed() ? TestStatus::Passed : TestStatus::Failed;
+        result.message = tests[i]->test_passed() ? "" : tests[i]->failure_reason();
+        finished[i] = true;
+    });
+    display.sync(false);
+
+    if (options_.verbose) {
+        std::lock_guard<std::mutex> lock(results_mutex_);
+        std::cout << "Window scenarios: " << tests.size() << " verified from "
+                  << scheduler.captures() << " screen captures\n";
+    }
+
+    // Requests of concurrent scenarios interleave, so an error can't be
+    // pinned on one of them
+    auto errors = display.take_errors();
+    bool timed_out = lane.timed_out;
+    double total_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    for (size_t i = 0; i < tests.size(); i++) {
+        TestResult& result = results[i];
+        result.name = qualified_name(*tests[i]);
+        if (!finished[i]) {
+            result.duration_ms = total_ms;
+        }
+        if (timed_out && !finished[i]) {
+            result.status = TestStatus::Timeout;
+            result.message = "exceeded " + std::to_string(options_.timeout_ms) +
+                             " ms per window scenario";
+        } else if (!errors.empty()) {
+            result.status = TestStatus::Error;
+            result.message = "X error during concurrent window scenarios: " +
+                             display.describe_error(errors.front());
+        } else if (!finished[i]) {
+            // The scheduler gives up on the rest once the connection breaks
+            result.status = TestStatus::Error;
+            result.message = "connection lost before completion";
+        }
+        report(std::move(result));
+    }
+    if (timed_out) {
+        recover_lane(lane);
+    }
+}
+
+void Runner::verify(std::shared_ptr<TestBase> test, const std::string& reference_name,
+                    Image captured, TestResult result) {
+    // Analytic expectations stand in for the final frame's PNG
+    Expectation expectation;
+    if (reference_name == test->name()) {
+        expectation = test->expected();
+    }
+    if (!expectation.empty()) {
+        CompareResult cmp = expectation.check(captured, test->tolerance());
+        if (test->allowed_diff_percent() > 0) {
+            cmp = Compare::within_percent(std::move(cmp), test->allowed_diff_percent(),
+                                          test->tolerance());
+        }
+        Image expected;
+        if (!cmp.match && options_.save_failures) {
+            expected = expectation.render(captured);
+        }
+        finish_verify(*test, reference_name, cmp, captured, expected, std::move(result));
+        return;
+    }
+
+    // Tile hashes of the capture; a manifest entry that still describes its
+    // PNG on disk tells which tiles can differ without decoding it
+    const uint32_t tile = TileManifest::TILE_SIZE;
+    TileEntry fresh;
+    fresh.width = captured.width();
+    fresh.height = captured.height();
+    fresh.tile = tile;
+    fresh.hashes = captured.tile_hashes(tile);
+
+    // Every accepted variant of the reference: the plain PNG and any tagged
+    // "<name>~<tag>.png". A capture identical to one of them passes on tile
+    // hashes alone; otherwise only the nearest one is compared.
+    struct Candidate {
+        std::string tag;
+        std::string key;           // Manifest entry and file stem
+        std::string path;
+        TileEntry known;
+        bool have_tiles = false;
+        size_t equal_tiles = 0;
+        Image image;               // Decoded while indexing, if it was
+    };
+    std::vector<std::string> tags = variants_of(reference_name);
+    tags.insert(tags.begin(), "");
+    std::vector<Candidate> candidates;
+    for (const auto& tag : tags) {
+        Candidate c;
+        c.tag = tag;
+        c.key = variant_name(reference_name, tag);
+        c.path = reference_dir() + "/" + c.key + ".png";
+        if (!fs::exists(c.path)) {
+            continue;
+        }
+        c.have_tiles = manifest_.lookup(c.key, c.path, c.known) &&
+                       c.known.width == fresh.width && c.known.height == fresh.height &&
+                       c.known.tile == tile;
+        if (c.have_tiles) {
+            for (size_t i = 0; i < fresh.hashes.size(); i++) {
+                c.equal_tiles += c.known.hashes[i] == fresh.hashes[i];
+            }
+        }
+        candidates.push_back(std::move(c));
+    }
+    auto is_identical = [&](const Candidate& c) {
+        return c.have_tiles && c.equal_tiles == fresh.hashes.size();
+    };
+    auto identical = std::find_if(candidates.begin(), candidates.end(), is_identical);
+
+    // Handle reference image
+    if (options_.regenerate || candidates.empty()) {
+        // Only write a file when no accepted variant already has these
+        // pixels, to keep git diffs limited to real rendering changes
+        if (identical != candidates.end()) {
+            result.status = TestStatus::Unchanged;
+            report(std::move(result));
+            return;
+        }
+        for (auto& c : candidates) {
+            Image existing;
+            if (!c.have_tiles && existing.load_png(c.path) &&
+                existing.pixel_hash() == captured.pixel_hash()) {
+                fresh.file_hash = TileManifest::file_hash(c.path);
+                manifest_.update(c.key, std::move(fresh));
+                result.status = TestStatus::Unchanged;
+                report(std::move(result));
+                return;
+            }
+        }
+
+        std::string key = variant_name(reference_name, options_.variant);
+        std::string ref_path = reference_dir() + "/" + key + ".png";
+        bool have_reference = std::any_of(candidates.begin(), candidates.end(),
+                                          [&](const Candidate& c) { return c.key == key; });
+        if (captured.save_png(ref_path)) {
+            fresh.file_hash = TileManifest::file_hash(ref_path);
+            manifest_.update(key, std::move(fresh));
+            if (!options_.variant.empty() && !have_reference) {
+                std::lock_guard<std::mutex> lock(variants_mutex_);
+                variants_[reference_name].push_back(options_.variant);
+            }
+            result.status = TestStatus::Generated;
+            result.message = have_reference ? "changed" : "new";
+            if (!options_.variant.empty()) {
+                result.message += " variant " + options_.variant;
+            }
+        } else {
+            result.status = TestStatus::Error;
+            result.message = "Failed to save reference";
+        }
+        report(std::move(result));
+        return;
+    }
+
+    // Ranking needs tile hashes of every variant; those without a manifest
+    // entry (a fresh checkout, an edited PNG) are decoded and indexed first
+    if (candidates.size() > 1) {
+        for (auto& c : candidates) {
+            if (c.have_tiles || !c.image.load_png(c.path) ||
+                c.image.width() != fresh.width || c.image.height() != fresh.height) {
+                continue;
+            }
+            c.known = fresh;
+            c.known.hashes = c.image.tile_hashes(tile);
+            c.known.file_hash = TileManifest::file_hash(c.path);
+            manifest_.update(c.key, c.known);
+            c.have_tiles = true;
+            for (size_t i = 0; i < fresh.hashes.size(); i++) {
+                c.equal_tiles += c.known.hashes[i] == fresh.hashes[i];
+            }
+        }
+        identical = std::find_if(candidates.begin(), candidates.end(), is_identical);
+    }
+
+    // Every tile hashes equal: identical to a variant, nothing more to decode
+    if (identical != candidates.end()) {
+        result.status = TestStatus::Passed;
+        if (options_.verbose && !identical->tag.empty()) {
+            result.message = "variant " + identical->tag;
+        }
+        report(std::move(result));
+        return;
+    }
+
+    // Nearest variant: the most equal tiles; ties go to this machine's own
+    // variant, then to the plain reference
+    Candidate* nearest = &candidates.front();
+    for (auto& c : candidates) {
+        if (c.equal_tiles > nearest->equal_tiles ||
+            (c.equal_tiles == nearest->equal_tiles && c.tag == options_.variant &&
+             nearest->tag != options_.variant)) {
+            nearest = &c;
+        }
+    }
+    const std::string& ref_path = nearest->path;
+    TileEntry& known = nearest->known;
+    bool have_tiles = nearest->have_tiles;
+
+    // Compare with reference
+    Image reference = std::move(nearest->image);
+    if (reference.empty() && !reference.load_png(ref_path)) {
+        result.status = TestStatus::Error;
+        result.message = "Failed to load reference";
+        report(std::move(result));
+        return;
+    }
+    if (!have_tiles && reference.width() == fresh.width &&
+        reference.height() == fresh.height) {
+        known = fresh;
+        known.hashes = reference.tile_hashes(tile);
+        known.file_hash = TileManifest::file_hash(ref_path);
+        manifest_.update(nearest->key, known);
+        have_tiles = true;
+    }
+
+    // With tile hashes only the tiles whose hashes differ are compared pixel
+    // by pixel; that already costs no more than building the capture's
+    // pyramid, so the coarse pre-check only runs when the hashes are missing
+    // and would otherwise be followed by a full pass
+    CompareResult cmp;
+    bool rejected = false;
+    if (!have_tiles) {
+        uint32_t allowed = test->allowed_diff_percent() > 0
+            ? Compare::allowed_differing(captured.width() * captured.height(),
+                                         test->allowed_diff_percent())
+            : 0;
+        std::error_code ec;
+        auto mtime = fs::last_write_time(ref_path, ec);
+        std::string key = ref_path + "@" + std::to_string(mtime.time_since_epoch().count());
+        rejected = Compare::pyramid_reject(reference, captured, test->tolerance(), allowed,
+                                           cmp, key);
+    }
+    if (!rejected) {
+        std::vector<bool> dirty;
+        if (have_tiles) {
+            dirty.resize(fresh.hashes.size());
+            for (size_t i = 0; i < dirty.size(); i++) {
+                dirty[i] = known.hashes[i] != fresh.hashes[i];
+            }
+        }
+        cmp = Compare::fuzzy_tiles(reference, captured, test->tolerance(),
+                                   have_tiles ? tile : 0, dirty);
+        if (test->allowed_diff_percent() > 0) {
+            cmp = Compare::within_percent(std::move(cmp), test->allowed_diff_percent(),
+                                          test->tolerance());
+        }
+    }
+    if (!cmp.match && candidates.size() > 1) {
+        cmp.message += " (nearest of " + std::to_string(candidates.size()) + " variants: " +
+                       (nearest->tag.empty() ? "plain" : nearest->tag) + ")";
+    }
+
+    finish_verify(*test, reference_name, cmp, captured, reference, std::move(result));
+}
+
+void Runner::finish_verify(const TestBase& test, const std::string& reference_name,
+                           const CompareResult& cmp, const Image& captured,
+                           const Image& expected, TestResult result) {
+    if (cmp.match) {
+        result.status = TestStatus::Passed;
+        if (options_.verbose && cmp.different_pixels > 0) {
+            result.message = std::to_string(cmp.different_pixels) + " pixels within tolerance";
+        }
+        report(std::move(result));
+        return;
+    }
+
+    result.status = TestStatus::Failed;
+    result.message = cmp.message;
+
+    if (options_.save_failures) {
+        std::string fail_path = reference_dir() + "/" + reference_name + "_fail.png";
+        std::string diff_path = reference_dir() + "/" + reference_name + "_diff.png";
+
+        captured.save_png(fail_path);
+
+        auto diff = Compare::generate_diff(expected, captured, test.tolerance());
+        diff.save_png(diff_path);
+
+        if (options_.verbose) {
+            result.message += "\n    Saved failure: " + fail_path +
+                              "\n    Saved diff: " + diff_path;
+        }
+    }
+
+    report(std::move(result));
+}
+
+void Runner::report(TestResult result) {
+    std::lock_guard<std::mutex> lock(results_mutex_);
+
+    std::cout << std::left << std::setw(35) << result.name << " ";
+    switch (result.status) {
+        case TestStatus::Passed:
+            std::cout << COLOR_GREEN << "[PASS]" << COLOR_RESET;
+            if (!result.message.empty()) {
+                std::cout << " (" << result.message << ")";
+            }
+            break;
+        case TestStatus::Failed:
+            std::cout << COLOR_RED << "[FAIL]" << COLOR_RESET << " " << result.message;
+            break;
+        case TestStatus::Error:
+            std::cout << COLOR_RED << "[ERROR]" << COLOR_RESET << " " << result.message;
+            break;
+        case TestStatus::Generated:
+            std::cout << COLOR_BLUE << "[GENERATED]" << COLOR_RESET
+                      << " (" << result.message << ")";
+            break;
+        case TestStatus::Unchanged:
+            std::cout << COLOR_GREEN << "[UNCHANGED]" << COLOR_RESET;
+            break;
+        case TestStatus::Timeout:
+            std::cout << COLOR_RED << "[TIMEOUT]" << COLOR_RESET << " " << result.message;
+            break;
+    }
+    if (options_.verbose) {
+        std::cout << " " << std::fixed << std::setprecision(1)
+                  << result.duration_ms << " ms";
+    }
+    std::cout << "\n";
+
+    results_.push_back(std::move(result));
+}
+
+void Runner::print_summary(const std::vector<TestResult>& results, int skipped) {
+    int passed = 0;
+    int failed = 0;
+    std::vector<std::string> changed;
+    for (const auto& result : results) {
+        switch (result.status) {
+            case TestStatus::Passed:
+            case TestStatus::Unchanged:
+                passed++;
+                break;
+            case TestStatus::Generated:
+                passed++;
+                changed.push_back(result.name);
+                break;
+            case TestStatus::Failed:
+            case TestStatus::Error:
+            case TestStatus::Timeout:
+                failed++;
+                break;
+        }
+    }
+
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << COLOR_BOLD << "Summary:" << COLOR_RESET << "\n";
+    std::cout << "  " << COLOR_GREEN << "Passed:  " << passed << COLOR_RESET << "\n";
+    std::cout << "  " << COLOR_RED << "Failed:  " << failed << COLOR_RESET << "\n";
+    if (skipped > 0) {
+        std::cout << "  " << COLOR_YELLOW << "Skipped: " << skipped << COLOR_RESET << "\n";
+    }
+    std::cout << "  Total:   " << (passed + failed + skipped) << "\n";
+
+    if (!changed.empty()) {
+        std::sort(changed.begin(), changed.end());
+        std::cout << "\n" << COLOR_BLUE << "References written (" << changed.size() << "):"
+                  << COLOR_RESET << "\n";
+        for (const auto& name : changed) {
+            std::cout << "  " << name << "\n";
+        }
+    }
+}
+
+} // namespace x11bench
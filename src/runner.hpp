@@ -0,0 +1,157 @@
+#pragma once
+
+#include "capture.hpp"
+#include "compare.hpp"
+#include "display.hpp"
+#include "durations.hpp"
+#include "image.hpp"
+#include "manifest.hpp"
+#include "thread_pool.hpp"
+#include "tests/test_base.hpp"
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+struct RunnerOptions {
+    bool regenerate = false;
+    bool verbose = false;
+    bool save_failures = false;
+    std::string reference_dir = "reference";
+    std::string display_name;
+    unsigned jobs = 1;  // Number of X lanes (one connection + window each)
+    int timeout_ms = 30000;  // Per-test wall time bound (0 = unbounded)
+    int settle_ms = 50;      // Wait after render for pixels to become readable
+    VisualID visual = 0;     // Render through this visual (0 = screen default)
+    std::string visual_tag;  // Reference subdirectory for the visual's format
+    bool atlas = false;      // Pack window tests into tiles of one window per lane
+    bool offscreen = false;  // Render window tests into MIT-SHM pixmaps, read in place
+    std::string variant;     // Reference variant tag --regenerate writes (e.g. "xwayland")
+    std::string tiles_file = ".x11bench-tiles";  // Tile hash cache, one per visual tag
+};
+
+enum class TestStatus {
+    Passed,
+    Failed,
+    Error,
+    Generated,  // Reference written (new or changed pixels)
+    Unchanged,  // Regenerated capture matched the existing reference; not rewritten
+    Timeout     // Watchdog cut the test off; its lane reconnected
+};
+
+inline bool is_failure(TestStatus status) {
+    return status == TestStatus::Failed || status == TestStatus::Error ||
+           status == TestStatus::Timeout;
+}
+
+struct TestResult {
+    std::string name;
+    TestStatus status = TestStatus::Error;
+    std::string message;
+    double duration_ms = 0.0;
+};
+
+// Executes tests across parallel X lanes. Each lane owns its own connection
+// and places its window in a disjoint screen slot; tests that capture the
+// whole screen run afterwards on a dedicated lane with the screen to
+// themselves. Reference I/O and comparison are handed to a CPU thread pool
+// so lanes keep issuing X requests.
+//
+// Tests are assigned longest-first (by recorded duration) to the lane with
+// the least queued work; a lane that runs dry steals from the tail of the
+// busiest lane's queue.
+class Runner {
+public:
+    Runner(const RunnerOptions& options, const DurationHistory& history);
+
+    // Run the given tests; false if the X display could not be opened
+    bool run(const std::vector<TestInfo>& tests);
+
+    // Per-test results in completion order
+    const std::vector<TestResult>& results() const { return results_; }
+
+    // Print the pass/fail summary and the list of rewritten references
+    static void print_summary(const std::vector<TestResult>& results, int skipped);
+
+    // Called on the watchdog thread with every result so far when a lane
+    // can't be recovered, right before the process exits
+    using AbortHandler = std::function<void(const std::vector<TestResult>&)>;
+    void set_abort_handler(AbortHandler handler) { abort_handler_ = std::move(handler); }
+
+private:
+    struct Scheduled {
+        std::shared_ptr<TestBase> test;
+        double estimate_ms = 0.0;
+    };
+
+    struct Lane {
+        Display display;
+        int origin_x = 0;
+        int origin_y = 0;
+        uint32_t slot_width = 0;    // Screen area the lane's window may use
+        uint32_t slot_height = 0;
+
+        // Offscreen target, kept between tests of the same size; declared
+        // after display so it is released first
+        std::unique_ptr<ShmPixmap> offscreen;
+        bool offscreen_active = false;  // The current test draws into it
+
+        // Work queue: owner pops the front, thieves take the back
+        std::mutex mutex;
+        std::deque<Scheduled> queue;
+        double pending_ms = 0.0;
+
+        // Watchdog state; deadline_ns == 0 while the lane is idle
+        std::atomic<int64_t> deadline_ns{0};
+        std::atomic<int64_t> fired_ns{0};
+        std::atomic<bool> timed_out{false};
+        std::atomic<int> fd{-1};
+        std::atomic<const TestBase*> current{nullptr};
+    };
+
+    RunnerOptions options_;
+    const DurationHistory& history_;
+    TileManifest manifest_;
+    ThreadPool pool_;
+
+    // Variant tags on disk per reference name: "<name>~<tag>.png" files
+    std::mutex variants_mutex_;
+    std::map<std::string, std::vector<std::string>> variants_;
+    std::mutex results_mutex_;
+    std::vector<TestResult> results_;
+    AbortHandler abort_handler_;
+
+    std::string reference_dir() const;
+    std::string manifest_path() const;
+    void load_variants();
+    std::vector<std::string> variants_of(const std::string& reference_name);
+    std::string qualified_name(const TestBase& test) const;
+    bool next_test(Lane& lane, std::vector<std::unique_ptr<Lane>>& lanes, Scheduled& out);
+    void watchdog_loop(std::vector<std::unique_ptr<Lane>>& lanes, std::atomic<bool>& watching);
+    [[noreturn]] void abort_run(std::vector<std::unique_ptr<Lane>>& lanes, const Lane& stuck);
+    bool recover_lane(Lane& lane);
+    void run_on_lane(Lane& lane, std::shared_ptr<TestBase> test);
+    void run_scenarios(Lane& lane, const std::vector<std::shared_ptr<TestBase>>& tests);
+    bool fits_atlas(const TestBase& test, const Lane& lane) const;
+    bool fits_offscreen(const TestBase& test, const Lane& lane) const;
+    bool use_offscreen(Lane& lane, const TestBase& test);
+    void run_atlas(Lane& lane, const std::vector<std::shared_ptr<TestBase>>& tests,
+                   const std::vector<XRectangle>& tiles);
+    void run_checkpoint(Lane& lane, std::shared_ptr<TestBase> test, const std::string& label);
+    Image capture_test_window(Lane& lane, const TestBase& test);
+    void verify(std::shared_ptr<TestBase> test, const std::string& reference_name,
+                Image captured, TestResult result);
+    void finish_verify(const TestBase& test, const std::string& reference_name,
+                       const CompareResult& cmp, const Image& captured,
+                       const Image& expected, TestResult result);
+    void report(TestResult result);
+};
+
+} // namespace x11bench
@@ -0,0 +1,185 @@
+#include "scenario.hpp"
+#include "capture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <memory>
+
+#include <poll.h>
+
+namespace x11bench {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Scenarios due within this much of each other share one capture; settles
+// are minimums, so checking a little late is always safe
+const auto COALESCE = std::chrono::milliseconds(25);
+
+struct Slot {
+    Scenario* scenario;
+    size_t index;
+    ScenarioContext ctx;
+    int phase = 0;
+    bool check = false;
+    Clock::time_point due;
+};
+} // namespace
+
+ScenarioScheduler::ScenarioScheduler(Display& display)
+    : display_(display) {
+}
+
+void ScenarioScheduler::run(const std::vector<Scenario*>& scenarios,
+                            const std::function<void(size_t)>& on_done) {
+    captures_ = 0;
+    if (scenarios.empty()) {
+        return;
+    }
+
+    // Cells the size of the largest region, and no more cells than palettes
+    uint32_t cell_width = 1;
+    uint32_t cell_height = 1;
+    int palette_size = 1;
+    int marker_colors = INT_MAX;
+    for (Scenario* scenario : scenarios) {
+        marker_colors = std::min(marker_colors, scenario->marker_colors());
+        cell_width = std::max(cell_width, scenario->region_width());
+        cell_height = std::max(cell_height, scenario->region_height());
+        palette_size = std::max(palette_size, scenario->palette_size());
+    }
+    uint32_t columns = std::max(1u, display_.screen_width() / cell_width);
+    uint32_t rows = std::max(1u, display_.screen_height() / cell_height);
+    size_t cell_count = std::min<size_t>(columns * rows,
+                                         std::max(1, marker_colors / palette_size));
+
+    std::vector<std::unique_ptr<Slot>> cells(cell_count);
+    size_t next = 0;
+    ::Display* dpy = display_.x_display();
+
+    auto finish = [&](std::unique_ptr<Slot>& slot, bool passed) {
+        slot->scenario->finish(slot->ctx, passed);
+        size_t index = slot->index;
+        slot.reset();
+        if (on_done) {
+            on_done(index);
+        }
+    };
+
+    // Start the slot's current phase; the slot is released once there are none left
+    auto advance = [&](std::unique_ptr<Slot>& slot) {
+        ScenarioStep step = slot->scenario->begin_phase(slot->ctx, slot->phase);
+        if (step.settle_ms < 0) {
+            finish(slot, true);
+            return;
+        }
+        slot->check = step.check;
+        slot->due = Clock::now() + std::chrono::milliseconds(step.settle_ms);
+    };
+
+    auto fill_cells = [&]() {
+        for (size_t cell = 0; cell < cells.size(); cell++) {
+            while (!cells[cell] && next < scenarios.size()) {
+                ScenarioContext ctx{display_, static_cast<int>((cell % columns) * cell_width),
+                                    static_cast<int>((cell / columns) * cell_height),
+                                    static_cast<int>(cell) * palette_size};
+                cells[cell].reset(new Slot{scenarios[next], next, ctx, 0, false, Clock::now()});
+                next++;
+                advance(cells[cell]);
+            }
+        }
+    };
+
+    auto dispatch_events = [&]() {
+        while (XPending(dpy) > 0) {
+            XEvent event;
+            XNextEvent(dpy, &event);
+            if (event.type != Expose || event.xexpose.count != 0) {
+                continue;
+            }
+            for (auto& slot : cells) {
+                if (slot && slot->scenario->handle_expose(slot->ctx, event.xexpose.window)) {
+                    break;
+                }
+            }
+        }
+        display_.flush();
+    };
+
+    // Repaint on Expose while waiting for `until`
+    auto wait_until = [&](Clock::time_point until) {
+        while (true) {
+            dispatch_events();
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                until - Clock::now()).count();
+            if (remaining <= 0 || display_.has_io_error()) {
+                break;
+            }
+            pollfd pfd = {ConnectionNumber(dpy), POLLIN, 0};
+            poll(&pfd, 1, static_cast<int>(remaining));
+        }
+    };
+
+    fill_cells();
+    while (true) {
+        display_.flush();
+
+        // Earliest deadline, then everything due shortly after it
+        Clock::time_point earliest = Clock::time_point::max();
+        for (auto& slot : cells) {
+            if (slot) earliest = std::min(earliest, slot->due);
+        }
+        if (earliest == Clock::time_point::max() || display_.has_io_error()) {
+            break;
+        }
+        Clock::time_point until = earliest;
+        for (auto& slot : cells) {
+            if (slot && slot->due <= earliest + COALESCE) until = std::max(until, slot->due);
+        }
+        wait_until(until);
+        display_.sync(false);
+        dispatch_events();
+
+        // One capture covering every due region that wants a check
+        int x0 = INT_MAX, y0 = INT_MAX, x1 = 0, y1 = 0;
+        for (auto& slot : cells) {
+            if (slot && slot->due <= until && slot->check) {
+                x0 = std::min(x0, slot->ctx.origin_x);
+                y0 = std::min(y0, slot->ctx.origin_y);
+                x1 = std::max(x1, slot->ctx.origin_x + static_cast<int>(cell_width));
+                y1 = std::max(y1, slot->ctx.origin_y + static_cast<int>(cell_height));
+            }
+        }
+        Image screen;
+        if (x1 > x0) {
+            x1 = std::min<int>(x1, display_.screen_width());
+            y1 = std::min<int>(y1, display_.screen_height());
+            XImage* ximg = display_.capture_root_region(x0, y0, x1 - x0, y1 - y0);
+            if (ximg) {
+                screen = Capture::ximage_to_image(ximg);
+                XDestroyImage(ximg);
+            }
+            captures_++;
+        }
+
+        for (auto& slot : cells) {
+            if (!slot || slot->due > until) {
+                continue;
+            }
+            if (slot->check) {
+                Image region = screen.crop(slot->ctx.origin_x - x0, slot->ctx.origin_y - y0,
+                                           cell_width, cell_height);
+                if (!slot->scenario->check_phase(slot->ctx, slot->phase, region)) {
+                    finish(slot, false);
+                    continue;
+                }
+            }
+            slot->phase++;
+            advance(slot);
+        }
+        fill_cells();
+    }
+}
+
+} // namespace x11bench
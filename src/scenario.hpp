@@ -0,0 +1,81 @@
+#pragma once
+
+#include "display.hpp"
+#include "image.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// Where a scenario runs: its windows stay inside the screen rectangle at
+// (origin_x, origin_y) and use the marker colors from `palette` onwards, so
+// scenarios in neighbouring regions never see each other's markers.
+struct ScenarioContext {
+    Display& display;
+    int origin_x = 0;
+    int origin_y = 0;
+    int palette = 0;
+};
+
+// What begin_phase() wants next
+struct ScenarioStep {
+    int settle_ms = -1;   // Wait before the check; -1 when there are no more phases
+    bool check = true;    // Capture the region and call check_phase() after the wait
+};
+
+// A window test split into phases. Each phase issues its requests and names
+// a settle time; once it has passed the scheduler captures the scenario's
+// region and hands it to check_phase(). Phases never block, so several
+// scenarios can wait out their settles at the same time.
+class Scenario {
+public:
+    virtual ~Scenario() = default;
+
+    // Size of the screen region the scenario's windows stay inside
+    virtual uint32_t region_width() const { return 400; }
+    virtual uint32_t region_height() const { return 400; }
+
+    // Number of consecutive marker colors the scenario uses, and the size of
+    // the marker set palettes are cut from; the latter limits how many
+    // scenarios run at once
+    virtual int palette_size() const { return 3; }
+    virtual int marker_colors() const { return palette_size(); }
+
+    virtual ScenarioStep begin_phase(ScenarioContext& ctx, int phase) = 0;
+
+    // Verify the capture of the region after `phase`; false fails the scenario
+    virtual bool check_phase(ScenarioContext& ctx, int phase, const Image& region) = 0;
+
+    // Repaint after an Expose; false if `win` isn't one of the scenario's windows
+    virtual bool handle_expose(ScenarioContext& ctx, ::Window win) = 0;
+
+    // Release windows and GCs; `passed` is false if a check failed
+    virtual void finish(ScenarioContext& ctx, bool passed) = 0;
+};
+
+// Runs scenarios concurrently on one connection. The screen is divided into
+// cells of the largest region; each scenario gets a cell and its own palette,
+// and more scenarios than cells run in waves as cells free up. Settles are
+// multiplexed over the connection's event stream (Expose events go to the
+// owning scenario), and every scenario due at the same time is checked from
+// one capture of the screen.
+class ScenarioScheduler {
+public:
+    explicit ScenarioScheduler(Display& display);
+
+    // Run all scenarios to completion; on_done(i) fires as scenario i
+    // finishes. A broken connection ends the run with scenarios unfinished.
+    void run(const std::vector<Scenario*>& scenarios,
+             const std::function<void(size_t)>& on_done = nullptr);
+
+    // Screen captures taken by the last run()
+    int captures() const { return captures_; }
+
+private:
+    Display& display_;
+    int captures_ = 0;
+};
+
+} // namespace x11bench
@@ -0,0 +1,324 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace x11bench {
+
+namespace {
+// True if pid runs `program`, so a lease naming a recycled pid isn't trusted
+bool runs_program(pid_t pid, const std::string& program) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/cmdline");
+    std::string argv0;
+    if (!in || !std::getline(in, argv0, '\0')) {
+        return false;
+    }
+    auto base = [](const std::string& path) {
+        auto slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    };
+    return base(argv0) == base(program);
+}
+} // namespace
+
+XServer::XServer(const ServerOptions& options)
+    : options_(options) {
+}
+
+XServer::~XServer() {
+    stop();
+}
+
+bool XServer::parse_screen(const std::string& spec, ServerOptions& options) {
+    unsigned width = 0, height = 0;
+    int depth = options.depth;
+    int fields = std::sscanf(spec.c_str(), "%ux%ux%d", &width, &height, &depth);
+    if (fields < 2 || width == 0 || height == 0) {
+        return false;
+    }
+    if (depth != 8 && depth != 15 && depth != 16 && depth != 24 && depth != 30 && depth != 32) {
+        return false;
+    }
+    options.width = width;
+    options.height = height;
+    options.depth = depth;
+    return true;
+}
+
+std::string XServer::screen_spec(int depth) const {
+    return std::to_string(options_.width) + "x" + std::to_string(options_.height) +
+           "x" + std::to_string(depth);
+}
+
+std::string XServer::screens_spec() const {
+    if (options_.screen_depths.empty()) {
+        return screen_spec(options_.depth);
+    }
+    std::string spec;
+    for (int depth : options_.screen_depths) {
+        spec += (spec.empty() ? "" : ",") + screen_spec(depth);
+    }
+    return spec;
+}
+
+int XServer::screen_count() const {
+    return options_.screen_depths.empty() ? 1 : static_cast<int>(options_.screen_depths.size());
+}
+
+std::string XServer::lease_path() const {
+    if (!options_.lease_file.empty()) {
+        return options_.lease_file;
+    }
+    const char* runtime = std::getenv("XDG_RUNTIME_DIR");
+    std::string dir = runtime && *runtime ? runtime : "/tmp";
+
+    // One lease per configuration, so runs with different servers or
+    // geometries keep warm servers side by side
+    std::string key = options_.program + "-" + screens_spec();
+    for (char& c : key) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '.') {
+            c = '_';
+        }
+    }
+    return dir + "/x11bench-" + std::to_string(getuid()) + "-" + key + ".lease";
+}
+
+bool XServer::start() {
+    auto begin = std::chrono::steady_clock::now();
+
+    leased_ = options_.reuse;
+    bool ok = (options_.reuse && try_reuse()) || launch();
+
+    startup_ms_ = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    if (ok && leased_ && !reused_) {
+        write_lease();
+    }
+    return ok;
+}
+
+bool XServer::try_reuse() {
+    std::ifstream in(lease_path());
+    if (!in) {
+        return false;
+    }
+
+    std::map<std::string, std::string> lease;
+    std::string line;
+    while (std::getline(in, line)) {
+        auto eq = line.find('=');
+        if (eq != std::string::npos) {
+            lease[line.substr(0, eq)] = line.substr(eq + 1);
+        }
+    }
+
+    pid_t pid = static_cast<pid_t>(std::atol(lease["pid"].c_str()));
+    const std::string& display = lease["display"];
+    bool alive = pid > 0 && kill(pid, 0) == 0 && runs_program(pid, lease["program"]);
+
+    // The server owns its socket for as long as it accepts connections
+    std::string socket = "/tmp/.X11-unix/X" + (display.empty() ? "" : display.substr(1));
+    struct stat st;
+    bool listening = !display.empty() && stat(socket.c_str(), &st) == 0;
+
+    if (!alive || !listening) {
+        std::remove(lease_path().c_str());  // Stale lease
+        return false;
+    }
+    if (lease["program"] != options_.program || lease["screen"] != screens_spec()) {
+        // An explicit --lease-file names another configuration's server,
+        // which may be in use. Leave it and its lease alone; this run's
+        // server is an ordinary one, stopped on exit.
+        leased_ = false;
+        return false;
+    }
+
+    display_name_ = display;
+    pid_ = pid;
+    reused_ = true;
+    return true;
+}
+
+bool XServer::launch() {
+    // Close-on-exec keeps the read end out of the server; the child clears it
+    // on the write end it reports through
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        error_ = std::string("pipe: ") + std::strerror(errno);
+        return false;
+    }
+
+    std::string displayfd = std::to_string(fds[1]);
+    std::vector<std::string> args = {options_.program, "-displayfd", displayfd, "-nolisten", "tcp"};
+    if (options_.program == "Xvnc") {
+        args.push_back("-geometry");
+        args.push_back(std::to_string(options_.width) + "x" + std::to_string(options_.height));
+        args.push_back("-depth");
+        args.push_back(std::to_string(options_.depth));
+        args.push_back("-SecurityTypes");
+        args.push_back("None");
+    } else if (options_.program == "Xephyr") {
+        args.push_back("-screen");
+        args.push_back(screen_spec(options_.depth));
+    } else if (!options_.screen_depths.empty()) {
+        // One screen per depth lets a single server cover a depth matrix
+        for (size_t i = 0; i < options_.screen_depths.size(); i++) {
+            args.push_back("-screen");
+            args.push_back(std::to_string(i));
+            args.push_back(screen_spec(options_.screen_depths[i]));
+        }
+    } else {
+        args.push_back("-screen");
+        args.push_back("0");
+        args.push_back(screen_spec(options_.depth));
+    }
+    if (leased_) {
+        // A leased server outlives many clients; don't reset on last close
+        args.push_back("-noreset");
+    }
+
+    pid_t parent = getpid();
+    pid_t pid = fork();
+    if (pid < 0) {
+        error_ = std::string("fork: ") + std::strerror(errno);
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        fcntl(fds[1], F_SETFD, 0);
+        if (leased_) {
+            setsid();  // Survive the terminal's SIGINT so the lease stays valid
+        } else {
+            // Don't outlive an aborted run
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent) {
+                _exit(127);
+            }
+        }
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+        }
+
+        std::vector<char*> argv;
+        for (auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(fds[1]);
+    pid_ = pid;
+
+    // The server writes "<display number>\n" once it is ready
+    std::string number;
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(options_.startup_timeout_ms);
+    while (number.find('\n') == std::string::npos) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            error_ = options_.program + " did not report a display within " +
+                     std::to_string(options_.startup_timeout_ms) + " ms";
+            break;
+        }
+
+        struct pollfd pfd = {fds[0], POLLIN, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(remaining));
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+
+        char buf[32];
+        ssize_t n = read(fds[0], buf, sizeof(buf));
+        if (n <= 0) {
+            error_ = options_.program + " exited during startup";
+            break;
+        }
+        number.append(buf, static_cast<size_t>(n));
+    }
+    close(fds[0]);
+
+    if (number.find('\n') == std::string::npos) {
+        if (error_.empty()) {
+            error_ = options_.program + " failed to start";
+        }
+        stop();
+        return false;
+    }
+
+    number.erase(number.find('\n'));
+    display_name_ = ":" + number;
+    return true;
+}
+
+void XServer::write_lease() const {
+    std::string path = lease_path();
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            return;
+        }
+        out << "pid=" << pid_ << "\n"
+            << "display=" << display_name_ << "\n"
+            << "program=" << options_.program << "\n"
+            << "screen=" << screens_spec() << "\n";
+    }
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+void XServer::stop() {
+    if (pid_ <= 0) {
+        return;
+    }
+    if (reused_ || (leased_ && !display_name_.empty())) {
+        // Leased server: leave it warm for the next run
+        pid_ = -1;
+        return;
+    }
+
+    kill(pid_, SIGTERM);
+
+    // Give the server a moment to exit cleanly before forcing it
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (waitpid(pid_, nullptr, WNOHANG) == 0) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            kill(pid_, SIGKILL);
+            waitpid(pid_, nullptr, 0);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    pid_ = -1;
+}
+
+} // namespace x11bench
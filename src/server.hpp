@@ -0,0 +1,73 @@
+#pragma once
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+struct ServerOptions {
+    std::string program = "Xvfb";   // Xvfb, Xephyr or Xvnc
+    uint32_t width = 1024;
+    uint32_t height = 768;
+    int depth = 24;
+    std::vector<int> screen_depths; // Xvfb only: one screen per depth instead of one at depth
+    bool reuse = false;             // Keep the server alive and record it in a lease file
+    std::string lease_file;         // Empty selects a per-user, per-configuration path
+    int startup_timeout_ms = 10000;
+};
+
+// Launches and owns a headless X server. Startup uses -displayfd, so the
+// server picks a free display number and reports it once it is accepting
+// connections: no fixed :99, no polling for the socket.
+//
+// With reuse enabled, a lease file per program and geometry records the
+// running server; later runs with the same configuration connect to it
+// instead of starting a new one, and the server is left running on exit.
+// Servers of other configurations are never touched.
+class XServer {
+public:
+    explicit XServer(const ServerOptions& options);
+    ~XServer();
+
+    // Non-copyable
+    XServer(const XServer&) = delete;
+    XServer& operator=(const XServer&) = delete;
+
+    // Reuse a leased server or launch a new one
+    bool start();
+
+    // Terminate the server if this process owns it and reuse is off
+    void stop();
+
+    const std::string& display_name() const { return display_name_; }
+    const std::string& error() const { return error_; }
+    bool reused() const { return reused_; }
+    pid_t pid() const { return pid_; }
+    double startup_ms() const { return startup_ms_; }
+
+    // Number of screens the server was configured with (":N.0" ... ":N.k")
+    int screen_count() const;
+
+    // Parse "WIDTHxHEIGHTxDEPTH" (depth optional) into options
+    static bool parse_screen(const std::string& spec, ServerOptions& options);
+
+private:
+    ServerOptions options_;
+    std::string display_name_;
+    std::string error_;
+    pid_t pid_ = -1;
+    bool reused_ = false;
+    bool leased_ = false;           // This run's server is (or will be) the lease's
+    double startup_ms_ = 0.0;
+
+    std::string lease_path() const;
+    std::string screen_spec(int depth) const;
+    std::string screens_spec() const;
+    bool try_reuse();
+    bool launch();
+    void write_lease() const;
+};
+
+} // namespace x11bench
@@ -1,4 +1,5 @@
 #include "test_base.hpp"
+#include <algorithm>
 #include <cstring>
 #include <cmath>
 
@@ -25,10 +26,21 @@ public:
         display.set_function(GXxor);
         display.set_foreground(0, 0, 255);
         display.draw_rectangle(100, 100, 150, 150, true);
+        checkpoint(display, "xor_once");
+
+        // XOR is its own inverse: the same rectangle again restores the
+        // red square on white
+        display.draw_rectangle(100, 100, 150, 150, true);
 
         // Reset to normal copy mode
         display.set_function(GXcopy);
     }
+
+    Expectation expected() const override {
+        return Expectation()
+            .fill(0, 0, width(), height(), 255, 255, 255)
+            .fill(50, 50, 150, 150, 255, 0, 0);
+    }
 };
 REGISTER_TEST(TestXorDraw)
 
@@ -474,18 +486,14 @@ public:
 
     void render(Display& display) override {
         // Define clip regions
-        XRectangle clips[] = {
-            {20, 20, 80, 80},
-            {120, 20, 80, 80},
-            {20, 120, 80, 80},
-            {120, 120, 80, 80},
-        };
+        XRectangle clips[4];
+        std::copy(std::begin(CLIPS), std::end(CLIPS), clips);
 
         display.set_clip_rectangles(0, 0, clips, 4, Unsorted);
 
         // Draw diagonal gradient - only visible in clip regions
         for (int i = 0; i < (int)(width() + height()); i += 2) {
-            uint8_t c = (i * 255) / (width() + height());
+            uint8_t c = shade(i);
             display.set_foreground(c, c, 255 - c);
             display.draw_line(i, 0, 0, i);
         }
@@ -499,6 +507,39 @@ public:
             display.draw_rectangle(r.x, r.y, r.width, r.height, false);
         }
     }
+
+    // Gradient colors round to the visual's channel width; a 5-bit channel
+    // comes back up to 8 off
+    int tolerance() const override { return 8; }
+
+    // White window background and red outlines. Line i of the gradient is the
+    // 45-degree diagonal x + y = i, so inside each outline the pixels with an
+    // even x + y carry that line's color and the odd ones stay white.
+    Expectation expected() const override {
+        Expectation spec;
+        spec.fill(0, 0, width(), height(), 255, 255, 255);
+        for (const auto& r : CLIPS) {
+            // draw_rectangle's outline spans width x height pixels
+            spec.outline(r.x, r.y, r.width - 1, r.height - 1, 255, 0, 0);
+            for (int y = r.y + 1; y < r.y + r.height - 1; y++) {
+                for (int x = r.x + 1 + (r.x + 1 + y) % 2; x < r.x + r.width - 1; x += 2) {
+                    uint8_t c = shade(x + y);
+                    spec.fill(x, y, 1, 1, c, c, 255 - c);
+                }
+            }
+        }
+        return spec;
+    }
+
+private:
+    uint8_t shade(int i) const { return (i * 255) / (width() + height()); }
+
+    static constexpr XRectangle CLIPS[] = {
+        {20, 20, 80, 80},
+        {120, 20, 80, 80},
+        {20, 120, 80, 80},
+        {120, 120, 80, 80},
+    };
 };
 REGISTER_TEST(TestClipRectangles)
 
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "../display.hpp"
+#include "../expectation.hpp"
 #include "../image.hpp"
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
 
 namespace x11bench {
 
+class Scenario;
+
 class TestBase {
 public:
     virtual ~TestBase() = default;
@@ -29,6 +33,15 @@ public:
     // Optional: percentage (0-100) of pixels allowed to differ by more than tolerance()
     virtual double allowed_diff_percent() const { return 0.0; }
 
+    // Optional: the expected frame as geometry (see expectation.hpp). A
+    // non-empty expectation replaces the PNG reference for the final frame;
+    // tolerance() and allowed_diff_percent() apply as usual.
+    virtual Expectation expected() const { return {}; }
+
+    // Capture through XRender into an a8r8g8b8 pixmap so the reference holds
+    // the drawable's real alpha instead of a guess from spare pixel bits
+    virtual bool exact_alpha() const { return false; }
+
     // Screen capture mode: if true, capture from root window at test_region()
     // instead of capturing the test window. Used for multi-window tests.
     virtual bool captures_screen() const { return false; }
@@ -46,6 +59,27 @@ public:
     // For self-verifying tests: check if the test passed and why it failed
     virtual bool test_passed() const { return false; }
     virtual std::string failure_reason() const { return ""; }
+
+    // Screen-capturing tests that are also scenarios run concurrently with
+    // each other, each in its own screen region (see scenario.hpp)
+    virtual Scenario* scenario() { return nullptr; }
+
+    // Called from render() to verify an intermediate state: the window is
+    // captured now and compared against its own reference "<name>@<label>",
+    // reported as a separate result. The final frame after render() is still
+    // compared against "<name>". Labels must be unique within a test.
+    void checkpoint(Display& display, const std::string& label) {
+        if (checkpoint_hook_) {
+            checkpoint_hook_(display, label);
+        }
+    }
+
+    // Installed by the runner around render()
+    using CheckpointHook = std::function<void(Display&, const std::string&)>;
+    void set_checkpoint_hook(CheckpointHook hook) { checkpoint_hook_ = std::move(hook); }
+
+private:
+    CheckpointHook checkpoint_hook_;
 };
 
 // Factory function type for creating tests
@@ -34,6 +34,7 @@ public:
     }
 
     int tolerance() const override { return 2; }  // Alpha blending may have rounding
+    bool exact_alpha() const override { return true; }
 };
 REGISTER_TEST(TestAlphaRectangles)
 
@@ -67,6 +68,7 @@ public:
     }
 
     int tolerance() const override { return 3; }
+    bool exact_alpha() const override { return true; }
 };
 REGISTER_TEST(TestAlphaGradient)
 
@@ -103,6 +105,7 @@ public:
     }
 
     int tolerance() const override { return 3; }
+    bool exact_alpha() const override { return true; }
 };
 REGISTER_TEST(TestLayeredAlpha)
 
@@ -153,6 +156,7 @@ public:
     }
 
     int tolerance() const override { return 1; }
+    bool exact_alpha() const override { return true; }
 };
 REGISTER_TEST(TestRenderFillColors)
 
@@ -185,6 +189,7 @@ public:
     }
 
     int tolerance() const override { return 2; }
+    bool exact_alpha() const override { return true; }
 };
 REGISTER_TEST(TestAlphaBlendModes)
 
@@ -24,6 +24,10 @@ public:
         display.set_foreground(255, 0, 0);
         display.draw_rectangle(0, 0, width(), height(), true);
     }
+
+    Expectation expected() const override {
+        return Expectation().fill(0, 0, width(), height(), 255, 0, 0);
+    }
 };
 REGISTER_TEST(TestSolidRed)
 
@@ -69,6 +73,12 @@ public:
         display.draw_rectangle(width() / 4, height() / 4,
                                width() / 2, height() / 2, true);
     }
+
+    Expectation expected() const override {
+        return Expectation()
+            .fill(0, 0, width(), height(), 255, 255, 255)
+            .fill(width() / 4, height() / 4, width() / 2, height() / 2, 255, 0, 0);
+    }
 };
 REGISTER_TEST(TestFilledRectangle)
 
@@ -122,6 +132,21 @@ public:
             }
         }
     }
+
+    Expectation expected() const override {
+        const uint8_t colors[][3] = {
+            {255, 0, 0}, {0, 255, 0}, {0, 0, 255},
+            {255, 255, 0}, {255, 0, 255}, {0, 255, 255},
+        };
+        Expectation spec;
+        spec.fill(0, 0, width(), height(), 0, 0, 0);
+        for (int i = 0; i < 6; i++) {
+            int inset = 20 * (i + 1);
+            spec.fill(inset, inset, width() - 2 * inset, height() - 2 * inset,
+                      colors[i][0], colors[i][1], colors[i][2]);
+        }
+        return spec;
+    }
 };
 REGISTER_TEST(TestNestedRectangles)
 
@@ -268,6 +293,18 @@ public:
             }
         }
     }
+
+    Expectation expected() const override {
+        const uint32_t cell_size = 32;
+        Expectation spec;
+        for (uint32_t y = 0; y < height(); y += cell_size) {
+            for (uint32_t x = 0; x < width(); x += cell_size) {
+                uint8_t v = ((x / cell_size) + (y / cell_size)) % 2 == 0 ? 255 : 0;
+                spec.fill(x, y, cell_size, cell_size, v, v, v);
+            }
+        }
+        return spec;
+    }
 };
 REGISTER_TEST(TestCheckerboard)
 
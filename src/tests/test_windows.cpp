@@ -1,8 +1,6 @@
 #include "test_base.hpp"
-#include "../capture.hpp"
-#include <thread>
-#include <chrono>
-#include <stdexcept>
+#include "../scenario.hpp"
+#include <algorithm>
 
 namespace x11bench {
 
@@ -19,7 +17,11 @@ struct WindowMarker {
     const char* name;
 };
 
-// Predefined markers - distinct colors that are easy to detect
+// Predefined markers - distinct colors that are easy to detect. Channels are
+// 0, 128 or 255, so any two markers differ by at least 127 in some channel;
+// each has a 0 or 255 channel, which a window background (marker / 2 + 64)
+// never comes within detection tolerance of. Concurrent scenarios each take
+// a consecutive run of these as their palette.
 static const WindowMarker MARKERS[] = {
     {255, 0, 0, "RED"},       // Window 0 - Pure Red
     {0, 255, 0, "GREEN"},     // Window 1 - Pure Green
@@ -29,8 +31,26 @@ static const WindowMarker MARKERS[] = {
     {0, 255, 255, "CYAN"},    // Window 5 - Cyan
     {255, 128, 0, "ORANGE"},  // Window 6 - Orange
     {128, 0, 255, "PURPLE"},  // Window 7 - Purple
+    {128, 0, 0, "MAROON"},
+    {0, 128, 0, "DARK_GREEN"},
+    {0, 0, 128, "NAVY"},
+    {128, 128, 0, "OLIVE"},
+    {128, 0, 128, "PLUM"},
+    {0, 128, 128, "TEAL"},
+    {255, 0, 128, "ROSE"},
+    {128, 255, 0, "LIME"},
+    {0, 255, 128, "SPRING"},
+    {0, 128, 255, "AZURE"},
+    {255, 128, 128, "SALMON"},
+    {128, 255, 128, "MINT"},
+    {128, 128, 255, "LAVENDER"},
+    {255, 255, 128, "CREAM"},
+    {255, 128, 255, "ORCHID"},
+    {128, 255, 255, "ICE"},
 };
 
+static const int MARKER_COUNT = sizeof(MARKERS) / sizeof(MARKERS[0]);
+
 static const int MARKER_SIZE = 16;  // Size of the identification marker
 static const int MARKER_BORDER = 2; // White border around marker for detection
 
@@ -41,7 +61,7 @@ enum MarkerCorner { TOP_LEFT = 0, TOP_RIGHT, BOTTOM_LEFT, BOTTOM_RIGHT };
 static void draw_window_pattern(Display& display, ::Window win, GC gc,
                                  int marker_id, int win_width, int win_height,
                                  MarkerCorner corner = TOP_LEFT) {
-    const WindowMarker& marker = MARKERS[marker_id % 8];
+    const WindowMarker& marker = MARKERS[marker_id % MARKER_COUNT];
 
     // Fill window with a lighter version of the marker color as background
     display.draw_rectangle_on(win, gc, 0, 0, win_width, win_height, true,
@@ -91,90 +111,16 @@ struct WindowPattern {
     MarkerCorner corner = TOP_LEFT;
 };
 
-// Helper to wait for window operations and handle Expose events
-static void settle_and_redraw(Display& display,
-                               const std::vector<WindowPattern>& windows,
-                               int ms = 150) {
-    display.flush();
-    display.sync(false);
-
-    auto start = std::chrono::steady_clock::now();
-
-    while (true) {
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::steady_clock::now() - start).count();
-        if (elapsed >= ms) break;
-
-        // Check for pending events
-        while (XPending(display.x_display()) > 0) {
-            XEvent event;
-            XNextEvent(display.x_display(), &event);
-
-            if (event.type == Expose && event.xexpose.count == 0) {
-                // Find the window that needs redraw
-                for (const auto& wp : windows) {
-                    if (event.xexpose.window == wp.win) {
-                        draw_window_pattern(display, wp.win, wp.gc,
-                                          wp.marker_id, wp.width, wp.height, wp.corner);
-                        display.flush();
-                        break;
-                    }
-                }
-            }
-        }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-
-    display.sync(false);
-}
-
-// Simple settle without redraw handling
-static void settle(Display& display, int ms = 150) {
-    display.flush();
-    display.sync(false);
-    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-    display.sync(false);
-    display.process_pending_events();
-}
-
-// Convert XImage to Image
-static Image ximage_to_image(XImage* ximg) {
-    if (!ximg) return Image();
-
-    uint32_t width = ximg->width;
-    uint32_t height = ximg->height;
-    Image img(width, height);
-
-    for (uint32_t y = 0; y < height; y++) {
-        for (uint32_t x = 0; x < width; x++) {
-            unsigned long pixel = XGetPixel(ximg, x, y);
-            uint8_t r, g, b;
-
-            if (ximg->bits_per_pixel == 32) {
-                if (ximg->byte_order == LSBFirst) {
-                    b = (pixel >> 0) & 0xFF;
-                    g = (pixel >> 8) & 0xFF;
-                    r = (pixel >> 16) & 0xFF;
-                } else {
-                    r = (pixel >> 16) & 0xFF;
-                    g = (pixel >> 8) & 0xFF;
-                    b = (pixel >> 0) & 0xFF;
-                }
-            } else {
-                r = g = b = pixel & 0xFF;
-            }
-            img.set_pixel(x, y, r, g, b, 255);
-        }
-    }
-    return img;
-}
-
 // Scan image to find if a marker is visible anywhere
 static bool find_marker_in_image(const Image& img, int marker_id, int* out_x = nullptr, int* out_y = nullptr) {
-    const WindowMarker& marker = MARKERS[marker_id % 8];
+    const WindowMarker& marker = MARKERS[marker_id % MARKER_COUNT];
     int tolerance = 40;  // Increased tolerance
 
+    if (img.width() < MARKER_SIZE + MARKER_BORDER * 2 ||
+        img.height() < MARKER_SIZE + MARKER_BORDER * 2) {
+        return false;
+    }
+
     // Scan the image looking for the marker color directly
     // Instead of looking for white border first, scan for the marker color itself
     for (uint32_t y = MARKER_BORDER; y < img.height() - MARKER_SIZE - MARKER_BORDER; y += 2) {
@@ -217,7 +163,11 @@ static bool find_marker_in_image(const Image& img, int marker_id, int* out_x = n
 // =============================================================================
 // Self-Verifying Window Test Base
 // =============================================================================
-class WindowTestBase : public TestBase {
+// Window tests are scenarios: each phase maps, restacks or destroys windows,
+// names a settle time and checks a capture of the test's own screen region.
+// The runner hands all of them to one ScenarioScheduler so they run side by
+// side; render() runs a single test through the same scheduler.
+class WindowTestBase : public TestBase, public Scenario {
 public:
     // Window tests don't use reference images - they self-verify
     bool captures_screen() const override { return true; }
@@ -226,41 +176,123 @@ public:
     // Return a special tolerance that signals self-verification
     int tolerance() const override { return -1; }  // Special value
 
-    // The render function should set test_passed_ based on verification
     bool test_passed() const override { return test_passed_; }
     std::string failure_reason() const override { return failure_reason_; }
 
+    Scenario* scenario() override { return this; }
+    int marker_colors() const override { return MARKER_COUNT; }
+
+    void render(Display& display) override {
+        ScenarioScheduler scheduler(display);
+        scheduler.run({this});
+
+        // Draw result indicator in main window
+        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
+        display.draw_rectangle(0, 0, width(), height(), true);
+    }
+
+    ScenarioStep begin_phase(ScenarioContext& ctx, int phase) override {
+        if (phase == 0) {
+            test_passed_ = false;
+            failure_reason_.clear();
+        }
+        return run_phase(ctx, phase);
+    }
+
+    bool handle_expose(ScenarioContext& ctx, ::Window win) override {
+        for (const auto& wp : windows_) {
+            if (wp.win == win) {
+                draw_window_pattern(ctx.display, wp.win, wp.gc, wp.marker_id,
+                                    wp.width, wp.height, wp.corner);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void finish(ScenarioContext& ctx, bool passed) override {
+        test_passed_ = passed;
+        for (const auto& wp : windows_) {
+            ctx.display.free_gc(wp.gc);
+            ctx.display.destroy_child_window(wp.win);
+        }
+        windows_.clear();
+    }
+
 protected:
     mutable bool test_passed_ = false;
     mutable std::string failure_reason_;
+    std::vector<WindowPattern> windows_;
+
+    // Issue the requests of `phase`; wait() or done()
+    virtual ScenarioStep run_phase(ScenarioContext& ctx, int phase) = 0;
+
+    static ScenarioStep wait(int ms, bool check = true) { return {ms, check}; }
+    static ScenarioStep done() { return {}; }
+
+    // Create (unmapped) the window wearing the scenario's marker `index`, at
+    // (x, y) relative to the scenario's region
+    ::Window add_window(ScenarioContext& ctx, int index, int w, int h, int x, int y,
+                        MarkerCorner corner = TOP_LEFT) {
+        std::string title = std::string("Win-") + MARKERS[(ctx.palette + index) % MARKER_COUNT].name;
+        ::Window win = ctx.display.create_child_window(w, h, ctx.origin_x + x, ctx.origin_y + y,
+                                                       title);
+        GC gc = ctx.display.create_gc_for_window(win);
+        windows_.push_back({win, gc, ctx.palette + index, w, h, corner});
+        return win;
+    }
+
+    // Destroy a window before the scenario ends
+    void remove_window(ScenarioContext& ctx, ::Window win) {
+        auto it = std::find_if(windows_.begin(), windows_.end(),
+                               [win](const WindowPattern& wp) { return wp.win == win; });
+        if (it != windows_.end()) {
+            ctx.display.free_gc(it->gc);
+            ctx.display.destroy_child_window(it->win);
+            windows_.erase(it);
+        }
+    }
 
-    // Capture the full screen and return as Image
-    Image capture_screen(Display& display) const {
-        XImage* ximg = display.capture_root_region(0, 0,
-            display.screen_width(), display.screen_height());
-        if (!ximg) {
-            return Image();
+    void show_all(ScenarioContext& ctx) {
+        for (const auto& wp : windows_) {
+            ctx.display.show_child_window(wp.win);
         }
-        Image img = ximage_to_image(ximg);
-        XDestroyImage(ximg);
-        return img;
+    }
+
+    // Paint every window; anything lost before the map lands comes back
+    // through Expose
+    void draw_all(ScenarioContext& ctx) {
+        for (const auto& wp : windows_) {
+            draw_window_pattern(ctx.display, wp.win, wp.gc, wp.marker_id,
+                                wp.width, wp.height, wp.corner);
+        }
+    }
+
+    bool visible(const ScenarioContext& ctx, const Image& region, int index) const {
+        return find_marker_in_image(region, ctx.palette + index);
+    }
+
+    std::string marker_name(const ScenarioContext& ctx, int index) const {
+        return MARKERS[(ctx.palette + index) % MARKER_COUNT].name;
     }
 
     // Verify that a marker IS visible
-    bool verify_visible(const Image& screen, int marker_id, const char* context) const {
-        if (!find_marker_in_image(screen, marker_id)) {
-            failure_reason_ = std::string(context) + ": " +
-                MARKERS[marker_id % 8].name + " window should be visible but wasn't found";
+    bool verify_visible(const ScenarioContext& ctx, const Image& region, int index,
+                        const char* context) const {
+        if (!visible(ctx, region, index)) {
+            failure_reason_ = std::string(context) + ": " + marker_name(ctx, index) +
+                              " window should be visible but wasn't found";
             return false;
         }
         return true;
     }
 
     // Verify that a marker is NOT visible
-    bool verify_hidden(const Image& screen, int marker_id, const char* context) const {
-        if (find_marker_in_image(screen, marker_id)) {
-            failure_reason_ = std::string(context) + ": " +
-                MARKERS[marker_id % 8].name + " window should be hidden but was found";
+    bool verify_hidden(const ScenarioContext& ctx, const Image& region, int index,
+                       const char* context) const {
+        if (visible(ctx, region, index)) {
+            failure_reason_ = std::string(context) + ": " + marker_name(ctx, index) +
+                              " window should be hidden but was found";
             return false;
         }
         return true;
@@ -270,60 +302,44 @@ protected:
 // =============================================================================
 // Window Stacking Tests
 // =============================================================================
+// Marker 0 is the first window of the scenario's palette (RED when it runs
+// alone), marker 1 the second (GREEN), marker 2 the third (BLUE).
 
 class TestWinStackBasic : public WindowTestBase {
 public:
     std::string name() const override { return "win_stack_basic"; }
     std::string description() const override { return "Basic window stacking - later window on top"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        // Create two overlapping windows
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1-Red");
-        ::Window win2 = display.create_child_window(200, 200, 150, 150, "Win2-Green");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},
-            {win2, gc2, 1, 200, 200}
-        };
-
-        // Map win1 first, then win2 - win2 should be on top
-        display.show_child_window(win1);
-        settle_and_redraw(display, windows);
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);  // RED
-
-        display.show_child_window(win2);
-        settle_and_redraw(display, windows);
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);  // GREEN
-
-        settle_and_redraw(display, windows, 200);
-
-        // Capture screen
-        Image screen = capture_screen(display);
-
-        // Verify: GREEN (win2) should be visible
-        bool green_visible = find_marker_in_image(screen, 1);  // GREEN
-
-        if (!green_visible) {
-            failure_reason_ = "GREEN window (win2) not visible - should be on top";
-        } else {
-            test_passed_ = true;
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                // Create two overlapping windows; map win1 first
+                win1_ = add_window(ctx, 0, 200, 200, 100, 100);
+                win2_ = add_window(ctx, 1, 200, 200, 150, 150);
+                ctx.display.show_child_window(win1_);
+                draw_all(ctx);
+                return wait(150, false);
+            case 1:
+                // Then win2 - it should be on top
+                ctx.display.show_child_window(win2_);
+                draw_all(ctx);
+                return wait(350);
+            default:
+                return done();
         }
+    }
 
-        // Cleanup
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-
-        // Draw result indicator in main window
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int, const Image& region) override {
+        if (!visible(ctx, region, 1)) {
+            failure_reason_ = marker_name(ctx, 1) + " window (win2) not visible - should be on top";
+            return false;
+        }
+        return true;
     }
+
+private:
+    ::Window win1_ = 0;
+    ::Window win2_ = 0;
 };
 REGISTER_TEST(TestWinStackBasic)
 
@@ -332,61 +348,31 @@ public:
     std::string name() const override { return "win_raise"; }
     std::string description() const override { return "XRaiseWindow brings window to front"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        // Create two overlapping windows at same position
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1-Red");
-        ::Window win2 = display.create_child_window(200, 200, 100, 100, "Win2-Green");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-
-        // Track windows for Expose event handling
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},  // RED
-            {win2, gc2, 1, 200, 200}   // GREEN
-        };
-
-        // Show both - win2 on top
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);  // RED
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);  // GREEN
-        settle_and_redraw(display, windows, 200);
-
-        // Verify GREEN is visible (on top)
-        Image screen1 = capture_screen(display);
-        if (!find_marker_in_image(screen1, 1)) {
-            failure_reason_ = "Initial: GREEN should be visible";
-            goto cleanup;
-        }
-
-        // Raise win1 (RED) to top
-        display.raise_child_window(win1);
-        settle_and_redraw(display, windows, 250);
-
-        // Verify RED is now visible
-        {
-            Image screen2 = capture_screen(display);
-            if (!find_marker_in_image(screen2, 0)) {
-                failure_reason_ = "After raise: RED should be visible";
-                goto cleanup;
-            }
-            test_passed_ = true;
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                // Two overlapping windows at same position, win2 on top
+                win1_ = add_window(ctx, 0, 200, 200, 100, 100);
+                add_window(ctx, 1, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350);
+            case 1:
+                // Raise win1 to top
+                ctx.display.raise_child_window(win1_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-    cleanup:
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int phase, const Image& region) override {
+        return phase == 0 ? verify_visible(ctx, region, 1, "Initial")
+                          : verify_visible(ctx, region, 0, "After raise");
     }
+
+private:
+    ::Window win1_ = 0;
 };
 REGISTER_TEST(TestWinRaise)
 
@@ -395,47 +381,29 @@ public:
     std::string name() const override { return "win_lower"; }
     std::string description() const override { return "XLowerWindow sends window to back"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1-Red");
-        ::Window win2 = display.create_child_window(200, 200, 100, 100, "Win2-Green");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},
-            {win2, gc2, 1, 200, 200}
-        };
-
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);
-        settle_and_redraw(display, windows, 200);
-
-        // Lower win2 (GREEN) - RED should become visible
-        display.lower_child_window(win2);
-        settle_and_redraw(display, windows, 250);
-
-        Image screen = capture_screen(display);
-        if (find_marker_in_image(screen, 0)) {
-            test_passed_ = true;
-        } else {
-            failure_reason_ = "After lower: RED window should be visible";
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                add_window(ctx, 0, 200, 200, 100, 100);
+                win2_ = add_window(ctx, 1, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350, false);
+            case 1:
+                // Lower win2 - win1 should become visible
+                ctx.display.lower_child_window(win2_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int, const Image& region) override {
+        return verify_visible(ctx, region, 0, "After lower");
     }
+
+private:
+    ::Window win2_ = 0;
 };
 REGISTER_TEST(TestWinLower)
 
@@ -444,50 +412,30 @@ public:
     std::string name() const override { return "win_hide"; }
     std::string description() const override { return "XUnmapWindow hides window"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1-Red");
-        ::Window win2 = display.create_child_window(200, 200, 100, 100, "Win2-Green");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},
-            {win2, gc2, 1, 200, 200}
-        };
-
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);
-        settle_and_redraw(display, windows, 200);
-
-        // Hide win2 - win1 should become visible
-        display.hide_child_window(win2);
-        settle_and_redraw(display, windows, 250);
-
-        Image screen = capture_screen(display);
-        bool red_visible = find_marker_in_image(screen, 0);
-        bool green_visible = find_marker_in_image(screen, 1);
-
-        if (red_visible && !green_visible) {
-            test_passed_ = true;
-        } else {
-            failure_reason_ = "After hide: RED should be visible, GREEN should not";
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                add_window(ctx, 0, 200, 200, 100, 100);
+                win2_ = add_window(ctx, 1, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350, false);
+            case 1:
+                // Hide win2 - win1 should become visible
+                ctx.display.hide_child_window(win2_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int, const Image& region) override {
+        return verify_visible(ctx, region, 0, "After hide") &&
+               verify_hidden(ctx, region, 1, "After hide");
     }
+
+private:
+    ::Window win2_ = 0;
 };
 REGISTER_TEST(TestWinHide)
 
@@ -496,60 +444,35 @@ public:
     std::string name() const override { return "win_show_after_hide"; }
     std::string description() const override { return "XMapWindow shows hidden window"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        ::Window win = display.create_child_window(200, 200, 100, 100, "Win-Red");
-        GC gc = display.create_gc_for_window(win);
-
-        std::vector<WindowPattern> windows = {{win, gc, 0, 200, 200}};
-
-        display.show_child_window(win);
-        settle_and_redraw(display, windows);
-        draw_window_pattern(display, win, gc, 0, 200, 200);
-        settle_and_redraw(display, windows, 200);
-
-        // Verify visible
-        Image screen1 = capture_screen(display);
-        if (!find_marker_in_image(screen1, 0)) {
-            failure_reason_ = "Initial: window should be visible";
-            goto cleanup;
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                win_ = add_window(ctx, 0, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350);
+            case 1:
+                ctx.display.hide_child_window(win_);
+                return wait(200);
+            case 2:
+                // Show again; the Expose repaints it
+                ctx.display.show_child_window(win_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-        // Hide
-        display.hide_child_window(win);
-        settle(display, 200);
-
-        // Verify hidden
-        {
-            Image screen2 = capture_screen(display);
-            if (find_marker_in_image(screen2, 0)) {
-                failure_reason_ = "After hide: window should not be visible";
-                goto cleanup;
-            }
+    bool check_phase(ScenarioContext& ctx, int phase, const Image& region) override {
+        switch (phase) {
+            case 0: return verify_visible(ctx, region, 0, "Initial");
+            case 1: return verify_hidden(ctx, region, 0, "After hide");
+            default: return verify_visible(ctx, region, 0, "After show");
         }
-
-        // Show again
-        display.show_child_window(win);
-        settle_and_redraw(display, windows, 250);
-
-        // Verify visible again
-        {
-            Image screen3 = capture_screen(display);
-            if (find_marker_in_image(screen3, 0)) {
-                test_passed_ = true;
-            } else {
-                failure_reason_ = "After show: window should be visible again";
-            }
-        }
-
-    cleanup:
-        display.free_gc(gc);
-        display.destroy_child_window(win);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
     }
+
+private:
+    ::Window win_ = 0;
 };
 REGISTER_TEST(TestWinShowAfterHide)
 
@@ -558,51 +481,30 @@ public:
     std::string name() const override { return "win_destroy"; }
     std::string description() const override { return "XDestroyWindow removes window"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1-Red");
-        ::Window win2 = display.create_child_window(200, 200, 100, 100, "Win2-Green");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},
-            {win2, gc2, 1, 200, 200}
-        };
-
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);
-        settle_and_redraw(display, windows, 200);
-
-        // Destroy win2 - win1 should become visible
-        display.free_gc(gc2);
-        display.destroy_child_window(win2);
-        // Update windows list - only win1 remains
-        windows = {{win1, gc1, 0, 200, 200}};
-        settle_and_redraw(display, windows, 250);
-
-        Image screen = capture_screen(display);
-        bool red_visible = find_marker_in_image(screen, 0);
-        bool green_visible = find_marker_in_image(screen, 1);
-
-        if (red_visible && !green_visible) {
-            test_passed_ = true;
-        } else {
-            failure_reason_ = "After destroy: RED visible, GREEN gone";
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                add_window(ctx, 0, 200, 200, 100, 100);
+                win2_ = add_window(ctx, 1, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350, false);
+            case 1:
+                // Destroy win2 - win1 should become visible
+                remove_window(ctx, win2_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-        display.free_gc(gc1);
-        display.destroy_child_window(win1);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int, const Image& region) override {
+        return verify_visible(ctx, region, 0, "After destroy") &&
+               verify_hidden(ctx, region, 1, "After destroy");
     }
+
+private:
+    ::Window win2_ = 0;
 };
 REGISTER_TEST(TestWinDestroy)
 
@@ -611,61 +513,34 @@ public:
     std::string name() const override { return "win_three_stack"; }
     std::string description() const override { return "Three stacked windows with all markers visible"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        // Three windows at same position but very different sizes
-        // Largest at bottom, smallest on top - all markers should be visible
-        ::Window win1 = display.create_child_window(300, 300, 50, 50, "Win1");   // Largest (bottom)
-        ::Window win2 = display.create_child_window(180, 180, 50, 50, "Win2");   // Medium
-        ::Window win3 = display.create_child_window(60, 60, 50, 50, "Win3");     // Smallest (top)
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-        GC gc3 = display.create_gc_for_window(win3);
-
-        // Draw markers at different corners so they're all visible
-        // RED (largest): bottom-right, GREEN (medium): bottom-left, BLUE (smallest): top-left
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 300, 300, BOTTOM_RIGHT},
-            {win2, gc2, 1, 180, 180, BOTTOM_LEFT},
-            {win3, gc3, 2, 60, 60, TOP_LEFT}
-        };
-
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        display.show_child_window(win3);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 300, 300, BOTTOM_RIGHT);  // RED (largest)
-        draw_window_pattern(display, win2, gc2, 1, 180, 180, BOTTOM_LEFT);   // GREEN (medium)
-        draw_window_pattern(display, win3, gc3, 2, 60, 60, TOP_LEFT);        // BLUE (smallest)
-        settle_and_redraw(display, windows, 250);
-
-        // All three markers should be visible due to size differences
-        Image screen = capture_screen(display);
-        bool red = find_marker_in_image(screen, 0);
-        bool green = find_marker_in_image(screen, 1);
-        bool blue = find_marker_in_image(screen, 2);
-
-        if (red && green && blue) {
-            test_passed_ = true;
-        } else {
-            failure_reason_ = "Missing markers:";
-            if (!red) failure_reason_ += " RED";
-            if (!green) failure_reason_ += " GREEN";
-            if (!blue) failure_reason_ += " BLUE";
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        if (phase > 0) {
+            return done();
         }
 
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.free_gc(gc3);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-        display.destroy_child_window(win3);
+        // Three windows at same position but very different sizes. Largest
+        // at bottom, smallest on top; markers at different corners so all
+        // three stay visible
+        add_window(ctx, 0, 300, 300, 50, 50, BOTTOM_RIGHT);  // Largest (bottom)
+        add_window(ctx, 1, 180, 180, 50, 50, BOTTOM_LEFT);   // Medium
+        add_window(ctx, 2, 60, 60, 50, 50, TOP_LEFT);        // Smallest (top)
+        show_all(ctx);
+        draw_all(ctx);
+        return wait(400);
+    }
 
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int, const Image& region) override {
+        std::string missing;
+        for (int i = 0; i < 3; i++) {
+            if (!visible(ctx, region, i)) {
+                missing += " " + marker_name(ctx, i);
+            }
+        }
+        if (!missing.empty()) {
+            failure_reason_ = "Missing markers:" + missing;
+            return false;
+        }
+        return true;
     }
 };
 REGISTER_TEST(TestWinThreeStack)
@@ -675,65 +550,32 @@ public:
     std::string name() const override { return "win_restack_middle"; }
     std::string description() const override { return "Raise middle window to top of three"; }
 
-    void render(Display& display) override {
-        test_passed_ = false;
-
-        // Three windows at same position - only top one's marker visible
-        ::Window win1 = display.create_child_window(200, 200, 100, 100, "Win1");
-        ::Window win2 = display.create_child_window(200, 200, 100, 100, "Win2");
-        ::Window win3 = display.create_child_window(200, 200, 100, 100, "Win3");
-
-        GC gc1 = display.create_gc_for_window(win1);
-        GC gc2 = display.create_gc_for_window(win2);
-        GC gc3 = display.create_gc_for_window(win3);
-
-        std::vector<WindowPattern> windows = {
-            {win1, gc1, 0, 200, 200},
-            {win2, gc2, 1, 200, 200},
-            {win3, gc3, 2, 200, 200}
-        };
-
-        display.show_child_window(win1);
-        display.show_child_window(win2);
-        display.show_child_window(win3);
-        settle_and_redraw(display, windows);
-
-        draw_window_pattern(display, win1, gc1, 0, 200, 200);  // RED
-        draw_window_pattern(display, win2, gc2, 1, 200, 200);  // GREEN
-        draw_window_pattern(display, win3, gc3, 2, 200, 200);  // BLUE
-        settle_and_redraw(display, windows, 200);
-
-        // Initially BLUE should be on top
-        Image screen1 = capture_screen(display);
-        if (!find_marker_in_image(screen1, 2)) {
-            failure_reason_ = "Initial: BLUE should be visible";
-            goto cleanup;
-        }
-
-        // Raise RED to top
-        display.raise_child_window(win1);
-        settle_and_redraw(display, windows, 250);
-
-        {
-            Image screen2 = capture_screen(display);
-            if (find_marker_in_image(screen2, 0)) {
-                test_passed_ = true;
-            } else {
-                failure_reason_ = "After raise: RED should be visible";
-            }
+    ScenarioStep run_phase(ScenarioContext& ctx, int phase) override {
+        switch (phase) {
+            case 0:
+                // Three windows at same position - only top one's marker visible
+                win1_ = add_window(ctx, 0, 200, 200, 100, 100);
+                add_window(ctx, 1, 200, 200, 100, 100);
+                add_window(ctx, 2, 200, 200, 100, 100);
+                show_all(ctx);
+                draw_all(ctx);
+                return wait(350);
+            case 1:
+                // Raise the bottom window to top
+                ctx.display.raise_child_window(win1_);
+                return wait(250);
+            default:
+                return done();
         }
+    }
 
-    cleanup:
-        display.free_gc(gc1);
-        display.free_gc(gc2);
-        display.free_gc(gc3);
-        display.destroy_child_window(win1);
-        display.destroy_child_window(win2);
-        display.destroy_child_window(win3);
-
-        display.set_foreground(test_passed_ ? 0 : 255, test_passed_ ? 255 : 0, 0);
-        display.draw_rectangle(0, 0, width(), height(), true);
+    bool check_phase(ScenarioContext& ctx, int phase, const Image& region) override {
+        return phase == 0 ? verify_visible(ctx, region, 2, "Initial")
+                          : verify_visible(ctx, region, 0, "After raise");
     }
+
+private:
+    ::Window win1_ = 0;
 };
 REGISTER_TEST(TestWinRestackMiddle)
 
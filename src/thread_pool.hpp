@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace x11bench {
+
+// Fixed-size pool of worker threads for CPU-bound work that does not touch
+// the X connection (PNG encode/decode, hashing, image comparison).
+class ThreadPool {
+public:
+    // threads == 0 selects std::thread::hardware_concurrency()
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    // Non-copyable
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a job for execution on any worker
+    void submit(std::function<void()> job);
+
+    // Block until every submitted job has finished
+    void wait();
+
+    size_t size() const { return workers_.size(); }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable job_available_;
+    std::condition_variable idle_;
+    size_t active_ = 0;
+    bool stopping_ = false;
+
+    void worker_loop();
+};
+
+} // namespace x11bench
@@ -0,0 +1,967 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <thread>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Xlibint exposes the connection's sequence numbers and XID range; it also
+// defines min/max macros that would break the standard headers above
+#include <X11/Xlib.h>
+#include <X11/Xlibint.h>
+#undef min
+#undef max
+
+namespace x11bench {
+
+namespace {
+// Version 2 adds the interned atoms; version 1 files load without them
+const char TRACE_MAGIC[8] = {'X', '1', '1', 'B', 'T', 'R', 'C', '2'};
+const char TRACE_MAGIC_V1[8] = {'X', '1', '1', 'B', 'T', 'R', 'C', '1'};
+
+const uint8_t X_INTERN_ATOM = 16;
+const uint8_t X_GET_ATOM_NAME = 17;
+const uint8_t X_QUERY_EXTENSION = 98;
+const uint8_t X_GET_INPUT_FOCUS = 43;
+
+// Atoms up to XA_LAST_PREDEFINED are the same on every server
+const uint32_t LAST_PREDEFINED_ATOM = 68;
+
+size_t pad4(size_t n) {
+    return (n + 3) & ~size_t(3);
+}
+
+bool host_lsb_first() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+uint16_t get16(const uint8_t* p, bool lsb) {
+    return lsb ? uint16_t(p[0] | (p[1] << 8)) : uint16_t((p[0] << 8) | p[1]);
+}
+
+uint32_t get32(const uint8_t* p, bool lsb) {
+    return lsb ? uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24
+               : uint32_t(p[3]) | uint32_t(p[2]) << 8 | uint32_t(p[1]) << 16 | uint32_t(p[0]) << 24;
+}
+
+void put32(uint8_t* p, uint32_t v, bool lsb) {
+    for (int i = 0; i < 4; i++) {
+        p[lsb ? i : 3 - i] = static_cast<uint8_t>(v >> (8 * i));
+    }
+}
+
+// Trace files are little-endian regardless of host
+void write_u32(std::ostream& out, uint32_t v) {
+    uint8_t b[4];
+    put32(b, v, true);
+    out.write(reinterpret_cast<const char*>(b), 4);
+}
+
+void write_u64(std::ostream& out, uint64_t v) {
+    write_u32(out, static_cast<uint32_t>(v));
+    write_u32(out, static_cast<uint32_t>(v >> 32));
+}
+
+bool read_u32(std::istream& in, uint32_t& v) {
+    uint8_t b[4];
+    if (!in.read(reinterpret_cast<char*>(b), 4)) return false;
+    v = get32(b, true);
+    return true;
+}
+
+bool read_u64(std::istream& in, uint64_t& v) {
+    uint32_t lo, hi;
+    if (!read_u32(in, lo) || !read_u32(in, hi)) return false;
+    v = uint64_t(hi) << 32 | lo;
+    return true;
+}
+
+// ":N", ":N.S", "unix:N" -> N; -1 for anything not on a local Unix socket
+int local_display_number(const std::string& name) {
+    std::string rest;
+    if (!name.empty() && name[0] == ':') {
+        rest = name.substr(1);
+    } else if (name.rfind("unix:", 0) == 0) {
+        rest = name.substr(5);
+    } else {
+        return -1;
+    }
+    if (rest.empty() || !std::isdigit(static_cast<unsigned char>(rest[0]))) {
+        return -1;
+    }
+    return std::atoi(rest.c_str());
+}
+
+// =============================================================================
+// Core request layouts
+// =============================================================================
+// Replay only rewrites words the protocol defines as resources or atoms, so
+// image data, property payloads and coordinates that happen to equal an XID
+// go through untouched.
+
+enum class Field {
+    Resource,   // WINDOW, DRAWABLE, PIXMAP, GC, FONT, CURSOR, COLORMAP, ...
+    Created,    // Resource the request creates
+    Atom,
+    FontShift   // PolyText font switch: a FONT always sent MSB first
+};
+using FieldList = std::vector<std::pair<size_t, Field>>;
+
+// Value-list bits holding resources: background-pixmap, border-pixmap,
+// colormap and cursor of a window; tile, stipple, font and clip-mask of a GC;
+// sibling of ConfigureWindow
+const uint32_t WINDOW_VALUE_RESOURCES = 1u << 0 | 1u << 2 | 1u << 13 | 1u << 14;
+const uint32_t GC_VALUE_RESOURCES = 1u << 10 | 1u << 11 | 1u << 14 | 1u << 19;
+const uint32_t CONFIGURE_VALUE_RESOURCES = 1u << 5;
+
+// Property types whose 32-bit data are atoms or resources
+const std::set<uint32_t> ATOM_TYPES = {4 /* ATOM */};
+const std::set<uint32_t> RESOURCE_TYPES = {5 /* BITMAP */, 7 /* COLORMAP */, 8 /* CURSOR */,
+                                           17 /* DRAWABLE */, 18 /* FONT */, 20 /* PIXMAP */,
+                                           33 /* WINDOW */};
+
+// One value per bit set in mask, in bit order
+void value_list(FieldList& fields, size_t offset, uint32_t mask, uint32_t resources) {
+    for (int bit = 0; bit < 32; bit++) {
+        if (mask & (1u << bit)) {
+            if (resources & (1u << bit)) {
+                fields.push_back({offset, Field::Resource});
+            }
+            offset += 4;
+        }
+    }
+}
+
+// Resource and atom fields of core request p, by byte offset. Fields may lie
+// past the end of a malformed request; the caller bounds-checks them.
+FieldList core_fields(const uint8_t* p, size_t size, bool lsb) {
+    FieldList f;
+    auto at = [&](size_t offset, Field kind) { f.push_back({offset, kind}); };
+    auto word = [&](size_t offset) { return offset + 4 <= size ? get32(p + offset, lsb) : 0; };
+    switch (p[0]) {
+        case 1:   // CreateWindow
+            at(4, Field::Created);
+            at(8, Field::Resource);
+            value_list(f, 32, word(28), WINDOW_VALUE_RESOURCES);
+            break;
+        case 2:   // ChangeWindowAttributes
+            at(4, Field::Resource);
+            value_list(f, 12, word(8), WINDOW_VALUE_RESOURCES);
+            break;
+        case 7:   // ReparentWindow
+        case 40:  // TranslateCoordinates
+        case 41:  // WarpPointer
+        case 57:  // CopyGC
+            at(4, Field::Resource);
+            at(8, Field::Resource);
+            break;
+        case 12:  // ConfigureWindow; the mask is 16 bits
+            at(4, Field::Resource);
+            value_list(f, 12, size >= 10 ? get16(p + 8, lsb) : 0, CONFIGURE_VALUE_RESOURCES);
+            break;
+        case 17:  // GetAtomName
+        case 23:  // GetSelectionOwner
+            at(4, Field::Atom);
+            break;
+        case 18: {  // ChangeProperty
+            at(4, Field::Resource);
+            at(8, Field::Atom);
+            at(12, Field::Atom);
+            uint32_t type = word(12);
+            bool atoms = ATOM_TYPES.count(type) > 0;
+            if (size >= 17 && p[16] == 32 && (atoms || RESOURCE_TYPES.count(type))) {
+                uint32_t count = word(20);
+                for (uint32_t i = 0; i < count; i++) {
+                    at(24 + 4 * size_t(i), atoms ? Field::Atom : Field::Resource);
+                }
+            }
+            break;
+        }
+        case 19:  // DeleteProperty
+            at(4, Field::Resource);
+            at(8, Field::Atom);
+            break;
+        case 20:  // GetProperty
+            at(4, Field::Resource);
+            at(8, Field::Atom);
+            at(12, Field::Atom);
+            break;
+        case 22:  // SetSelectionOwner
+            at(4, Field::Resource);
+            at(8, Field::Atom);
+            break;
+        case 24:  // ConvertSelection
+            at(4, Field::Resource);
+            at(8, Field::Atom);
+            at(12, Field::Atom);
+            at(16, Field::Atom);
+            break;
+        case 25:  // SendEvent; only ClientMessage contents are known here
+            at(8, Field::Resource);
+            if (size >= 44 && (p[16] & 0x7f) == 33) {
+                at(20, Field::Resource);
+                at(24, Field::Atom);
+            }
+            break;
+        case 26:  // GrabPointer
+            at(4, Field::Resource);
+            at(16, Field::Resource);
+            at(20, Field::Resource);
+            break;
+        case 28:  // GrabButton
+            at(4, Field::Resource);
+            at(12, Field::Resource);
+            at(16, Field::Resource);
+            break;
+        case 45:  // OpenFont
+        case 93:  // CreateCursor
+        case 94:  // CreateGlyphCursor
+            at(4, Field::Created);
+            if (p[0] != 45) {
+                at(8, Field::Resource);
+                at(12, Field::Resource);
+            }
+            break;
+        case 53:  // CreatePixmap
+        case 78:  // CreateColormap
+        case 80:  // CopyColormapAndFree
+            at(4, Field::Created);
+            at(8, Field::Resource);
+            break;
+        case 55:  // CreateGC
+            at(4, Field::Created);
+            at(8, Field::Resource);
+            value_list(f, 16, word(12), GC_VALUE_RESOURCES);
+            break;
+        case 56:  // ChangeGC
+            at(4, Field::Resource);
+            value_list(f, 12, word(8), GC_VALUE_RESOURCES);
+            break;
+        case 62:  // CopyArea
+        case 63:  // CopyPlane
+            at(4, Field::Resource);
+            at(8, Field::Resource);
+            at(12, Field::Resource);
+            break;
+        case 64: case 65: case 66: case 67: case 68: case 69: case 70: case 71:
+        case 72:  // Poly*, FillPoly, PutImage: drawable and gc
+        case 76: case 77:  // ImageText8/16
+            at(4, Field::Resource);
+            at(8, Field::Resource);
+            break;
+        case 74: case 75: {  // PolyText8/16: font switches among the items
+            at(4, Field::Resource);
+            at(8, Field::Resource);
+            size_t pos = 16;
+            size_t width = p[0] == 74 ? 1 : 2;
+            while (pos + 1 < size) {
+                uint8_t length = p[pos];
+                if (length == 255) {
+                    at(pos + 1, Field::FontShift);
+                    pos += 5;
+                } else {
+                    pos += 2 + length * width;
+                }
+            }
+            break;
+        }
+        case 97:  // QueryBestSize
+            at(8, Field::Resource);
+            break;
+        case 114: {  // RotateProperties
+            at(4, Field::Resource);
+            uint32_t count = size >= 10 ? get16(p + 8, lsb) : 0;
+            for (uint32_t i = 0; i < count; i++) {
+                at(12 + 4 * size_t(i), Field::Atom);
+            }
+            break;
+        }
+        // Requests whose only resource is the one at offset 4
+        case 3: case 4: case 5: case 6: case 8: case 9: case 10: case 11: case 13:
+        case 14: case 15: case 21: case 29: case 30: case 31: case 33: case 34:
+        case 38: case 39: case 42: case 46: case 47: case 48: case 54: case 58:
+        case 59: case 60: case 61: case 73: case 79: case 81: case 82: case 83:
+        case 84: case 85: case 86: case 87: case 88: case 89: case 90: case 91:
+        case 92: case 95: case 96: case 113:
+            at(4, Field::Resource);
+            break;
+        default:
+            break;  // No resources or atoms
+    }
+    return f;
+}
+
+std::string socket_path(int display_number) {
+    return "/tmp/.X11-unix/X" + std::to_string(display_number);
+}
+
+int connect_unix(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool write_all(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+} // namespace
+
+// =============================================================================
+// Trace file
+// =============================================================================
+
+bool Trace::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+
+    out.write(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    write_u32(out, lsb_first ? 1 : 0);
+    write_u32(out, resource_base);
+    write_u32(out, resource_mask);
+    write_u32(out, root);
+
+    write_u32(out, static_cast<uint32_t>(extensions.size()));
+    for (const auto& [major, name] : extensions) {
+        write_u32(out, major);
+        write_u32(out, static_cast<uint32_t>(name.size()));
+        out.write(name.data(), name.size());
+    }
+
+    write_u32(out, static_cast<uint32_t>(atoms.size()));
+    for (const auto& [atom, name] : atoms) {
+        write_u32(out, atom);
+        write_u32(out, static_cast<uint32_t>(name.size()));
+        out.write(name.data(), name.size());
+    }
+
+    write_u32(out, static_cast<uint32_t>(requests.size()));
+    for (const auto& request : requests) {
+        write_u64(out, request.time_us);
+        write_u32(out, static_cast<uint32_t>(request.bytes.size()));
+        out.write(reinterpret_cast<const char*>(request.bytes.data()), request.bytes.size());
+    }
+    return static_cast<bool>(out);
+}
+
+bool Trace::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+
+    char magic[sizeof(TRACE_MAGIC)];
+    if (!in.read(magic, sizeof(magic))) {
+        return false;
+    }
+    bool v1 = std::memcmp(magic, TRACE_MAGIC_V1, sizeof(magic)) == 0;
+    if (!v1 && std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    uint32_t lsb, count;
+    if (!read_u32(in, lsb) || !read_u32(in, resource_base) ||
+        !read_u32(in, resource_mask) || !read_u32(in, root) || !read_u32(in, count)) {
+        return false;
+    }
+    lsb_first = lsb != 0;
+
+    extensions.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t major, length;
+        if (!read_u32(in, major) || !read_u32(in, length) || length > 256) return false;
+        std::string name(length, '\0');
+        if (!in.read(&name[0], length)) return false;
+        extensions[static_cast<uint8_t>(major)] = name;
+    }
+
+    atoms.clear();
+    if (!v1) {
+        if (!read_u32(in, count)) return false;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t atom, length;
+            if (!read_u32(in, atom) || !read_u32(in, length) || length > 65535) return false;
+            std::string name(length, '\0');
+            if (!in.read(&name[0], length)) return false;
+            atoms[atom] = name;
+        }
+    }
+
+    if (!read_u32(in, count)) return false;
+    requests.clear();
+    requests.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        TraceRequest request;
+        uint32_t length;
+        if (!read_u64(in, request.time_us) || !read_u32(in, length) || length < 4) return false;
+        request.bytes.resize(length);
+        if (!in.read(reinterpret_cast<char*>(request.bytes.data()), length)) return false;
+        requests.push_back(std::move(request));
+    }
+    return true;
+}
+
+// =============================================================================
+// Recording proxy
+// =============================================================================
+
+TraceRecorder::TraceRecorder(const RecordOptions& options)
+    : options_(options) {
+}
+
+bool TraceRecorder::run() {
+    std::string upstream = options_.upstream_display;
+    if (upstream.empty()) {
+        const char* env = std::getenv("DISPLAY");
+        upstream = env ? env : "";
+    }
+    int upstream_number = local_display_number(upstream);
+    if (upstream_number < 0) {
+        error_ = "upstream display '" + upstream + "' is not a local Unix-socket display";
+        return false;
+    }
+    if (upstream_number == options_.listen_display) {
+        error_ = "proxy display must differ from the upstream display";
+        return false;
+    }
+
+    // A peer hanging up should end the session, not the process
+    signal(SIGPIPE, SIG_IGN);
+
+    // Refuse to take over the socket of a live display
+    std::string listen_path = socket_path(options_.listen_display);
+    int probe = connect_unix(listen_path);
+    if (probe >= 0) {
+        close(probe);
+        error_ = "display :" + std::to_string(options_.listen_display) + " is in use";
+        return false;
+    }
+    unlink(listen_path.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, listen_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listener, 1) != 0) {
+        error_ = "cannot listen on " + listen_path + ": " + std::strerror(errno);
+        if (listener >= 0) close(listener);
+        return false;
+    }
+
+    pid_t child = -1;
+    if (!options_.command.empty()) {
+        child = fork();
+        if (child == 0) {
+            std::string display = ":" + std::to_string(options_.listen_display);
+            setenv("DISPLAY", display.c_str(), 1);
+            std::vector<char*> argv;
+            for (auto& arg : options_.command) {
+                argv.push_back(const_cast<char*>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+    }
+
+    // Wait for the client (or for the launched command to give up)
+    int client = -1;
+    while (client < 0) {
+        struct pollfd pfd = {listener, POLLIN, 0};
+        if (poll(&pfd, 1, 200) > 0) {
+            client = accept(listener, nullptr, nullptr);
+        } else if (child > 0 && waitpid(child, nullptr, WNOHANG) == child) {
+            child = -1;
+            error_ = "client exited without connecting";
+            break;
+        }
+    }
+    close(listener);
+    unlink(listen_path.c_str());
+    if (client < 0) {
+        return false;
+    }
+
+    int server = connect_unix(socket_path(upstream_number));
+    if (server < 0) {
+        error_ = "cannot connect to upstream display " + upstream;
+        close(client);
+        return false;
+    }
+
+    std::vector<uint8_t> client_buf;
+    std::vector<uint8_t> server_buf;
+    bool client_setup_done = false;
+    bool server_setup_done = false;
+    bool lsb = true;
+    uint64_t sequence = 0;
+    std::map<uint64_t, std::string> pending_extensions;  // Sequence -> QueryExtension name
+    std::map<uint64_t, std::string> pending_interns;     // Sequence -> InternAtom name
+    std::map<uint64_t, uint32_t> pending_names;          // Sequence -> GetAtomName atom
+    uint64_t last_reply_seq = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // Split the client stream into setup + requests
+    auto parse_client = [&]() {
+        size_t pos = 0;
+        while (true) {
+            const uint8_t* p = client_buf.data() + pos;
+            size_t avail = client_buf.size() - pos;
+            if (!client_setup_done) {
+                if (avail < 12) break;
+                lsb = p[0] == 'l';
+                trace_.lsb_first = lsb;
+                size_t total = 12 + pad4(get16(p + 6, lsb)) + pad4(get16(p + 8, lsb));
+                if (avail < total) break;
+                pos += total;
+                client_setup_done = true;
+                continue;
+            }
+
+            if (avail < 4) break;
+            size_t total = size_t(get16(p + 2, lsb)) * 4;
+            if (total == 0) {  // BIG-REQUESTS extended length
+                if (avail < 8) break;
+                total = size_t(get32(p + 4, lsb)) * 4;
+            }
+            if (total < 4 || avail < total) break;
+
+            sequence++;
+            TraceRequest request;
+            request.time_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            request.bytes.assign(p, p + total);
+            if (p[0] == X_QUERY_EXTENSION && total >= 8) {
+                size_t length = std::min<size_t>(get16(p + 4, lsb), total - 8);
+                pending_extensions[sequence] = std::string(reinterpret_cast<const char*>(p + 8), length);
+            } else if (p[0] == X_INTERN_ATOM && total >= 8) {
+                size_t length = std::min<size_t>(get16(p + 4, lsb), total - 8);
+                pending_interns[sequence] = std::string(reinterpret_cast<const char*>(p + 8), length);
+            } else if (p[0] == X_GET_ATOM_NAME && total >= 8) {
+                pending_names[sequence] = get32(p + 4, lsb);
+            }
+            trace_.requests.push_back(std::move(request));
+            pos += total;
+        }
+        client_buf.erase(client_buf.begin(), client_buf.begin() + pos);
+    };
+
+    // Track the setup reply and QueryExtension replies
+    auto parse_server = [&]() {
+        size_t pos = 0;
+        while (true) {
+            const uint8_t* p = server_buf.data() + pos;
+            size_t avail = server_buf.size() - pos;
+            if (!server_setup_done) {
+                if (avail < 8) break;
+                size_t total = 8 + size_t(get16(p + 6, lsb)) * 4;
+                if (avail < total) break;
+                if (p[0] == 1 && total >= 40) {
+                    trace_.resource_base = get32(p + 12, lsb);
+                    trace_.resource_mask = get32(p + 16, lsb);
+                    size_t root_offset = 40 + pad4(get16(p + 24, lsb)) + 8 * size_t(p[29]);
+                    if (root_offset + 4 <= total) {
+                        trace_.root = get32(p + root_offset, lsb);
+                    }
+                }
+                pos += total;
+                server_setup_done = true;
+                continue;
+            }
+
+            if (avail < 32) break;
+            size_t total = 32;
+            if (p[0] == 1 || (p[0] & 0x7f) == 35) {  // Reply or GenericEvent
+                total += size_t(get32(p + 4, lsb)) * 4;
+            }
+            if (avail < total) break;
+
+            if (p[0] == 1) {
+                // Widen the 16-bit wire sequence against the last one seen
+                uint64_t seq = (last_reply_seq & ~uint64_t(0xffff)) | get16(p + 2, lsb);
+                if (seq < last_reply_seq) seq += 0x10000;
+                last_reply_seq = seq;
+
+                auto it = pending_extensions.find(seq);
+                if (it != pending_extensions.end()) {
+                    if (p[8]) {
+                        trace_.extensions[p[9]] = it->second;
+                    }
+                    pending_extensions.erase(it);
+                }
+                auto intern = pending_interns.find(seq);
+                if (intern != pending_interns.end()) {
+                    uint32_t atom = get32(p + 8, lsb);
+                    if (atom > LAST_PREDEFINED_ATOM) {
+                        trace_.atoms[atom] = intern->second;
+                    }
+                    pending_interns.erase(intern);
+                }
+                auto named = pending_names.find(seq);
+                if (named != pending_names.end()) {
+                    size_t length = std::min<size_t>(get16(p + 8, lsb), total - 32);
+                    if (named->second > LAST_PREDEFINED_ATOM) {
+                        trace_.atoms[named->second] =
+                            std::string(reinterpret_cast<const char*>(p + 32), length);
+                    }
+                    pending_names.erase(named);
+                }
+            }
+            pos += total;
+        }
+        server_buf.erase(server_buf.begin(), server_buf.begin() + pos);
+    };
+
+    uint8_t buf[65536];
+    bool open = true;
+    while (open) {
+        struct pollfd fds[2] = {{client, POLLIN, 0}, {server, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(client, buf, sizeof(buf));
+            if (n <= 0 || !write_all(server, buf, static_cast<size_t>(n))) {
+                open = false;
+            } else {
+                client_buf.insert(client_buf.end(), buf, buf + n);
+                parse_client();
+            }
+        }
+        if (open && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t n = read(server, buf, sizeof(buf));
+            if (n <= 0 || !write_all(client, buf, static_cast<size_t>(n))) {
+                open = false;
+            } else {
+                server_buf.insert(server_buf.end(), buf, buf + n);
+                parse_server();
+            }
+        }
+    }
+
+    close(client);
+    close(server);
+    if (child > 0) {
+        waitpid(child, nullptr, 0);
+    }
+
+    if (!trace_.save(options_.output)) {
+        error_ = "cannot write " + options_.output;
+        return false;
+    }
+    return true;
+}
+
+// =============================================================================
+// Replay
+// =============================================================================
+
+TraceReplayer::TraceReplayer(const Trace& trace, const ReplayOptions& options)
+    : trace_(trace), options_(options) {
+}
+
+bool TraceReplayer::run(ReplayStats& stats) {
+    if (trace_.lsb_first != host_lsb_first()) {
+        error_ = "trace byte order differs from this host";
+        return false;
+    }
+
+    const char* name = options_.display_name.empty() ? nullptr : options_.display_name.c_str();
+    ::Display* dpy = XOpenDisplay(name);
+    if (!dpy) {
+        error_ = "cannot open display";
+        return false;
+    }
+
+    // Extension opcodes are assigned per server
+    std::map<uint8_t, uint8_t> opcodes;
+    for (const auto& [recorded, ext] : trace_.extensions) {
+        int major, first_event, first_error;
+        if (XQueryExtension(dpy, ext.c_str(), &major, &first_event, &first_error)) {
+            opcodes[recorded] = static_cast<uint8_t>(major);
+        }
+    }
+
+    // So are atoms beyond the predefined ones
+    std::map<uint32_t, uint32_t> atoms;
+    for (const auto& [recorded, atom_name] : trace_.atoms) {
+        atoms[recorded] = static_cast<uint32_t>(XInternAtom(dpy, atom_name.c_str(), False));
+    }
+
+    XSync(dpy, False);
+    const bool lsb = trace_.lsb_first;
+    const uint32_t root = static_cast<uint32_t>(RootWindow(dpy, DefaultScreen(dpy)));
+
+    // Request names for the report
+    std::map<std::pair<uint8_t, uint8_t>, std::string> names;
+    auto type_name = [&](const std::vector<uint8_t>& request) -> const std::string& {
+        uint8_t major = request[0];
+        uint8_t minor = major >= 128 ? request[1] : 0;
+        auto key = std::make_pair(major, minor);
+        auto it = names.find(key);
+        if (it != names.end()) return it->second;
+
+        std::string label;
+        if (major < 128) {
+            char text[128] = "";
+            XGetErrorDatabaseText(dpy, "XRequest", std::to_string(major).c_str(), "",
+                                  text, sizeof(text));
+            label = text[0] ? text : "core:" + std::to_string(major);
+        } else {
+            auto ext = trace_.extensions.find(major);
+            label = (ext != trace_.extensions.end() ? ext->second : "ext" + std::to_string(major)) +
+                    ":" + std::to_string(minor);
+        }
+        return names.emplace(key, label).first->second;
+    };
+
+    // Client XIDs are recognized when a request creates them (in the recorded
+    // allocation range) and remapped wherever they appear afterwards. Every
+    // loop allocates fresh XIDs: resources the trace never freed still exist
+    // from earlier loops, and reusing their IDs would raise BadIDChoice.
+    std::map<uint32_t, uint32_t> xids;
+    bool out_of_ids = false;
+    auto created = [&](uint32_t recorded) {
+        if (recorded == 0 || (recorded & ~trace_.resource_mask) != trace_.resource_base ||
+            xids.count(recorded)) {
+            return true;
+        }
+        XID fresh = XAllocID(dpy);
+        if (fresh == static_cast<XID>(-1) || fresh == 0) {
+            out_of_ids = true;
+            return false;
+        }
+        xids.emplace(recorded, static_cast<uint32_t>(fresh));
+        return true;
+    };
+    auto resource = [&](uint32_t recorded) {
+        if (recorded != 0 && recorded == trace_.root) return root;
+        auto it = xids.find(recorded);
+        return it != xids.end() ? it->second : recorded;
+    };
+    auto atom = [&](uint32_t recorded) {
+        auto it = atoms.find(recorded);
+        return it != atoms.end() ? it->second : recorded;
+    };
+
+    auto remap = [&](std::vector<uint8_t>& request) -> bool {
+        uint8_t major = request[0];
+        bool big = get16(request.data() + 2, lsb) == 0;
+        size_t start = big ? 8 : 4;
+
+        if (major < 128) {
+            // BIG-REQUESTS inserts a length word, shifting every field by 4
+            size_t shift = start - 4;
+            std::vector<uint8_t> header;
+            const uint8_t* p = request.data();
+            if (big) {
+                header.assign(request.begin(), request.begin() + 4);
+                header.insert(header.end(), request.begin() + 8, request.end());
+                p = header.data();
+            }
+            for (const auto& [offset, kind] : core_fields(p, request.size() - shift, lsb)) {
+                uint8_t* field = request.data() + offset + shift;
+                if (offset + shift + 4 > request.size()) continue;
+                bool msb = kind == Field::FontShift;
+                uint32_t value = get32(field, lsb && !msb);
+                if (kind == Field::Created && !created(value)) return false;
+                value = kind == Field::Atom ? atom(value) : resource(value);
+                put32(field, value, lsb && !msb);
+            }
+            return true;
+        }
+
+        auto it = opcodes.find(major);
+        if (it == opcodes.end()) return false;  // Extension missing on this server
+        request[0] = it->second;
+
+        // No layout: guess the created resource and rewrite known XIDs
+        if (request.size() >= start + 4 && !created(get32(request.data() + start, lsb))) {
+            return false;
+        }
+        for (size_t off = start; off + 4 <= request.size(); off += 4) {
+            auto xid = xids.find(get32(request.data() + off, lsb));
+            if (xid != xids.end()) {
+                put32(request.data() + off, xid->second, lsb);
+            }
+        }
+        return true;
+    };
+
+    // Everything the server sends back is consumed here; replies are only
+    // needed to find the end of a round trip
+    int fd = ConnectionNumber(dpy);
+    uint64_t sequence = dpy->request;
+    uint64_t last_read = dpy->last_request_read;
+    std::vector<uint8_t> inbox;
+    std::vector<uint8_t> outbox;
+    bool broken = false;
+
+    auto drain = [&](int timeout_ms) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        while (!broken && poll(&pfd, 1, timeout_ms) > 0) {
+            uint8_t buf[65536];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                broken = true;
+                break;
+            }
+            inbox.insert(inbox.end(), buf, buf + n);
+            size_t pos = 0;
+            while (inbox.size() - pos >= 32) {
+                const uint8_t* p = inbox.data() + pos;
+                size_t total = 32;
+                if (p[0] == 1 || (p[0] & 0x7f) == 35) {
+                    total += size_t(get32(p + 4, lsb)) * 4;
+                }
+                if (inbox.size() - pos < total) break;
+                if (p[0] == 0) stats.errors++;
+                if (p[0] <= 1) {
+                    uint64_t seq = (last_read & ~uint64_t(0xffff)) | get16(p + 2, lsb);
+                    if (seq < last_read) seq += 0x10000;
+                    last_read = seq;
+                }
+                pos += total;
+            }
+            inbox.erase(inbox.begin(), inbox.begin() + pos);
+            timeout_ms = 0;
+        }
+    };
+
+    auto flush = [&]() {
+        size_t done = 0;
+        while (!broken && done < outbox.size()) {
+            struct pollfd pfd = {fd, POLLOUT | POLLIN, 0};
+            if (poll(&pfd, 1, -1) <= 0) continue;
+            if (pfd.revents & POLLIN) {
+                drain(0);  // Keep the server from blocking on its output
+            }
+            if (pfd.revents & POLLOUT) {
+                ssize_t n = write(fd, outbox.data() + done, outbox.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    broken = true;
+                    break;
+                }
+                done += static_cast<size_t>(n);
+            }
+        }
+        outbox.clear();
+    };
+
+    auto send_sync = [&]() {
+        uint8_t request[4] = {X_GET_INPUT_FOCUS, 0, 0, 0};
+        request[lsb ? 2 : 3] = 1;  // Length 1
+        outbox.insert(outbox.end(), request, request + 4);
+        return ++sequence;
+    };
+
+    auto round_trip = [&]() {
+        uint64_t target = send_sync();
+        flush();
+        while (!broken && last_read < target) {
+            drain(100);
+        }
+    };
+
+    uint64_t since_reply = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    for (int loop = 0; loop < options_.loops && !broken && !out_of_ids; loop++) {
+        xids.clear();
+        auto loop_start = std::chrono::steady_clock::now();
+
+        for (const auto& recorded : trace_.requests) {
+            if (broken || out_of_ids) break;
+
+            if (options_.realtime) {
+                auto due = loop_start + std::chrono::microseconds(recorded.time_us);
+                if (std::chrono::steady_clock::now() < due) {
+                    flush();
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            std::vector<uint8_t> request = recorded.bytes;
+            const std::string& label = type_name(request);
+            if (!remap(request)) {
+                continue;
+            }
+
+            auto t0 = std::chrono::steady_clock::now();
+            outbox.insert(outbox.end(), request.begin(), request.end());
+            sequence++;
+            stats.requests++;
+
+            auto& type = stats.per_type[label];
+            type.count++;
+
+            if (options_.per_request) {
+                round_trip();
+                type.total_ms += std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - t0).count();
+            } else {
+                // Keep the 16-bit wire sequence unambiguous, as Xlib does
+                if (++since_reply >= 32768) {
+                    send_sync();
+                    since_reply = 0;
+                }
+                if (outbox.size() >= 65536) {
+                    flush();
+                }
+            }
+        }
+        round_trip();
+    }
+
+    stats.total_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    // Hand the connection back to Xlib in a consistent state
+    dpy->request = sequence;
+    dpy->last_request_read = sequence;
+    XCloseDisplay(dpy);
+
+    if (broken) {
+        error_ = "connection lost during replay";
+        return false;
+    }
+    if (out_of_ids) {
+        error_ = "connection ran out of XIDs after " + std::to_string(stats.requests) +
+                 " requests";
+        return false;
+    }
+    return true;
+}
+
+} // namespace x11bench
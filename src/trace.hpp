@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace x11bench {
+
+// One client request as it appeared on the wire
+struct TraceRequest {
+    uint64_t time_us = 0;          // Offset from the first recorded request
+    std::vector<uint8_t> bytes;    // Complete request, header included
+};
+
+// Request stream of one X client, recorded through TraceRecorder
+struct Trace {
+    bool lsb_first = true;         // Client byte order
+    uint32_t resource_base = 0;    // Recorded connection's XID allocation range
+    uint32_t resource_mask = 0;
+    uint32_t root = 0;             // Recorded screen 0 root window
+    std::map<uint8_t, std::string> extensions;  // Recorded major opcode -> name
+    std::map<uint32_t, std::string> atoms;      // Recorded non-predefined atom -> name
+    std::vector<TraceRequest> requests;
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+struct RecordOptions {
+    std::string upstream_display;  // Real server (":N"); empty uses $DISPLAY
+    int listen_display = 9;        // Proxy display number clients connect to
+    std::string output = "trace.x11t";
+    std::vector<std::string> command;  // Client to launch with DISPLAY set; empty waits
+};
+
+// Local proxy that forwards a single client to the real server over Unix
+// sockets and records its request stream. The server's setup reply and the
+// QueryExtension, InternAtom and GetAtomName replies are parsed so replay can
+// remap XIDs, extension opcodes and atoms.
+class TraceRecorder {
+public:
+    explicit TraceRecorder(const RecordOptions& options);
+
+    // Proxy until the client disconnects, then write the trace
+    bool run();
+
+    const std::string& error() const { return error_; }
+    const Trace& trace() const { return trace_; }
+
+private:
+    RecordOptions options_;
+    Trace trace_;
+    std::string error_;
+};
+
+struct ReplayOptions {
+    std::string display_name;
+    bool realtime = false;     // Honour recorded inter-request gaps
+    bool per_request = false;  // Round-trip after every request to time each one
+    int loops = 1;
+};
+
+struct ReplayStats {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    double total_ms = 0.0;
+    struct TypeStats {
+        uint64_t count = 0;
+        double total_ms = 0.0;
+    };
+    std::map<std::string, TypeStats> per_type;
+};
+
+// Replays a trace against a server. Xlib opens the connection (so
+// authentication and setup work as usual); the requests are then written to
+// the socket directly with client XIDs, the root window, atoms and extension
+// opcodes remapped for the new connection. Core requests are rewritten only
+// in the fields their protocol layout declares as resources or atoms.
+// Extension requests have no layout here: a first word in the client's XID
+// range is taken as a created resource, and any word equal to a known XID is
+// rewritten.
+class TraceReplayer {
+public:
+    TraceReplayer(const Trace& trace, const ReplayOptions& options);
+
+    bool run(ReplayStats& stats);
+
+    const std::string& error() const { return error_; }
+
+private:
+    const Trace& trace_;
+    ReplayOptions options_;
+    std::string error_;
+};
+
+} // namespace x11bench